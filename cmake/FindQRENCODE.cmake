@@ -0,0 +1,36 @@
+# Finds libqrencode, used to print the connection QR code.
+# If it's found it sets QRENCODE_FOUND to TRUE
+# and following variables are set:
+#  QRENCODE_INCLUDE_DIR
+#  QRENCODE_LIBRARY
+
+FIND_PATH(QRENCODE_INCLUDE_DIR qrencode.h
+        HINTS "$ENV{QRENCODE_INCLUDE_PATH}"
+        PATHS
+        "/opt/homebrew/include"
+        "/usr/local/include"
+        "/usr/include"
+        )
+
+FIND_LIBRARY(QRENCODE_LIBRARY NAMES qrencode libqrencode
+        HINTS "$ENV{QRENCODE_LIBRARY_PATH}"
+        PATHS
+        "/opt/homebrew/lib"
+        "/usr/local/lib"
+        "/usr/lib"
+        )
+
+IF (QRENCODE_INCLUDE_DIR AND QRENCODE_LIBRARY)
+    SET(QRENCODE_FOUND TRUE)
+ENDIF (QRENCODE_INCLUDE_DIR AND QRENCODE_LIBRARY)
+
+IF (QRENCODE_FOUND)
+    IF (NOT QRENCODE_FIND_QUIETLY)
+        MESSAGE(STATUS "Found QRencode include-dir path: ${QRENCODE_INCLUDE_DIR}")
+        MESSAGE(STATUS "Found QRencode library path: ${QRENCODE_LIBRARY}")
+    ENDIF (NOT QRENCODE_FIND_QUIETLY)
+ELSE (QRENCODE_FOUND)
+    IF (QRENCODE_FIND_REQUIRED)
+        MESSAGE(FATAL_ERROR "Could not find QRencode")
+    ENDIF (QRENCODE_FIND_REQUIRED)
+ENDIF (QRENCODE_FOUND)
@@ -5,34 +5,71 @@
 #ifndef COG_GROUP_CONVO_CPP_APPCONTEXT_HPP
 #define COG_GROUP_CONVO_CPP_APPCONTEXT_HPP
 
-#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <SDL.h>
 #include <SDL_mutex.h>
 #include <SDL_ttf.h>
 #include "captions.hpp"
+#include "speaker_registry.hpp"
+
+struct CaptionLayout;
+struct CaptionTimeline;
+struct RenderConfig;
+struct CaptionOverlay;
+struct CaptionTextureCache;
+struct ViewportSet;
+class FrameArena;
+class QualityGovernor;
+struct FrameRing;
+struct libvlc_media_player_t;
+struct AppContext;
+
+/**
+ * Draws one frame's captions with a particular presentation method (see caption_pipeline).
+ */
+using CaptionPipeline = void (*)(const AppContext *);
 
 struct AppContext {
+    SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
     SDL_mutex *mutex;
     std::mutex *azimuth_mutex;
     std::deque<float> *azimuth_buffer;
-    TTF_Font *smallest_font;
-    TTF_Font *medium_font;
-    TTF_Font *largest_font;
-    const std::map<cog::Juror, std::pair<double, double>> *juror_positions;
-    const std::map<cog::Juror, TTF_Font *> *juror_font_sizes;
+    std::string path_to_font;
+    const SpeakerRegistry *speakers; // Where each speaker's captions go, and what font and color they use
     SDL_Surface *back_arrow;
     SDL_Surface *forward_arrow;
+    SDL_Surface *calibration_background_left;
+    SDL_Surface *calibration_background_center;
+    SDL_Surface *calibration_background_right;
     const SDL_Color *foreground_color;
     const SDL_Color *background_color;
     CaptionModel *caption_model;
-    int presentation_method;
+    CaptionTimeline *caption_timeline; // When set, captions follow the media clock instead of the caption model
+    libvlc_media_player_t *media_player; // Where the video comes from; the caption timeline follows its clock
+    const CaptionLayout *caption_layout; // When set (and built for the current window size), captions come from here
+    const std::vector<GlyphAtlas> *glyph_atlases; // Fonts scaled for the current window size; nullptr for the scene's
+    std::shared_ptr<const RenderConfig> published_render_config; // Latest snapshot from the main loop, atomic access only
+    std::shared_ptr<const RenderConfig> render_config; // The snapshot the render thread is currently drawing with
+    CaptionOverlay *caption_overlay; // Where captions are drawn between frames; nullptr to draw straight to the frame
+    CaptionTextureCache *caption_textures; // Rasterized captions shared by every view; nullptr to rasterize every draw
+    ViewportSet *viewports; // When set, one view per participant is drawn instead of a single full-window one
+    FrameArena *frame_arena; // Where the render path's per-frame temporaries come from; nullptr to use the heap
+    QualityGovernor *quality_governor; // Degrades quality when frames don't fit their budget; nullptr for full quality
+    FrameRing *frame_ring; // When set, every presented frame is published here for local consumers
+    SDL_Surface *frame_surface; // When compositing on the CPU, the frame that atlas captions are blended straight into
+    int presentation_method; // Set with set_presentation_method, which keeps caption_pipeline in step
+    CaptionPipeline caption_pipeline;
+    int video_section;
+    int half_fov;
     int n;
     int y;
     SDL_Rect display_rect;
     int window_width;
     int window_height;
-    const std::map<cog::Juror, std::pair<double, double>> *juror_intervals;
 };
 #endif //COG_GROUP_CONVO_CPP_APPCONTEXT_HPP
@@ -0,0 +1,15 @@
+#ifndef COG_GROUP_CONVO_CPP_VLC_MANAGER_HPP
+#define COG_GROUP_CONVO_CPP_VLC_MANAGER_HPP
+
+#include <vlc/vlc.h>
+
+/**
+ * Owns the libvlc handles used to play back a video section.
+ */
+struct VLC_Manager {
+    libvlc_instance_t *libvlc;
+    libvlc_media_t *m;
+    libvlc_media_player_t *mp;
+};
+
+#endif //COG_GROUP_CONVO_CPP_VLC_MANAGER_HPP
@@ -0,0 +1,37 @@
+#ifndef COG_GROUP_CONVO_CPP_APP_EVENTS_HPP
+#define COG_GROUP_CONVO_CPP_APP_EVENTS_HPP
+
+#include <SDL.h>
+
+/**
+ * Things that happen on other threads (VLC's, the caption stream's, the orientation reader's) that the main loop
+ * needs to react to. They're posted to SDL's event queue as a single registered user event type, with the AppEvent
+ * in event.user.code, so SDL_WaitEventTimeout wakes up for them just like it does for input.
+ */
+enum AppEvent {
+    PLAYBACK_ENDED = 0, // VLC reached the end of the video section
+    CAPTIONS_FINISHED = 1, // Every caption in the track has been revealed (and sent, for CONTROL)
+    ORIENTATION_LOST = 2, // The orientation socket failed, so we won't hear from the HWD again
+    QUALITY_CHANGED = 3, // The quality governor raised or lowered the quality level
+};
+
+/**
+ * Reserves the user event type the other functions here use. Must be called after SDL_Init and before any thread
+ * posts an event.
+ */
+void register_app_events();
+
+/**
+ * Posts an AppEvent to the main loop. Safe to call from any thread; does nothing if register_app_events hasn't been
+ * called (e.g. during offline rendering, where there's no main loop to wake).
+ */
+void post_app_event(AppEvent app_event);
+
+/**
+ * Returns the AppEvent carried by an SDL_Event, or -1 if it isn't one of ours.
+ */
+int app_event_code(const SDL_Event *event);
+
+const char *app_event_name(AppEvent app_event);
+
+#endif //COG_GROUP_CONVO_CPP_APP_EVENTS_HPP
@@ -0,0 +1,57 @@
+#ifndef COG_GROUP_CONVO_CPP_BATCH_RENDER_HPP
+#define COG_GROUP_CONVO_CPP_BATCH_RENDER_HPP
+
+#include <string>
+#include <vector>
+#include "AppContext.hpp"
+
+/**
+ * One offline render: a participant's recorded orientation (or a synthetic sweep, if orientation_path is empty)
+ * played against a video section, presentation method and field of view.
+ */
+struct RenderJob {
+    int video_section;
+    int presentation_method;
+    int half_fov;
+    std::string orientation_path;
+    std::string output_path;
+};
+
+/**
+ * Reads a list of render jobs from a JSON file shaped like:
+ *
+ *   [{"video_section": 1, "presentation_method": 1, "field_of_view": 20,
+ *     "orientation": "sessions/p01.1.cogo", "output": "renders/p01.1.1.20.mp4"}, ...]
+ *
+ * "field_of_view" is the full view angle, just like on the command line. "orientation" is optional.
+ * @param invalid_jobs Counts the jobs that were skipped for having invalid settings
+ */
+std::vector<RenderJob> load_render_jobs(const std::string &path, int *invalid_jobs);
+
+/**
+ * Creates a render context that shares nothing mutable with the prototype: its own copy of the arrow surfaces, and no
+ * renderer, caption model or orientation buffer (export_captioned_video supplies those per job). Fonts aren't used
+ * once the speakers' glyph atlases are built, so the registry is the only thing shared between workers, and it is
+ * read-only.
+ * Must be called from the thread that owns the prototype.
+ */
+AppContext create_worker_context(const AppContext *prototype);
+
+/**
+ * Frees what create_worker_context allocated.
+ */
+void destroy_worker_context(AppContext *context);
+
+/**
+ * Runs every job through export_captioned_video, spreading them across `workers` threads. Caption tracks and
+ * orientation recordings are loaded once up front and shared read-only between jobs.
+ * Prints per-job and pool-wide throughput in frames per second.
+ * @param prototype A fully set up context whose speakers have glyph atlases built
+ * @param jobs The renders to run
+ * @param workers How many jobs to run at once
+ * @param fps The frame rate to render at
+ * @return The number of jobs that failed.
+ */
+int run_batch_render(const AppContext *prototype, const std::vector<RenderJob> &jobs, size_t workers, int fps);
+
+#endif //COG_GROUP_CONVO_CPP_BATCH_RENDER_HPP
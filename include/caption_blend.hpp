@@ -0,0 +1,65 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_BLEND_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_BLEND_HPP
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <SDL.h>
+#include "glyph_atlas.hpp"
+
+/**
+ * Implementations of the row blend, from slowest to fastest. The fastest one the CPU supports is picked at runtime.
+ */
+enum BlendKernel {
+    BLEND_SCALAR = 0,
+    BLEND_SSE2 = 1,
+    BLEND_AVX2 = 2,
+};
+
+/**
+ * Blends `count` pixels of a shaded caption into a row of frame pixels. Each caption pixel is background_color mixed
+ * towards foreground_color by its coverage (exactly what rasterize_text produces), alpha-blended over the frame.
+ */
+using BGR565RowBlend = void (*)(uint16_t *destination, const uint8_t *coverage, int count,
+                                const SDL_Color *foreground_color, const SDL_Color *background_color);
+using ARGB8888RowBlend = void (*)(uint32_t *destination, const uint8_t *coverage, int count,
+                                  const SDL_Color *foreground_color, const SDL_Color *background_color);
+
+/**
+ * Returns the fastest kernel this CPU can run (checked once, with SDL_HasAVX2/SDL_HasSSE2).
+ */
+BlendKernel select_blend_kernel();
+
+const char *blend_kernel_name(BlendKernel kernel);
+
+/**
+ * Returns the given kernel's row blends, or nullptr if it wasn't compiled in (e.g. SSE2/AVX2 on ARM).
+ */
+BGR565RowBlend bgr565_row_blend(BlendKernel kernel);
+
+ARGB8888RowBlend argb8888_row_blend(BlendKernel kernel);
+
+/**
+ * Lays text out from the atlas and blends it straight into a BGR565 or ARGB8888 surface at (x, y), without ever
+ * creating a caption surface or texture. Only the part of the caption inside clip_rect (and the surface) is touched.
+ * Safe to call from any thread, as long as no other thread is writing to the same surface.
+ * @param surface The frame to draw into
+ * @param clip_rect Where the caption may be drawn, in surface coordinates, or nullptr for anywhere on the surface
+ * @param scratch Where the caption's coverage mask is allocated
+ * @return The width and height of the whole (unclipped) caption. (0, 0) if the surface's format isn't supported.
+ */
+std::tuple<int, int> blend_text(SDL_Surface *surface, const GlyphAtlas *atlas, std::string_view text, int x, int y,
+                                const SDL_Rect *clip_rect, const SDL_Color *foreground_color,
+                                const SDL_Color *background_color,
+                                std::pmr::memory_resource *scratch = std::pmr::get_default_resource());
+
+/**
+ * Times blend_text with every kernel this CPU supports against rasterize_text plus SDL_BlitSurface, compositing the
+ * same caption into a 4K BGR565 frame `iterations` times, and checks that every kernel matches the scalar one.
+ */
+void run_blend_benchmark(const GlyphAtlas *atlas, const SDL_Color *foreground_color,
+                         const SDL_Color *background_color, int iterations);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_BLEND_HPP
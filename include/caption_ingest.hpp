@@ -0,0 +1,50 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_INGEST_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_INGEST_HPP
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "captions.hpp"
+#include "speaker_registry.hpp"
+
+class CaptionServer;
+
+constexpr size_t MAX_INGEST_MESSAGE_SIZE = 2048;
+constexpr int PARTIAL_HYPOTHESIS_LEAD_MS = 150; // How long before its final text simulate_asr sends a partial word
+constexpr size_t PARTIAL_HYPOTHESIS_MIN_LENGTH = 4; // Shorter words are sent final straight away
+
+/**
+ * Captions from a live speech recognizer arrive as datagrams on a UDP port only bound on the loopback interface, one
+ * CaptionMessage flatbuffer per datagram: the same message that's sent to the HWDs, shaped like an entry of the caption
+ * tracks (text, speaker_id, message_id and chunk_id; focused_id is passed through to the HWDs).
+ *
+ * A message with the same message_id and chunk_id as one already on screen replaces it, so a recognizer can send its
+ * partial hypothesis for a chunk straight away and correct it as it firms up; an empty text removes the chunk. Chunks
+ * are shown in chunk_id order within a message, and a new message_id from a different speaker starts a new caption,
+ * just like a caption track. message_ids are expected to increase.
+ */
+int open_caption_ingest_socket(int port);
+
+/**
+ * Receives captions until close_caption_ingest_socket shuts the socket down (once stopping is set), feeding them into
+ * the caption model and forwarding them to every connected HWD. Malformed messages, and ones from speakers that aren't
+ * in the scene, are dropped. When each message arrived is kept in the trial metrics,
+ * so the render thread can measure how long it took to reach the screen.
+ */
+void serve_caption_ingest(int socket, CaptionModel *model, CaptionServer *server, const SpeakerRegistry *speakers,
+                          const std::atomic<bool> *stopping);
+
+/**
+ * Stops serve_caption_ingest and waits for its thread, then closes the socket.
+ */
+void close_caption_ingest_socket(int socket, std::thread *ingest_thread);
+
+/**
+ * A stand-in for a live recognizer, for testing: once `started` is set, sends the caption track to the ingest port at
+ * its scheduled times, sending each longer word as a partial hypothesis (its first half) PARTIAL_HYPOTHESIS_LEAD_MS
+ * before replacing it with the whole word. Gives up as soon as stopping is set.
+ */
+void simulate_asr(int port, const std::atomic<bool> *started, const std::atomic<bool> *stopping,
+                  const std::vector<CaptionCue> *cues, const SpeakerRegistry *speakers);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_INGEST_HPP
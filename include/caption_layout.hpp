@@ -0,0 +1,63 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_LAYOUT_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_LAYOUT_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <SDL.h>
+#include "AppContext.hpp"
+#include "captions.hpp"
+
+/**
+ * Everything about what's on screen once a given cue has been revealed, worked out ahead of time.
+ */
+struct CaptionLayoutEntry {
+    SpeakerId speaker;
+    uint32_t text_offset; // Where this entry's wrapped text starts in CaptionLayout::text
+    uint32_t text_length;
+    int width; // Size of the rasterized caption, in pixels
+    int height;
+    SDL_Rect anchor; // Where a registered caption sits on screen, before it's clipped to the FOV
+    int interval_left; // The speaker's interval, used to decide which arrow to show
+    int interval_right;
+};
+
+/**
+ * A precomputed caption-to-screen layout for a whole caption track. entries[i] describes the caption on screen once
+ * cue i has been revealed, so the caption for a CaptionModel (or CaptionTimeline) built from the same track is
+ * entries[revealed_caption_count() - 1].
+ * Anchors are only valid for the window size the layout was built for.
+ */
+struct CaptionLayout {
+    std::vector<CaptionLayoutEntry> entries;
+    std::string text;
+    int window_width;
+    int window_height;
+};
+
+/**
+ * Replays the caption track through the same accumulation and wrapping that CaptionModel does, and measures every
+ * resulting caption with its speaker's glyph atlas.
+ * Only reads the registry, so the main loop can build a layout for a new window size while the render thread is still
+ * using the old one.
+ * @param cues The caption track
+ * @param speakers Where each speaker's captions go, and what they're measured with
+ * @param glyph_atlases Atlases to measure with instead of the registry's own (see derive_speaker_atlases), or nullptr
+ * @param window_width The window size to lay out for
+ * @param window_height
+ */
+CaptionLayout build_caption_layout(const std::vector<CaptionCue> &cues, const SpeakerRegistry *speakers,
+                                   const std::vector<GlyphAtlas> *glyph_atlases, int window_width, int window_height);
+
+/**
+ * Looks up the caption currently on screen in the context's layout.
+ * @param context
+ * @param entry Set to the current entry, or to nullptr if nothing has been said yet
+ * @return false if the layout can't be used (there's none, it's for another window size, or the caption model isn't
+ * being fed from the same track), in which case the caption has to be laid out from scratch.
+ */
+bool lookup_caption_layout(const AppContext *context, const CaptionLayoutEntry **entry);
+
+std::string_view layout_text(const CaptionLayout *layout, const CaptionLayoutEntry *entry);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_LAYOUT_HPP
@@ -0,0 +1,51 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_OVERLAY_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_OVERLAY_HPP
+
+#include <vector>
+#include <SDL.h>
+#include "AppContext.hpp"
+
+/**
+ * A window-sized, transparent layer that captions and arrows are drawn into instead of straight onto the frame.
+ * Most frames show exactly the same captions as the one before, so the overlay is only redrawn when something that
+ * decides what's on it changes (the caption revision, the azimuth bucket, or the window size), and otherwise
+ * just blended over the new video frame with a single copy of the region that has something on it.
+ */
+struct CaptionOverlay {
+    SDL_Texture *texture; // nullptr if the renderer can't render to textures, in which case we draw straight to the frame
+    int width;
+    int height;
+    bool valid; // false until the overlay has been drawn for the current window size
+    size_t caption_revision; // How many words had been revealed when the overlay was last drawn
+    int azimuth_bucket;
+    std::vector<SDL_Rect> dirty_rects; // Everything drawn onto the overlay since it was last cleared
+    SDL_Rect bounds; // Bounding box of dirty_rects, which is all that gets copied onto the frame
+};
+
+/**
+ * Creates the overlay texture for the given window size.
+ */
+void create_caption_overlay(CaptionOverlay *overlay, SDL_Renderer *renderer, int width, int height);
+
+void destroy_caption_overlay(CaptionOverlay *overlay);
+
+/**
+ * Records that a presentation method drew inside rect. Does nothing unless the context is drawing into an overlay.
+ */
+void mark_overlay_dirty(const AppContext *context, const SDL_Rect *rect);
+
+/**
+ * Makes sure the context's overlay holds its current captions, recreating it if the window size changed and redrawing
+ * it if it's stale. Doesn't draw anything onto the frame.
+ * @return false if the context has no usable overlay, in which case captions have to be drawn straight to the frame.
+ */
+bool refresh_caption_overlay(const AppContext *context);
+
+/**
+ * Draws the captions over the current frame, redrawing the overlay first if it's stale. Draws straight onto the frame
+ * (like render_captions) if the context has no usable overlay, and does nothing at all for CONTROL, which never draws
+ * over the video.
+ */
+void composite_caption_overlay(const AppContext *context);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_OVERLAY_HPP
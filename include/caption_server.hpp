@@ -0,0 +1,219 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_SERVER_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <netinet/in.h>
+#include "cog-flatbuffer-definitions/caption_message_generated.h"
+#include "orientation_recording.hpp"
+
+// Followed by the client's presentation method and, optionally, its full field of view in degrees and the transport it
+// wants, e.g. "COG-REGISTER 4 30 sequenced"
+#define CLIENT_REGISTRATION_PREFIX "COG-REGISTER "
+#define CLIENT_REGISTRATION_REPLY "COG-REGISTERED "
+#define SEQUENCED_TRANSPORT "sequenced"
+
+/**
+ * Clients that register with the SEQUENCED_TRANSPORT get their captions framed, numbered, and (optionally) several to a
+ * datagram, and can ask for any they missed to be sent again. Every other client gets one bare CaptionMessage
+ * flatbuffer per datagram, as before. All integers are little-endian.
+ *
+ * Caption datagram (server to client):
+ *   char[4] magic         (CAPTION_DATAGRAM_MAGIC)
+ *   uint8   version       (CAPTION_TRANSPORT_VERSION)
+ *   uint8   flags         (CAPTION_RETRANSMISSION if the captions in it are being sent again)
+ *   uint16  count
+ *   then, count times:
+ *     uint32 sequence     (consecutive across the whole trial, in the order captions are revealed)
+ *     uint16 size
+ *     size bytes of CaptionMessage flatbuffer
+ *
+ * NACK (client to server), asking for missing sequences to be sent again:
+ *   char[4] magic         (CAPTION_NACK_MAGIC)
+ *   uint16  count
+ *   then, count times:
+ *     uint32 first sequence
+ *     uint16 length       (how many sequences, starting at the first, are missing)
+ *
+ * message_id/chunk_id can't number captions on their own (chunk_id restarts with every message, and message ids
+ * skip), so sequences are assigned as captions are revealed and kept with each caption in the replay ring. A
+ * retransmitted caption always goes out with the sequence it was first sent with.
+ */
+constexpr char CAPTION_DATAGRAM_MAGIC[4] = {'C', 'O', 'G', 'C'};
+constexpr char CAPTION_NACK_MAGIC[4] = {'C', 'O', 'G', 'N'};
+constexpr uint8_t CAPTION_TRANSPORT_VERSION = 1;
+constexpr uint8_t CAPTION_RETRANSMISSION = 1;
+constexpr size_t CAPTION_DATAGRAM_HEADER_SIZE = 8;
+constexpr size_t CAPTION_ENTRY_HEADER_SIZE = 6;
+constexpr size_t MAX_CAPTION_DATAGRAM_SIZE = 1200; // Stays under the MTU of any network we'd run a trial on
+
+/**
+ * An encoded caption waiting to go out to one client.
+ */
+struct PendingCaption {
+    std::shared_ptr<const std::vector<uint8_t>> message; // Shared by every client it's going to
+    uint32_t sequence;
+    std::chrono::steady_clock::time_point queued_at;
+};
+
+/**
+ * A caption that was sent recently enough to be sent again.
+ */
+struct ReplayEntry {
+    uint32_t sequence;
+    std::shared_ptr<const std::vector<uint8_t>> message;
+};
+
+/**
+ * One participant's glasses: where they are, how they want captions presented, and their own orientation stream.
+ */
+struct CaptionClient {
+    sockaddr_in address;
+    std::atomic<int> presentation_method; // Can change if the client registers again
+    std::atomic<int> half_fov;
+    bool primary; // The first client to connect; its orientation drives what's drawn on screen
+    std::mutex azimuth_mutex;
+    std::deque<float> azimuth_buffer;
+    // Everything below is guarded by the server's clients_mutex.
+    bool sequenced; // Whether the client registered for the sequenced transport
+    std::deque<PendingCaption> send_queue;
+    std::deque<PendingCaption> retransmit_queue; // Sent straight away, without waiting to coalesce
+    uint64_t orientation_packets;
+    uint64_t captions_sent;
+    uint64_t datagrams_sent;
+    uint64_t nacks_received;
+    uint64_t retransmissions;
+    uint64_t unrecoverable; // Requested sequences that had already left the replay ring
+    uint64_t send_failures;
+    uint64_t captions_dropped; // Dropped from the front of a full send queue
+    size_t max_queue_depth;
+    double total_latency_us; // Time from a caption being queued to it being handed to the kernel
+    double max_latency_us;
+};
+
+/**
+ * A copy of a client's stats, safe to read while the server keeps running.
+ */
+struct CaptionClientStats {
+    sockaddr_in address;
+    int presentation_method;
+    int half_fov;
+    bool primary;
+    bool sequenced;
+    uint64_t orientation_packets;
+    uint64_t captions_sent;
+    uint64_t datagrams_sent;
+    uint64_t nacks_received;
+    uint64_t retransmissions;
+    uint64_t unrecoverable;
+    uint64_t send_failures;
+    uint64_t captions_dropped;
+    size_t queue_depth;
+    size_t max_queue_depth;
+    double mean_latency_us;
+    double max_latency_us;
+};
+
+/**
+ * Keeps track of every pair of glasses watching the conversation, and fans captions out to them. Clients register by
+ * sending CLIENT_REGISTRATION_PREFIX followed by their presentation method (and optionally their field of view); a client
+ * that just starts sending orientation is registered with the trial's settings, so a single HWD works exactly as before.
+ * Anything else that isn't a well-formed OrientationMessage is dropped without registering its sender.
+ * Each caption is encoded once, queued for every client that shows captions on the HWD, and sent to all of them with
+ * as few sendmmsg calls as possible (one sendto each, where there's no sendmmsg) from the server's own thread. For
+ * sequenced clients, captions queued within coalesce_ms of each other share a datagram, and the last REPLAY_RING_SIZE
+ * captions can be sent again on request.
+ */
+class CaptionServer {
+private:
+    int socket;
+    int default_presentation_method;
+    int default_half_fov;
+    std::chrono::milliseconds coalesce_window;
+    uint32_t next_sequence = 0;
+    std::vector<ReplayEntry> replay_ring;
+    std::unordered_map<uint64_t, std::unique_ptr<CaptionClient>> clients; // Keyed by address and port
+    std::vector<CaptionClient *> registration_order;
+    std::mutex clients_mutex;
+    std::condition_variable captions_queued;
+    bool stopping = false;
+    std::thread sender;
+
+    CaptionClient *add_client(const sockaddr_in &address, int presentation_method, int half_fov);
+
+    void handle_registration(const sockaddr_in &address, const uint8_t *packet, size_t size);
+
+    void handle_nack(const sockaddr_in &address, const uint8_t *packet, size_t size);
+
+    void send_queued_captions();
+
+public:
+    const static size_t MAX_QUEUE_DEPTH = 256;
+    const static size_t MAX_BATCH = 64; // Datagrams handed to one sendmmsg call, where there is one
+    const static size_t REPLAY_RING_SIZE = 1024;
+    const static size_t MAX_NACKED_SEQUENCES = 256; // Per NACK, so one can't make us resend the whole ring
+    const static size_t MAX_CLIENTS = 32; // Far more glasses than a trial has, so spoofed senders can't grow it forever
+
+    /**
+     * @param coalesce_ms How long a sequenced client's captions wait for more to share their datagram (0 to never wait)
+     */
+    CaptionServer(int socket, int default_presentation_method, int default_half_fov, int coalesce_ms = 0);
+
+    ~CaptionServer();
+
+    CaptionServer(const CaptionServer &) = delete;
+
+    CaptionServer &operator=(const CaptionServer &) = delete;
+
+    /**
+     * Handles a datagram from address, telling registrations and NACKs (which are dealt with here) from orientation
+     * packets by their first bytes.
+     * @return The client that sent an orientation packet (registering it if it's new), or nullptr if the packet was
+     * anything else.
+     */
+    CaptionClient *handle_packet(const sockaddr_in &address, const uint8_t *packet, size_t size);
+
+    /**
+     * Encodes the caption once and queues it for every client presenting captions on the HWD (CONTROL).
+     */
+    void broadcast_caption(const std::string &text, cog::Juror speaker_id, cog::Juror focused_id, int message_id,
+                           int chunk_id);
+
+    size_t client_count();
+
+    /**
+     * Returns every client registered so far, in the order they registered. Clients are never removed, so the
+     * pointers stay valid for as long as the server exists.
+     */
+    std::vector<CaptionClient *> client_list();
+
+    std::vector<CaptionClientStats> client_stats();
+
+    void print_client_stats();
+};
+
+/**
+ * Formats an address as ip:port.
+ */
+std::string address_string(const sockaddr_in &address);
+
+/**
+ * Receives packets from every client until the socket fails, registering new clients and feeding orientation packets
+ * into the sending client's own buffer. The primary client's orientation also goes into orientation_buffer (what's
+ * drawn on screen follows it), and into the recording if a recorder is provided.
+ * Posts ORIENTATION_LOST when the socket fails. Returns without posting it once stopping is set and the socket has been
+ * shut down for reading.
+ */
+void serve_clients(int socket, CaptionServer *server, std::mutex *azimuth_mutex, std::deque<float> *orientation_buffer,
+                   const std::atomic<bool> *stopping, OrientationRecorder *recorder = nullptr);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_SERVER_HPP
@@ -0,0 +1,71 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_SOURCE_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_SOURCE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "captions.hpp"
+#include "speaker_registry.hpp"
+
+/**
+ * Reads a caption track incrementally on a thread of its own, keeping at most `capacity` cues ahead of whoever is
+ * revealing them. The track is never loaded as a whole, so memory use stays the same however long the recording is.
+ * The file has the same format as merged_captions.N.json: an array of {delay, text, speaker_id, message_id, chunk_id}.
+ */
+class CaptionSource {
+private:
+    std::deque<CaptionCue> look_ahead;
+    size_t capacity;
+    bool finished = false; // The reader has reached the end of the track (or given up on it)
+    bool closed = false; // Nobody wants any more cues
+    size_t cues_read = 0;
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::thread reader;
+
+public:
+    const static size_t DEFAULT_CAPACITY = 256;
+
+    CaptionSource(const std::string &path, const SpeakerRegistry *speakers, size_t capacity = DEFAULT_CAPACITY);
+
+    ~CaptionSource();
+
+    CaptionSource(const CaptionSource &) = delete;
+
+    CaptionSource &operator=(const CaptionSource &) = delete;
+
+    /**
+     * Waits for the next cue in the track.
+     * @return false once the whole track has been read (or the source has been closed).
+     */
+    bool next(CaptionCue *cue);
+
+    /**
+     * Adds a cue to the look-ahead, waiting for room if it's full. Only the reader should call this.
+     * @return false if the source has been closed, and the reader should stop.
+     */
+    bool push(CaptionCue cue);
+
+    /**
+     * Marks the end of the track. Only the reader should call this.
+     */
+    void finish();
+
+    /**
+     * Stops the reader early, and wakes up anyone waiting on it.
+     */
+    void close();
+
+    size_t cue_count();
+};
+
+/**
+ * Reveals each cue from the source at its scheduled time once `started` is set, exactly like start_caption_stream.
+ * Posts CAPTIONS_FINISHED once the source runs out. Gives up as soon as stopping is set, or the source is closed.
+ */
+void stream_caption_track(const std::atomic<bool> *started, const std::atomic<bool> *stopping, CaptionServer *server,
+                          CaptionSource *source, CaptionModel *model, const SpeakerRegistry *speakers);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_SOURCE_HPP
@@ -0,0 +1,89 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_TEXTURE_CACHE_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_TEXTURE_CACHE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <SDL.h>
+#include "frame_arena.hpp"
+#include "glyph_atlas.hpp"
+#include "speaker_registry.hpp"
+
+constexpr int CACHED_CAPTION_REFRESH_MS = 500; // How far behind cached-only captions can fall before they're redrawn
+constexpr size_t CAPTION_TEXTURE_POOL_SIZE = 8; // Slots reserved up front, enough for every speaker in our scenes
+constexpr size_t CAPTION_TEXT_CAPACITY = 256; // Characters reserved for each slot's text
+constexpr int CAPTION_TEXTURE_GROWTH = 64; // Slot textures grow in steps of this many pixels
+
+/**
+ * A rasterized caption, uploaded to the renderer. Only the top-left width x height of the texture holds the caption;
+ * the texture itself is as big as the biggest caption its slot has held.
+ */
+struct CachedCaptionTexture {
+    SpeakerId juror;
+    std::string text;
+    SDL_Texture *texture;
+    int width;
+    int height;
+    int texture_width;
+    int texture_height;
+};
+
+/**
+ * Caption textures for the current caption revision. Every viewport (and every overlay redraw caused by head movement
+ * alone) shows the same caption text until the next word is revealed, so the caption is rasterized and uploaded once
+ * per revision and then just copied, clipped differently for each view.
+ * Slots (and their streaming textures and text) are kept when the revision changes and refilled in place, so once
+ * the biggest caption of the trial has been shown, a new revision doesn't allocate anything.
+ * Only the render thread may use it, since the textures belong to its renderer.
+ */
+struct CaptionTextureCache {
+    size_t revision; // Caption revision the entries were rasterized for; older entries are dropped when it changes
+    std::vector<CachedCaptionTexture> entries; // Only the first used hold captions; the rest are spare slots
+    size_t used;
+    std::vector<std::pair<const SDL_Surface *, SDL_Texture *>> images; // Arrows and such, which never change
+    std::chrono::steady_clock::time_point rasterized_at; // When a caption was last rasterized
+    bool served_stale; // Whether a caption from an older revision was served since this was last cleared
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale_hits;
+};
+
+/**
+ * Rasterizes the part of a caption inside region (in the caption's own coordinates) and uploads it to a new
+ * region->w x region->h texture, which the caller owns. With an arena, the caption is rasterized into one of its pooled
+ * surfaces, so nothing but the texture itself is allocated.
+ * @return nullptr if the texture couldn't be created.
+ */
+SDL_Texture *create_caption_region_texture(SDL_Renderer *renderer, FrameArena *arena, const GlyphAtlas *glyph_atlas,
+                                           std::string_view text, const SDL_Rect *region,
+                                           const SDL_Color *foreground_color, const SDL_Color *background_color);
+
+/**
+ * Returns the texture for a speaker's caption at the given revision, rasterizing and uploading it if it isn't cached.
+ * With cached_only, the speaker's caption from an older revision is returned instead (and served_stale set), unless
+ * it's been CACHED_CAPTION_REFRESH_MS since anything was rasterized.
+ * @return nullptr if the texture couldn't be created.
+ */
+const CachedCaptionTexture *cached_caption_texture(CaptionTextureCache *cache, SDL_Renderer *renderer,
+                                                   FrameArena *arena, size_t revision, const GlyphAtlas *glyph_atlas,
+                                                   SpeakerId juror, std::string_view text,
+                                                   const SDL_Color *foreground_color,
+                                                   const SDL_Color *background_color, bool cached_only = false);
+
+/**
+ * Returns a texture holding the image (e.g. an arrow), uploading it the first time it's asked for. Images are kept
+ * across caption revisions.
+ */
+SDL_Texture *cached_image_texture(CaptionTextureCache *cache, SDL_Renderer *renderer, const SDL_Surface *image);
+
+/**
+ * Drops every cached caption (but keeps images, and the slots to draw the next captions into).
+ */
+void clear_caption_texture_cache(CaptionTextureCache *cache);
+
+void destroy_caption_texture_cache(CaptionTextureCache *cache);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_TEXTURE_CACHE_HPP
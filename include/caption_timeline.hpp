@@ -0,0 +1,61 @@
+#ifndef COG_GROUP_CONVO_CPP_CAPTION_TIMELINE_HPP
+#define COG_GROUP_CONVO_CPP_CAPTION_TIMELINE_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AppContext.hpp"
+#include "captions.hpp"
+#include "speaker_registry.hpp"
+
+class CaptionServer;
+
+/**
+ * The whole caption track indexed by reveal time, so what's on screen can be worked out from the media clock on every
+ * frame instead of by a thread sleeping between words. Follows the clock wherever it goes: pauses, seeks and changes
+ * in playback rate all just change the time it's asked about.
+ */
+struct CaptionTimeline {
+    const std::vector<CaptionCue> *cues;
+    std::vector<double> reveal_times_ms; // When each cue appears; never decreasing, so it can be binary searched
+    std::vector<uint32_t> run_starts; // The first cue of the run of words (from one speaker) each cue belongs to
+    CaptionServer *server; // Where revealed cues are sent for CONTROL clients; nullptr to not send them
+    const SpeakerRegistry *speakers;
+    // Everything below is only touched by the render thread.
+    size_t revealed = 0; // How many cues are revealed at the current frame's media time
+    size_t transmitted = 0; // How many cues have been sent to the server, in order
+    bool finished = false;
+};
+
+CaptionTimeline build_caption_timeline(const std::vector<CaptionCue> *cues, CaptionServer *server,
+                                       const SpeakerRegistry *speakers);
+
+/**
+ * Moves the timeline to media_time_ms, sends any cues that have been revealed since the last call, and posts
+ * CAPTIONS_FINISHED the first time the last cue is revealed. After a seek forward, only the caption that's now on
+ * screen (and anything revealed in the last second) is sent, rather than every word skipped over; after a seek back,
+ * cues are sent again as they're reached.
+ * Call once per frame, from the render thread.
+ */
+void advance_caption_timeline(CaptionTimeline *timeline, double media_time_ms);
+
+/**
+ * The speaker and wrapped text on screen once `revealed` cues have been revealed, exactly as a CaptionModel fed the
+ * same cues would have it.
+ */
+std::pair<SpeakerId, std::string> caption_timeline_text(const CaptionTimeline *timeline, size_t revealed);
+
+/**
+ * How many cues of the track have been revealed for the frame being drawn, from the timeline if the context has one
+ * and from the caption model otherwise. This is what captions and layouts are keyed on.
+ */
+size_t revealed_caption_count(const AppContext *context);
+
+/**
+ * Changes whenever the caption text does. The same as revealed_caption_count for a caption track, but a live
+ * recognizer can also replace words it's already sent. This is what overlays and cached textures are keyed on.
+ */
+size_t caption_revision(const AppContext *context);
+
+#endif //COG_GROUP_CONVO_CPP_CAPTION_TIMELINE_HPP
@@ -5,32 +5,124 @@
 #ifndef COG_GROUP_CONVO_CPP_CAPTIONS_HPP
 #define COG_GROUP_CONVO_CPP_CAPTIONS_HPP
 
+#include <atomic>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <netinet/in.h>
 #include "cog-flatbuffer-definitions/caption_message_generated.h"
 #include "nlohmann/json.hpp"
+#include "speaker_registry.hpp"
 
 
+/**
+ * A word (or, from a live recognizer, a chunk of words) in the caption currently being spoken.
+ */
+struct SpokenChunk {
+    SpeakerId speaker;
+    std::string text;
+    int message_id; // -1 for words that can't be replaced
+    int chunk_id;
+};
+
+/**
+ * Result of CaptionModel::update_chunk.
+ */
+enum ChunkUpdate {
+    CHUNK_ADDED,
+    CHUNK_REPLACED,
+    CHUNK_STALE, // For a message that's no longer on screen, so it was dropped
+};
+
 class CaptionModel {
 private:
-    std::vector<std::pair<cog::Juror, std::string>> spoken_so_far;
+    std::vector<SpokenChunk> spoken_so_far;
     std::mutex text_mutex;
+    size_t words_added = 0;
+    size_t changes = 0;
+    int latest_message_id = -1;
+
+public:
     const static int LINE_LENGTH = 30;
 
+    explicit CaptionModel() = default;
+
+    /**
+     * Wraps text into lines of at most line_length characters, keeping only the last two lines.
+     */
     static std::string wrap(const std::string &text, int line_length);
 
-public:
-    explicit CaptionModel() = default;
+    void add_word(const std::string &new_word, SpeakerId speaker);
 
-    void add_word(const std::string &new_word, cog::Juror speaker);
+    /**
+     * Adds a chunk of a message from a live recognizer, or replaces it if a chunk with the same message_id and
+     * chunk_id is already on screen (a recognizer revising its hypothesis). Replacing a chunk with empty text removes
+     * it. Chunks of a message older than the newest one seen are dropped unless they're still on screen, since the
+     * caption they belonged to is gone.
+     */
+    ChunkUpdate update_chunk(const std::string &text, SpeakerId speaker, int message_id, int chunk_id);
 
-    std::pair<cog::Juror, std::string> get_current_text(int line_length = LINE_LENGTH);
+    std::pair<SpeakerId, std::string> get_current_text(int line_length = LINE_LENGTH);
+
+    /**
+     * How many words have been added so far. When words come from a caption track in order, this is also the index
+     * (plus one) of the last cue revealed.
+     */
+    size_t word_count();
+
+    /**
+     * Changes every time the caption text does, whether a word was added or replaced.
+     */
+    size_t revision();
 };
 
-cog::Juror juror_from_string(const std::string &juror_str);
+/**
+ * A single word of the caption track, scheduled to appear `time_ms` milliseconds after playback starts.
+ */
+struct CaptionCue {
+    double time_ms;
+    std::string text;
+    SpeakerId speaker;
+    int message_id;
+    int chunk_id;
+};
+
+/**
+ * Converts the JSON caption track (as stored in resources/captions/merged_captions.N.json) into cues, in the order they
+ * should be revealed.
+ */
+std::vector<CaptionCue> load_caption_track(const nlohmann::json &caption_json, const SpeakerRegistry *speakers);
+
+/**
+ * Returns resources/captions/merged_captions.<video_section>.json.
+ */
+std::string caption_track_path(int video_section);
+
+/**
+ * Parses resources/captions/merged_captions.<video_section>.json.
+ */
+nlohmann::json load_captions(int video_section);
+
+class CaptionServer;
+
+/**
+ * Sends the cue to every client presenting captions on the HWD (CONTROL).
+ */
+void transmit_caption_cue(const CaptionCue &cue, CaptionServer *server, const SpeakerRegistry *speakers);
+
+/**
+ * Waits delay_ms and then reveals the cue, first sending it to every client presenting captions on the HWD (CONTROL).
+ * @return false if the trial stopped while waiting, in which case the cue isn't revealed.
+ */
+bool reveal_caption_cue(const CaptionCue &cue, double delay_ms, CaptionServer *server, CaptionModel *model,
+                        const SpeakerRegistry *speakers, const std::atomic<bool> *stopping);
 
+/**
+ * Reveals each caption in the track at its scheduled time once `started` is set, sending it to every CONTROL client
+ * as well. Posts CAPTIONS_FINISHED once the whole track has been revealed. Gives up as soon as stopping is set.
+ */
 void
-start_caption_stream(const bool *started, int socket, sockaddr_in *client_address, nlohmann::json *caption_json,
-                     CaptionModel *model, const int presentation_method);
+start_caption_stream(const std::atomic<bool> *started, const std::atomic<bool> *stopping, CaptionServer *server,
+                     const std::vector<CaptionCue> *cues, CaptionModel *model, const SpeakerRegistry *speakers);
 
 #endif //COG_GROUP_CONVO_CPP_CAPTIONS_HPP
@@ -5,6 +5,7 @@
 #ifndef COG_GROUP_CONVO_CPP_EXPERIMENT_SETUP_HPP
 #define COG_GROUP_CONVO_CPP_EXPERIMENT_SETUP_HPP
 
+#include <string>
 #include <tuple>
 #include <netinet/in.h>
 #include <getopt.h>
@@ -25,12 +26,67 @@ SDL_Color color_string_to_color(const std::string &color_str);
 static struct option long_options[] = {
         {"video_section",       required_argument, nullptr, 'v'},
         {"presentation_method", required_argument, nullptr, 'm'},
+        {"field_of_view",       required_argument, nullptr, 'a'},
         {"foreground_color",    required_argument, nullptr, 'f'},
         {"background_color",    required_argument, nullptr, 'b'},
         {"path_to_font",        required_argument, nullptr, 'p'},
+        {"record_orientation",  required_argument, nullptr, 'r'},
+        {"replay_orientation",  required_argument, nullptr, 'R'},
+        {"replay_speed",        required_argument, nullptr, 's'},
+        {"export",              required_argument, nullptr, 'e'},
+        {"export_fps",          required_argument, nullptr, 'F'},
+        {"batch",               required_argument, nullptr, 'j'},
+        {"workers",             required_argument, nullptr, 'w'},
+        {"scene",               required_argument, nullptr, 'c'},
+        {"blend_benchmark",     required_argument, nullptr, 'B'},
+        {"stream_captions",     no_argument,       nullptr, 'S'},
+        {"viewports",           no_argument,       nullptr, 'V'},
+        {"coalesce_ms",         required_argument, nullptr, 'C'},
+        {"media_clock",         no_argument,       nullptr, 'M'},
+        {"proxy",               required_argument, nullptr, 'P'},
+        {"metrics_socket",      required_argument, nullptr, 'u'},
+        {"governor",            no_argument,       nullptr, 'G'},
+        {"ingest",              required_argument, nullptr, 'I'},
+        {"simulate_asr",        no_argument,       nullptr, 'A'},
+        {"threads",             required_argument, nullptr, 'T'},
+        {"frame_ring",          required_argument, nullptr, 'X'},
+        {"frame_ring_interval", required_argument, nullptr, 'Y'},
+        {nullptr, 0,                               nullptr, 0},
 };
 
-std::tuple<int, int, SDL_Color, SDL_Color, std::string>
-parse_arguments(int argc, char *argv[]);
+/**
+ * Everything the researcher can configure about a trial from the command line.
+ */
+struct ExperimentOptions {
+    int video_section = 0; // Which video section will we be rendering?
+    int presentation_method = 0; // How will we be presenting captions?
+    int half_fov = 0; // What is the user's half field of view?
+    SDL_Color foreground_color{0, 0, 0, 0}; // What color will the text be? RGBA format
+    SDL_Color background_color{0, 0, 0, 0}; // What color will the background behind the text be? RGBA format
+    std::string path_to_font; // Where's the font located?
+    std::string record_orientation_path; // If set, every orientation packet received is recorded to this file
+    std::string replay_orientation_path; // If set, orientation is replayed from this file instead of the HWD
+    double replay_speed = 1.0; // Playback rate of a replayed orientation stream (<= 0 means as fast as possible)
+    std::string export_path; // If set, render the captioned video to this file offline instead of running a trial
+    int export_fps = 30; // Frame rate of an offline export
+    std::string batch_path; // If set, render every job listed in this JSON file instead of running a trial
+    size_t workers = 1; // How many batch jobs to render at once
+    std::string scene_path = "resources/scenes/four_angry_men.json"; // Speaker positions, intervals, fonts and colors
+    int blend_benchmark_iterations = 0; // If positive, benchmark caption blending this many times instead of a trial
+    bool stream_captions = false; // Read the caption track incrementally during the trial instead of loading it up front
+    bool viewports = false; // Draw one view per connected participant instead of a single full-window one
+    int coalesce_ms = 0; // How long captions to sequenced clients wait for others to share their datagram
+    bool media_clock = false; // Reveal captions by the video's playback time on every frame instead of on a timer
+    int proxy_height = 0; // If positive, play video frames from a pre-decoded proxy this many pixels high
+    std::string metrics_socket_path; // If set, live metrics are served on a Unix domain socket here
+    bool governor = false; // Lower the quality in steps when frames can't keep up, and raise it again when they can
+    int ingest_port = 0; // If positive, captions come live from a recognizer on this loopback UDP port instead
+    bool simulate_asr = false; // Send the caption track to the ingest port as a live recognizer would
+    std::string thread_config_path; // If set, CPU pinning and priorities for each of the trial's threads
+    std::string frame_ring_name; // If set, presented frames are published to shared memory under this name
+    int frame_ring_interval = 1; // Only every this many presented frames is read back into the frame ring
+};
+
+ExperimentOptions parse_arguments(int argc, char *argv[]);
 
 #endif //COG_GROUP_CONVO_CPP_EXPERIMENT_SETUP_HPP
@@ -0,0 +1,39 @@
+#ifndef COG_GROUP_CONVO_CPP_FFMPEG_PROCESS_HPP
+#define COG_GROUP_CONVO_CPP_FFMPEG_PROCESS_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * An ffmpeg child process, with a pipe to its stdin or from its stdout.
+ */
+struct FfmpegProcess {
+    pid_t pid;
+    FILE *pipe; // Read ffmpeg's output from this, or write its input to it
+};
+
+/**
+ * Starts ffmpeg with the given arguments, without going through a shell, so paths are passed through exactly as they
+ * are whatever characters they contain. Both ends of the pipe are close-on-exec, so ffmpegs started at the same time
+ * from other threads never inherit (and hold open) each other's pipes. ffmpeg starts with SIGPIPE's default action,
+ * even if the caller ignores it.
+ * @param arguments Everything after "ffmpeg" on the command line
+ * @param reading If true, ffmpeg's stdout is piped to process->pipe; otherwise process->pipe is piped to its stdin
+ * @return false if ffmpeg couldn't be started.
+ */
+bool start_ffmpeg(const std::vector<std::string> &arguments, bool reading, FfmpegProcess *process);
+
+/**
+ * Closes the pipe and waits for ffmpeg to exit.
+ * @return Whether it exited successfully.
+ */
+bool finish_ffmpeg(FfmpegProcess *process);
+
+/**
+ * The command line, for logging. It isn't quoted to be run again.
+ */
+std::string ffmpeg_command_line(const std::vector<std::string> &arguments);
+
+#endif //COG_GROUP_CONVO_CPP_FFMPEG_PROCESS_HPP
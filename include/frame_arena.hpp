@@ -0,0 +1,85 @@
+#ifndef COG_GROUP_CONVO_CPP_FRAME_ARENA_HPP
+#define COG_GROUP_CONVO_CPP_FRAME_ARENA_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include <SDL.h>
+
+/**
+ * Scratch memory for one frame of the render path: caption text, coverage masks and the surfaces captions are
+ * rasterized into. Allocation just bumps a pointer through a block reserved up front, and nothing is freed until
+ * end_frame (called right after SDL_RenderPresent) hands the whole block back at once. A frame that needs more than
+ * the block spills onto the heap, and the block grows to fit at the next end_frame, so spills stop once the render
+ * path has seen its largest frame.
+ *
+ * When built with COG_COUNT_ALLOCATIONS, end_frame also counts every operator new and SDL allocation the render thread
+ * made during the frame, which is how we check the steady-state render path doesn't allocate at all.
+ * Only the render thread may use it.
+ */
+class FrameArena : public std::pmr::memory_resource {
+private:
+    std::vector<std::byte> block;
+    size_t used = 0;
+    size_t needed = 0; // Everything asked for this frame, including spills
+    std::vector<std::pair<void *, std::pair<size_t, size_t>>> spills; // Pointer, size and alignment
+    std::vector<SDL_Surface *> surfaces;
+    size_t surfaces_used = 0;
+    uint64_t frames = 0;
+    uint64_t spilled_frames = 0;
+    uint64_t allocating_frames = 0;
+    uint64_t allocations = 0;
+    uint64_t max_frame_allocations = 0;
+    uint64_t last_allocating_frame = 0;
+    uint64_t allocations_at_frame_start = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+public:
+    const static size_t DEFAULT_CAPACITY = 256 * 1024;
+
+    explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+
+    ~FrameArena() override;
+
+    FrameArena(const FrameArena &) = delete;
+
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    /**
+     * An ARGB8888 surface of at least width x height for this frame to rasterize into. The same surfaces are handed
+     * out again every frame, and only recreated when a caption bigger than any before it comes along.
+     */
+    SDL_Surface *text_surface(int width, int height);
+
+    /**
+     * Releases everything allocated from the arena this frame. Nothing allocated from it may be used afterwards.
+     */
+    void end_frame();
+
+    void print_stats();
+};
+
+/**
+ * Where a frame's temporaries should come from: the arena if there is one, the heap otherwise.
+ */
+std::pmr::memory_resource *frame_memory(FrameArena *arena);
+
+/**
+ * Starts counting this thread's allocations, if built with COG_COUNT_ALLOCATIONS (otherwise does nothing). Has to be
+ * called before SDL allocates anything, so SDL's allocations go through the counter too.
+ */
+void install_allocation_counter();
+
+/**
+ * How many times operator new and SDL's allocators have been called on this thread so far; always 0 unless built
+ * with COG_COUNT_ALLOCATIONS.
+ */
+uint64_t thread_allocation_count();
+
+#endif //COG_GROUP_CONVO_CPP_FRAME_ARENA_HPP
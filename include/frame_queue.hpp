@@ -0,0 +1,67 @@
+#ifndef COG_GROUP_CONVO_CPP_FRAME_QUEUE_HPP
+#define COG_GROUP_CONVO_CPP_FRAME_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * A bounded, blocking FIFO used to hand work between pipeline stages running on different threads.
+ * Producers block while the queue is full and consumers block while it is empty. Once closed, pushes are dropped and
+ * pop() drains whatever is left before returning nullopt.
+ * @tparam T The type of item handed between stages (usually a pointer to a pooled buffer)
+ */
+template<typename T>
+class FrameQueue {
+private:
+    std::deque<T> items;
+    std::mutex items_mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    size_t capacity;
+    bool closed = false;
+
+public:
+    explicit FrameQueue(size_t capacity) : capacity(capacity) {}
+
+    /**
+     * Adds an item to the back of the queue, waiting for room if the queue is full.
+     * @return false if the queue was closed and the item was dropped.
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(items_mutex);
+        not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * Removes the item at the front of the queue, waiting for one if the queue is empty.
+     * @return nullopt once the queue has been closed and drained.
+     */
+    std::optional<T> pop() {
+        std::unique_lock<std::mutex> lock(items_mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return std::nullopt;
+        }
+        T item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return item;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(items_mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+#endif //COG_GROUP_CONVO_CPP_FRAME_QUEUE_HPP
@@ -0,0 +1,110 @@
+#ifndef COG_GROUP_CONVO_CPP_FRAME_RING_HPP
+#define COG_GROUP_CONVO_CPP_FRAME_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <SDL.h>
+
+constexpr uint32_t FRAME_RING_VERSION = 1;
+constexpr uint32_t FRAME_RING_SLOTS = 4; // One being written, and a few frames' grace for consumers reading in place
+constexpr uint32_t FRAME_RING_PIXEL_FORMAT = SDL_PIXELFORMAT_ARGB8888; // B, G, R, A bytes in memory
+constexpr size_t FRAME_RING_HEADER_SIZE = 4096; // The ring header gets a page to itself
+constexpr size_t FRAME_SLOT_HEADER_SIZE = 64;
+#define FRAME_RING_MAGIC "COGF"
+
+/**
+ * The start of the shared memory. Every field but latest_frame is fixed once the ring is created.
+ */
+struct FrameRingHeader {
+    char magic[4]; // FRAME_RING_MAGIC
+    uint32_t version; // FRAME_RING_VERSION
+    uint32_t slot_count;
+    uint32_t max_width; // No frame is bigger than this; a bigger window is cropped to it
+    uint32_t max_height;
+    uint32_t pitch; // Bytes per row, in every slot
+    uint32_t pixel_format; // FRAME_RING_PIXEL_FORMAT
+    uint32_t frame_interval; // Only every frame_interval-th presented frame is published
+    uint64_t slot_size; // Bytes from one slot to the next, header included
+    std::atomic<uint64_t> latest_frame; // Number of the newest frame that's been published, 0 before the first
+};
+
+/**
+ * The start of every slot. Followed (at FRAME_SLOT_HEADER_SIZE) by the frame's pixels.
+ */
+struct FrameSlotHeader {
+    std::atomic<uint64_t> sequence; // Odd while the slot is being written, and bumped again once it's published
+    uint64_t frame_number; // Counts published frames up from 1; frame n is in slot (n - 1) % slot_count
+    int64_t media_time_ms; // The video's playback time
+    int64_t presented_us; // When the frame was presented, on CLOCK_MONOTONIC (the trial metrics' clock)
+    uint64_t caption_revision; // Changes whenever the captions in the frame do
+    float azimuth; // The filtered head orientation (radians) the captions were drawn for
+    uint32_t width; // Of this frame; 0 x 0 if it couldn't be read back
+    uint32_t height;
+};
+
+static_assert(sizeof(FrameRingHeader) == 48, "The ring header's layout is shared with other processes");
+static_assert(sizeof(FrameSlotHeader) <= FRAME_SLOT_HEADER_SIZE, "The slot header must fit before the pixels");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared atomics can't be backed by a lock");
+
+/**
+ * Every presented frame, published to a POSIX shared memory object (/dev/shm/<name>) so local consumers like eye
+ * tracking overlays and recorders can read frames in place, exactly as they were presented, along with what they
+ * showed. The layout is FrameRingHeader, padded to FRAME_RING_HEADER_SIZE, then slot_count slots of slot_size bytes,
+ * each a FrameSlotHeader, padded to FRAME_SLOT_HEADER_SIZE, then height rows of pitch bytes. All integers are in the
+ * host's (little-endian) byte order.
+ *
+ * The player never waits for a consumer. A consumer checks each slot like a seqlock instead:
+ *   1. read latest_frame, and find its slot
+ *   2. read the slot's sequence (acquire); if it's odd, the slot is being written, so try again
+ *   3. use the header and pixels in place
+ *   4. read the sequence again (after an acquire fence); if it's changed, the frame was overwritten while it was being
+ *      read, so whatever was made of it has to be thrown away
+ * Missed frames show up as gaps in frame_number.
+ *
+ * Reading a frame back stalls the render thread until the GPU has finished it, while it holds the renderer, and SDL's
+ * renderer has no asynchronous readback. So how often that cost is paid is up to the trial: only every
+ * frame_interval-th presented frame is read back and published.
+ */
+struct FrameRing {
+    std::string name;
+    int fd;
+    uint8_t *memory;
+    size_t size;
+    FrameRingHeader *header;
+    uint64_t frames; // Published (or being published) so far
+    uint64_t presented; // Frames offered to begin_frame_export, published or not
+    FrameSlotHeader *writing; // The slot between begin_frame_export and end_frame_export, or nullptr
+};
+
+/**
+ * Creates the shared memory for a ring of frames up to max_width x max_height, replacing anything left under the same
+ * name by a previous trial.
+ * @param name As passed to shm_open, e.g. "/cog-frames"
+ * @param frame_interval Publish every frame_interval-th presented frame (1 for all of them)
+ * @return false if the shared memory couldn't be created or mapped, in which case frames aren't published.
+ */
+bool open_frame_ring(const std::string &name, int max_width, int max_height, uint32_t frame_interval,
+                     FrameRing *ring);
+
+/**
+ * Call on the render thread once the frame's composited and before it's presented: if it's this frame's turn, reads
+ * the frame back from the renderer straight into the next slot, which stays marked as being written until
+ * end_frame_export. Otherwise it does nothing.
+ */
+void begin_frame_export(FrameRing *ring, SDL_Renderer *renderer, int64_t media_time_ms, float azimuth,
+                        uint64_t caption_revision);
+
+/**
+ * Call once the frame is presented, to publish it.
+ */
+void end_frame_export(FrameRing *ring);
+
+/**
+ * Unmaps the ring and removes its name, so no new consumer can open it. Consumers that have it mapped already keep
+ * what's there.
+ */
+void close_frame_ring(FrameRing *ring);
+
+#endif //COG_GROUP_CONVO_CPP_FRAME_RING_HPP
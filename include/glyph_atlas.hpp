@@ -0,0 +1,96 @@
+#ifndef COG_GROUP_CONVO_CPP_GLYPH_ATLAS_HPP
+#define COG_GROUP_CONVO_CPP_GLYPH_ATLAS_HPP
+
+#include <array>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+constexpr int FIRST_ATLAS_GLYPH = 32; // ' '
+constexpr int LAST_ATLAS_GLYPH = 126; // '~'
+constexpr int ATLAS_GLYPH_COUNT = LAST_ATLAS_GLYPH - FIRST_ATLAS_GLYPH + 1;
+
+/**
+ * Where a glyph's coverage lives in the atlas, and how far it advances the pen.
+ */
+struct AtlasGlyph {
+    size_t offset; // Index of the glyph's first coverage byte in GlyphAtlas::coverage
+    int width;
+    int height;
+    int advance;
+};
+
+/**
+ * Every printable ASCII glyph of a font, rasterized once into 8-bit coverage masks.
+ *
+ * TTF_Font keeps a mutable glyph cache, so it can't be shared between threads. A GlyphAtlas is never modified after
+ * build_glyph_atlas returns, so any number of render threads can lay out and rasterize captions from the same one.
+ */
+struct GlyphAtlas {
+    std::array<AtlasGlyph, ATLAS_GLYPH_COUNT> glyphs;
+    std::vector<uint8_t> coverage;
+    int height;
+    int line_skip;
+};
+
+/**
+ * Rasterizes every glyph between FIRST_ATLAS_GLYPH and LAST_ATLAS_GLYPH from the given font.
+ * Must be called from a single thread, since it uses the font's glyph cache.
+ */
+GlyphAtlas build_glyph_atlas(TTF_Font *font);
+
+/**
+ * Returns the glyph used for a character. Characters outside the atlas are drawn as '?'.
+ */
+const AtlasGlyph &atlas_glyph(const GlyphAtlas *atlas, char character);
+
+/**
+ * Returns the width and height that rasterize_text will produce for this text. Lines are separated by '\n'.
+ */
+std::tuple<int, int> measure_text(const GlyphAtlas *atlas, std::string_view text);
+
+/**
+ * Lays text out into a width x height coverage mask (as measured by measure_text), taking the max where glyph boxes
+ * overlap. Lines are separated by '\n'. coverage must start out zeroed.
+ */
+void accumulate_text_coverage(const GlyphAtlas *atlas, std::string_view text, int width, int height,
+                              uint8_t *coverage);
+
+/**
+ * Like accumulate_text_coverage, but only for the part of the text inside region (in the text's own coordinates, as
+ * laid out by measure_text), into a region->w x region->h coverage mask. Glyphs that don't reach into the region are
+ * skipped without touching their coverage, and so is the rest of a line once it passes the region's right edge, and
+ * every line below the region.
+ */
+void accumulate_text_coverage_in(const GlyphAtlas *atlas, std::string_view text, const SDL_Rect *region,
+                                 uint8_t *coverage);
+
+/**
+ * Renders text onto a new ARGB8888 surface, shaded like TTF_RenderText_Shaded_Wrapped: the text in foreground_color
+ * over a background_color box. Lines are separated by '\n'. The caller owns (and must free) the surface.
+ */
+SDL_Surface *rasterize_text(const GlyphAtlas *atlas, std::string_view text, const SDL_Color *foreground_color,
+                            const SDL_Color *background_color);
+
+/**
+ * Renders text like rasterize_text, but into the top-left width x height (as measured by measure_text) of an existing
+ * ARGB8888 surface, which must be at least that big, so the same surface can be reused for every caption.
+ * @param scratch Where the coverage mask is allocated
+ */
+void rasterize_text_into(SDL_Surface *surface, const GlyphAtlas *atlas, std::string_view text, int width, int height,
+                         const SDL_Color *foreground_color, const SDL_Color *background_color,
+                         std::pmr::memory_resource *scratch);
+
+/**
+ * Renders just the part of the text inside region (in the text's own coordinates), into the top-left region->w x
+ * region->h of an existing ARGB8888 surface: exactly those pixels of what rasterize_text_into would produce.
+ */
+void rasterize_text_region_into(SDL_Surface *surface, const GlyphAtlas *atlas, std::string_view text,
+                                const SDL_Rect *region, const SDL_Color *foreground_color,
+                                const SDL_Color *background_color, std::pmr::memory_resource *scratch);
+
+#endif //COG_GROUP_CONVO_CPP_GLYPH_ATLAS_HPP
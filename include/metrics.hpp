@@ -0,0 +1,159 @@
+#ifndef COG_GROUP_CONVO_CPP_METRICS_HPP
+#define COG_GROUP_CONVO_CPP_METRICS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+class CaptionServer;
+
+/**
+ * Upper bounds (in milliseconds) of every histogram's buckets, plus one more bucket for anything slower. They span a
+ * fraction of a frame to a few seconds, which covers render times and packet gaps as well as caption lateness.
+ */
+constexpr std::array<double, 16> HISTOGRAM_BOUNDS_MS{0.1, 0.25, 0.5, 1, 2.5, 5, 10, 16, 25, 33, 50, 100, 250, 500,
+                                                     1000, 2500};
+constexpr double DROPPED_FRAME_FACTOR = 1.5; // A gap this many frame periods long means frames were dropped
+
+/**
+ * Counts up from zero. Only ever touched with relaxed atomics, so any thread can count without locking.
+ */
+struct Counter {
+    std::atomic<uint64_t> value{0};
+};
+
+/**
+ * How often each range of values (in milliseconds) was observed, Prometheus style: buckets aren't cumulative here, but
+ * are added up when they're written out.
+ */
+struct Histogram {
+    std::array<std::atomic<uint64_t>, HISTOGRAM_BOUNDS_MS.size() + 1> buckets{};
+    std::atomic<uint64_t> sum_us{0}; // Microseconds, so it can be added to atomically
+};
+
+/**
+ * Everything the trial publishes about itself while it runs. Every field is written with relaxed atomics from whichever
+ * thread the measurement happens on (VLC's, the orientation reader's, the caption stream's), and read the same way by
+ * serve_metrics, so the hot paths never wait on a reader. A snapshot isn't consistent across fields, but each field is
+ * always valid on its own.
+ */
+struct Metrics {
+    // Video, from VLC's callbacks (or the proxy player, which calls the same ones)
+    Counter frames;
+    Counter frames_dropped; // Estimated from gaps between frames that are longer than the frame period
+    Histogram frame_interval_ms; // From one frame being presented to the next
+    Histogram frame_render_ms; // From lock to the frame being presented
+    Counter frames_skipped; // Deliberately, by the quality governor
+    Counter frames_exported; // Published to the shared-memory frame ring
+    Histogram frame_export_ms; // Reading a frame back into the frame ring
+    std::atomic<int64_t> frame_period_us{0}; // 0 until the frame rate is known
+    std::atomic<int64_t> frame_started_us{0};
+    std::atomic<int64_t> frame_presented_us{0};
+    // Head orientation, from the primary client (or the replayed recording)
+    Counter orientation_packets;
+    Counter orientation_rejected; // Malformed packets, and packets from new clients once the server is full
+    Histogram orientation_interval_ms;
+    Histogram filter_lag_ms; // How far behind the latest sample the moving average is
+    std::atomic<int64_t> orientation_received_us{0};
+    // Captions
+    Counter captions_revealed;
+    Histogram caption_lateness_ms; // How long after its scheduled time each caption was revealed
+    Counter captions_transmitted;
+    Histogram transmit_ms; // Encoding a caption and queueing it for every client
+    // Live captions
+    Counter captions_ingested;
+    Counter captions_replaced; // Partial hypotheses corrected by the recognizer
+    Counter captions_stale; // For captions no longer on screen
+    Counter captions_rejected; // Malformed, or from a speaker who isn't in the scene
+    Histogram caption_display_latency_ms; // From a caption arriving to the first frame showing it being presented
+    std::atomic<int64_t> caption_undisplayed_since_us{0}; // When the oldest caption not on screen yet arrived, or 0
+    // The quality governor
+    std::atomic<int64_t> quality_level{0};
+    Counter quality_changes;
+};
+
+/**
+ * The trial's metrics. Like the app events, there's one set for the whole process, so anything can record to it
+ * without it being passed around.
+ */
+extern Metrics trial_metrics;
+
+/**
+ * Microseconds on the steady clock, which is what every timestamp in Metrics is measured in.
+ */
+int64_t metrics_clock_us();
+
+void count(Counter *counter, uint64_t amount = 1);
+
+void observe(Histogram *histogram, double value_ms);
+
+/**
+ * Sets the frame period that dropped frames are measured against. Ignored if fps isn't positive.
+ */
+void set_expected_frame_rate(Metrics *metrics, double fps);
+
+/**
+ * Call from lock, when a frame starts to be drawn.
+ */
+void record_frame_started(Metrics *metrics);
+
+/**
+ * Call once a frame has been presented.
+ */
+void record_frame_presented(Metrics *metrics);
+
+/**
+ * Call instead of record_frame_presented for a frame that's deliberately not drawn, so it isn't counted as dropped.
+ */
+void record_frame_skipped(Metrics *metrics);
+
+/**
+ * Call for every orientation sample that drives what's on screen. The filter lag is the moving average's delay: half its
+ * window, in sample intervals.
+ */
+void record_orientation_sample(Metrics *metrics);
+
+/**
+ * Call when a caption is revealed, lateness_ms after it was due.
+ */
+void record_caption_revealed(Metrics *metrics, double lateness_ms);
+
+/**
+ * Call when a live caption arrives at arrived_us (and has been put in the caption model).
+ */
+void record_caption_arrived(Metrics *metrics, int64_t arrived_us);
+
+/**
+ * Call before drawing a frame's captions. Returns when the oldest caption that will be in the frame arrived (0 if
+ * there's none that isn't already on screen), to pass to record_captions_displayed once the frame's presented.
+ */
+int64_t undisplayed_caption_since(const Metrics *metrics);
+
+void record_captions_displayed(Metrics *metrics, int64_t undisplayed_since_us);
+
+/**
+ * Writes the metrics (and, if there's a server, each client's stats) in the Prometheus text exposition format.
+ */
+std::string format_metrics(const Metrics *metrics, CaptionServer *server);
+
+/**
+ * Creates a Unix domain socket listening at path, replacing anything left there by a previous trial.
+ */
+int open_metrics_socket(const std::string &path);
+
+/**
+ * Writes a snapshot of the metrics to every connection made to the socket, then closes it, until the socket is shut
+ * down. Connections that send an HTTP request (e.g. curl --unix-socket) get an HTTP response, and anything else (e.g.
+ * socat) just gets the snapshot.
+ */
+void serve_metrics(int socket, const Metrics *metrics, CaptionServer *server);
+
+/**
+ * Stops serve_metrics and waits for its thread, then closes the socket and removes it from the filesystem.
+ */
+void close_metrics_socket(int socket, const std::string &path, std::thread *metrics_thread);
+
+#endif //COG_GROUP_CONVO_CPP_METRICS_HPP
@@ -0,0 +1,45 @@
+#ifndef COG_GROUP_CONVO_CPP_OFFLINE_EXPORT_HPP
+#define COG_GROUP_CONVO_CPP_OFFLINE_EXPORT_HPP
+
+#include <string>
+#include <vector>
+#include "AppContext.hpp"
+#include "captions.hpp"
+#include "orientation_recording.hpp"
+
+// How many frames can be in flight between the decode, composite and encode stages at once.
+constexpr size_t EXPORT_PIPELINE_DEPTH = 8;
+
+// Synthetic head motion used when no recording is given: a slow sweep across the table, like a participant
+// following the conversation.
+constexpr double SYNTHETIC_SWEEP_AMPLITUDE = 0.5; // radians
+constexpr double SYNTHETIC_SWEEP_PERIOD_MS = 20000;
+constexpr double SYNTHETIC_SAMPLE_RATE = 60; // samples per second, roughly what the HWD sends
+
+struct ExportStats {
+    size_t frames;
+    double seconds;
+    bool succeeded; // Whether output_path holds the whole video: both ffmpegs exited cleanly, and every frame was written
+};
+
+/**
+ * Renders main.<section>.mp4 with captions composited exactly as a participant would have seen them, and encodes the
+ * result to output_path. Nothing here waits on a display clock: frames are decoded, composited and encoded as fast as
+ * possible, with each of those three stages running on its own thread.
+ *
+ * Decoding and encoding go through ffmpeg pipes. Compositing uses an SDL software renderer per frame buffer, so the
+ * same presentation methods used on screen draw straight into the decoded frame.
+ * @param prototype A fully set up AppContext (fonts, arrows, juror layout, colors, presentation method). Its renderer,
+ * texture, caption model and azimuth buffer are not used.
+ * @param cues The caption track for this section
+ * @param orientation A recorded session to drive head orientation with. If empty, a synthetic sweep is used instead.
+ * @param output_path Where to write the captioned video
+ * @param fps The frame rate to decode and encode at
+ * @return Not succeeded if the video couldn't be read, or either ffmpeg couldn't be started or failed, so a failed job
+ * never takes the rest of a batch down with it.
+ */
+ExportStats export_captioned_video(const AppContext *prototype, const std::vector<CaptionCue> *cues,
+                                   const std::vector<OrientationRecord> *orientation, const std::string &output_path,
+                                   int fps);
+
+#endif //COG_GROUP_CONVO_CPP_OFFLINE_EXPORT_HPP
@@ -5,6 +5,7 @@
 #include <netinet/in.h>
 #include <mutex>
 #include "AppContext.hpp"
+#include "orientation_recording.hpp"
 
 const static int INCHES_FROM_SCREEN = 24; // inches
 constexpr int SCREEN_PIXEL_WIDTH = 3840;
@@ -17,15 +18,49 @@ constexpr size_t MOVING_AVG_SIZE = 60;
 
 constexpr double PI = 3.14159265358979323846;
 
+// angle_to_pixel_position is looked up in a table of this many entries per turn (about 0.02 degrees apart), rather
+// than worked out with std::tan every time.
+constexpr int AZIMUTH_TABLE_BITS = 14;
+constexpr int AZIMUTH_TABLE_SIZE = 1 << AZIMUTH_TABLE_BITS;
+constexpr int PIXEL_FRACTION_BITS = 16; // Table entries are pixels in 16.16 fixed point
+constexpr int MAX_TABLE_PIXELS = 32767; // Positions near +-90 degrees are clamped to this, so they fit the table
+
 int to_pixels(double inches);
 
+/**
+ * Where on screen (in pixels, relative to straight ahead) something at the given angle appears, for a viewer
+ * INCHES_FROM_SCREEN from a screen with PIXELS_PER_INCH.
+ * Interpolated from the precomputed azimuth table, so it costs a multiply and two loads instead of a std::tan.
+ */
 int angle_to_pixel_position(double angle);
 
+/**
+ * The same as angle_to_pixel_position, but with std::tan. Only used to build the table.
+ */
+int exact_angle_to_pixel_position(double angle);
+
 double to_radians(double degrees);
 
-void read_orientation(int socket, sockaddr_in *client_address, std::mutex *azimuth_mutex,
-                      std::deque<float> *orientation_buffer);
+/**
+ * Pushes an azimuth (in radians) into the moving-average window used by filtered_azimuth, wrapping it to [0, 2*PI).
+ * @return The wrapped azimuth that was pushed.
+ */
+float push_azimuth(float azimuth, std::mutex *azimuth_mutex, std::deque<float> *orientation_buffer);
+
+/**
+ * Whether the size bytes at buffer are a well-formed OrientationMessage, and so safe for push_orientation_sample.
+ */
+bool verify_orientation_sample(const uint8_t *buffer, size_t size);
+
+/**
+ * Decodes an OrientationMessage buffer and pushes its azimuth into the moving-average window used by filtered_azimuth.
+ * @return The azimuth (in radians, wrapped to [0, 2*PI)) that was pushed.
+ */
+float push_orientation_sample(const uint8_t *buffer, std::mutex *azimuth_mutex, std::deque<float> *orientation_buffer);
 
-double filtered_azimuth(std::deque<float> *azimuth_buffer, std::mutex *azimuth_mutex);
+/**
+ * The moving average of the latest `taps` azimuths in the buffer (or all of them, if there are fewer).
+ */
+double filtered_azimuth(std::deque<float> *azimuth_buffer, std::mutex *azimuth_mutex, size_t taps = MOVING_AVG_SIZE);
 
 #endif //COG_GROUP_CONVO_CPP_ORIENTATION_HPP
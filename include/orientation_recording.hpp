@@ -0,0 +1,113 @@
+#ifndef COG_GROUP_CONVO_CPP_ORIENTATION_RECORDING_HPP
+#define COG_GROUP_CONVO_CPP_ORIENTATION_RECORDING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * On-disk layout of a recording: an 8 byte file header ("COGO" followed by a little-endian uint32 version), then a
+ * sequence of records that are only ever appended. Every record is a 12 byte header followed by `size` payload bytes:
+ *
+ *   uint8  kind          (ORIENTATION_SAMPLE, PLAYBACK_STARTED or QUALITY_CHANGE)
+ *   uint8  reserved
+ *   uint16 size          (number of payload bytes)
+ *   uint64 timestamp_us  (microseconds since the recorder was opened)
+ *
+ * The payload of an ORIENTATION_SAMPLE is the OrientationMessage flatbuffer exactly as it came off the wire. The payload
+ * of a QUALITY_CHANGE is a single byte, the QualityLevel the quality governor changed to; replays skip them, they're
+ * there so the trial's data can be annotated with when it was running degraded.
+ */
+constexpr char ORIENTATION_RECORDING_MAGIC[4] = {'C', 'O', 'G', 'O'};
+constexpr uint32_t ORIENTATION_RECORDING_VERSION = 1;
+
+enum OrientationRecordKind : uint8_t {
+    ORIENTATION_SAMPLE = 0,
+    PLAYBACK_STARTED = 1,
+    QUALITY_CHANGE = 2,
+};
+
+struct OrientationRecord {
+    uint64_t timestamp_us;
+    OrientationRecordKind kind;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * Appends timestamped orientation packets to a recording file. Safe to share between the thread receiving orientation
+ * and the thread that starts playback. If a write fails, it's reported and the recording stops there; everything
+ * recorded up to then can still be loaded.
+ */
+class OrientationRecorder {
+private:
+    std::string path;
+    FILE *file = nullptr; // nullptr once closed, or once a write has failed
+    std::mutex file_mutex;
+    std::chrono::steady_clock::time_point opened_at;
+    size_t records_since_flush = 0;
+    size_t oversized_samples = 0; // Too big for a record, so left out
+    const static size_t FLUSH_INTERVAL = 64;
+
+    void append(OrientationRecordKind kind, const uint8_t *payload, uint16_t size);
+
+public:
+    explicit OrientationRecorder(const std::string &path);
+
+    ~OrientationRecorder();
+
+    OrientationRecorder(const OrientationRecorder &) = delete;
+
+    OrientationRecorder &operator=(const OrientationRecorder &) = delete;
+
+    /**
+     * Records a raw OrientationMessage buffer, timestamped with the time it was received. Buffers over UINT16_MAX bytes
+     * don't fit in a record, so they're left out (and counted when the recorder is closed).
+     */
+    void record_sample(const uint8_t *buffer, size_t size);
+
+    /**
+     * Records the moment the video (and captions) started playing, so a replay can line the samples up with media time.
+     */
+    void mark_playback_started();
+
+    /**
+     * Records the quality governor changing the quality level.
+     */
+    void mark_quality_changed(int quality_level);
+
+    void close();
+};
+
+/**
+ * Reads every record from a recording made by OrientationRecorder. Exits if the file can't be read. Orientation samples
+ * that aren't well-formed OrientationMessages are skipped (and reported), so every sample returned is safe to decode.
+ */
+std::vector<OrientationRecord> load_orientation_recording(const std::string &path);
+
+/**
+ * Returns the timestamp (in microseconds) of the PLAYBACK_STARTED record, or of the first record if playback was never
+ * marked. Samples are replayed relative to this point.
+ */
+uint64_t playback_origin_us(const std::vector<OrientationRecord> &records);
+
+/**
+ * Feeds a recorded session back into the orientation buffer, exactly as serve_clients would have.
+ * Samples recorded before playback started are replayed immediately, so the moving average is primed by the time the
+ * video starts. The remaining samples are replayed once `started` is set, at `speed` times their original rate.
+ * @param records The recorded session, from load_orientation_recording
+ * @param speed Playback rate relative to the original timing. Anything <= 0 replays as fast as possible.
+ * @param started Set by the main loop when playback starts
+ * @param stopping Set by the main loop when the trial ends; the replay gives up as soon as it is
+ * @param azimuth_mutex Guards orientation_buffer
+ * @param orientation_buffer The buffer that filtered_azimuth averages over
+ */
+void replay_orientation(const std::vector<OrientationRecord> *records, double speed, const std::atomic<bool> *started,
+                        const std::atomic<bool> *stopping, std::mutex *azimuth_mutex,
+                        std::deque<float> *orientation_buffer);
+
+#endif //COG_GROUP_CONVO_CPP_ORIENTATION_RECORDING_HPP
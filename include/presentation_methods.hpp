@@ -3,11 +3,17 @@
 
 #include <SDL.h>
 #include <optional>
-#include <SDL_ttf.h>
 #include "AppContext.hpp"
+#include "glyph_atlas.hpp"
 
-constexpr int WRAP_LENGTH = 0;
 constexpr int HALF_FOV = 40;
+constexpr int MIN_FIELD_OF_VIEW = 2; // Full view angles, in degrees, that a client or render job may ask for
+constexpr int MAX_FIELD_OF_VIEW = 180;
+
+#define REGISTERED_GRAPHICS 1
+#define NONREGISTERED_GRAPHICS 2
+#define NONREGISTERED_GRAPHICS_WITH_ARROWS 3
+#define CONTROL 4
 
 /**
  * Return the intersection between two SDL_Rects as another SDL_Rect. If there is no intersection, return nullopt
@@ -28,23 +34,6 @@ std::optional<SDL_Rect> rectangle_intersection(const SDL_Rect *a, const SDL_Rect
 void render_surface_as_texture(SDL_Renderer *renderer, SDL_Surface *surface, SDL_Rect *source_rect,
                                SDL_Rect *destination_rect);
 
-/**
- * Renders the given text on the renderer using the position, colors, and font provided.
- * Returns the width and height of the texture rendered.
- * @param renderer A pointer to an SDL_Renderer, to which the text will be rendered
- * @param font A pointer to a TTF_Font, which will be used to display the text.
- * @param text The actual string to be displayed
- * @param x The x location at which to display the string
- * @param y The y location at which to display the string
- * @param foreground_color The color of the text
- * @param background_color The color of the background
- * @return
- */
-std::tuple<int, int>
-render_text(SDL_Renderer *renderer, TTF_Font *font, const std::string &text, int x, int y,
-            const SDL_Color *foreground_color, const SDL_Color *background_color);
-
-
 void render_nonregistered_captions(const AppContext *context);
 
 /**
@@ -60,4 +49,22 @@ void render_nonregistered_captions_with_indicators(const AppContext *context);
  */
 void render_registered_captions(const AppContext *context);
 
+/**
+ * Returns the pipeline that draws captions with the given presentation method. This is the only place the method is
+ * switched on; everything the pipeline does per frame is fixed when it's compiled.
+ */
+CaptionPipeline caption_pipeline(int presentation_method);
+
+/**
+ * Sets the context's presentation method, and selects its pipeline if the method changed. Anything that changes a
+ * context's presentation method should go through here.
+ */
+void set_presentation_method(AppContext *context, int presentation_method);
+
+/**
+ * Renders captions on top of the current frame, using whichever presentation method the researcher selected.
+ * @param context
+ */
+void render_captions(const AppContext *context);
+
 #endif //COG_GROUP_CONVO_CPP_PRESENTATION_METHODS_HPP
@@ -0,0 +1,57 @@
+#ifndef COG_GROUP_CONVO_CPP_PROXY_CACHE_HPP
+#define COG_GROUP_CONVO_CPP_PROXY_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+constexpr uint32_t PROXY_CACHE_VERSION = 1;
+constexpr int PROXY_FPS = 30; // Frame rate the section is decoded at
+#define PROXY_CACHE_MAGIC "COGP"
+
+/**
+ * A video section decoded once into raw BGR565 frames (the same format VLC hands the player) at a lower resolution,
+ * and memory-mapped, so showing any frame of it (the first one, or one straight after a seek) is just a copy into the
+ * video texture. The cache lives next to the video (e.g. resources/videos/main.1.mp4.360p.proxy) and is regenerated
+ * when the video changes.
+ *
+ * File layout (all integers little-endian):
+ *   char[4] magic          (PROXY_CACHE_MAGIC)
+ *   uint32  version        (PROXY_CACHE_VERSION)
+ *   uint64  video size     (of the source video, in bytes)
+ *   uint64  video mtime
+ *   uint32  width
+ *   uint32  height
+ *   uint32  fps
+ *   uint64  frame count
+ *   then frame count frames of width * height * 2 bytes, back to back.
+ * Every frame is the same size, so frame i is found at a fixed offset; there's no separate index to keep.
+ */
+struct ProxyCache {
+    int width;
+    int height;
+    int fps;
+    size_t frame_count;
+    size_t frame_size;
+    const uint8_t *frames;
+    void *mapping;
+    size_t mapping_size;
+};
+
+/**
+ * Maps the proxy for main.<video_section>.mp4 at the given size, decoding the video into it first (with ffmpeg) if
+ * there isn't an up-to-date one yet. That can take a while, but only happens once per video and size.
+ * @return false if the proxy couldn't be built or mapped, in which case VLC should decode the video as usual.
+ */
+bool load_proxy_cache(int video_section, int width, int height, ProxyCache *proxy);
+
+/**
+ * The frame on screen at media_time_ms, which is held on the last frame once the proxy runs out.
+ */
+size_t proxy_frame_index(const ProxyCache *proxy, double media_time_ms);
+
+const uint8_t *proxy_frame(const ProxyCache *proxy, size_t index);
+
+void close_proxy_cache(ProxyCache *proxy);
+
+#endif //COG_GROUP_CONVO_CPP_PROXY_CACHE_HPP
@@ -0,0 +1,95 @@
+#ifndef COG_GROUP_CONVO_CPP_QUALITY_GOVERNOR_HPP
+#define COG_GROUP_CONVO_CPP_QUALITY_GOVERNOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <SDL.h>
+#include "orientation.hpp"
+
+/**
+ * The steps the governor degrades through, in order. Each one keeps everything the ones before it gave up.
+ */
+enum QualityLevel {
+    FULL_QUALITY = 0,
+    REDUCED_RESOLUTION = 1, // VLC decodes to a texture DECODE_SCALE_DIVISOR times smaller, scaled up to the window
+    SHORT_ORIENTATION_FILTER = 2, // The moving average only covers the last SHORT_FILTER_TAPS samples
+    CACHED_CAPTIONS_ONLY = 3, // Captions are rasterized at most every CACHED_CAPTION_REFRESH_MS, and drawn from the cache
+    SKIPPING_FRAMES = 4, // Every other frame is decoded but never uploaded, composited or presented
+};
+constexpr int LOWEST_QUALITY = SKIPPING_FRAMES;
+
+constexpr size_t GOVERNOR_WINDOW_FRAMES = 60; // Frames judged together before deciding anything
+constexpr double OVERLOADED_FRACTION = 0.75; // Mean render time over this much of the frame budget is too slow...
+constexpr uint64_t OVERLOADED_DROPPED_FRAMES = 3; // ...and so is dropping this many frames in a window
+constexpr double HEADROOM_FRACTION = 0.4; // Windows under this much of the budget, with no drops, have room to spare
+constexpr int RECOVERY_WINDOWS = 3; // Consecutive windows with room to spare before quality is raised a step
+constexpr int64_t DEFAULT_FRAME_PERIOD_US = 1000000 / 30; // Until the media's frame rate is known
+constexpr size_t SHORT_FILTER_TAPS = MOVING_AVG_SIZE / 4;
+constexpr int DECODE_SCALE_DIVISOR = 2;
+
+/**
+ * Watches how long each frame takes to draw against the time the video gives it, and lowers the quality a step at a
+ * time when frames don't fit (or are being dropped), raising it again once there's room to spare. Every change is
+ * logged, and posted to the main loop as QUALITY_CHANGED so it can change the decode resolution and annotate the
+ * recording.
+ *
+ * The level can be read from any thread; everything else is only for the render thread (VLC's, or the proxy player's).
+ */
+class QualityGovernor {
+private:
+    std::atomic<int> level{FULL_QUALITY};
+    bool can_reduce_resolution;
+    std::chrono::steady_clock::time_point created_at;
+    size_t window_frames = 0;
+    double window_render_ms = 0;
+    uint64_t window_start_dropped = 0;
+    int windows_with_headroom = 0;
+    bool settling = false; // The window straight after a change is thrown away, it's still catching up
+    uint64_t frame_number = 0;
+    bool skipping = false;
+    std::vector<uint8_t> skip_buffer;
+
+    void change_level(int new_level, const char *reason, double mean_render_ms, double budget_ms, uint64_t dropped);
+
+public:
+    /**
+     * @param can_reduce_resolution Whether there's a decoder to lower the resolution of (there isn't with a proxy, which
+     * is already low resolution), and captions would stay in step with it restarting; if not, that step is passed over
+     */
+    explicit QualityGovernor(bool can_reduce_resolution);
+
+    int quality_level() const;
+
+    /**
+     * Call at the start of lock. If this frame is to be skipped, points p_pixels at a scratch buffer the size of the
+     * texture for VLC to decode into, and returns true; lock, unlock and display should then leave everything alone.
+     */
+    bool begin_frame(SDL_Texture *texture, void **p_pixels);
+
+    /**
+     * Whether the frame begin_frame was last called for is being skipped.
+     */
+    bool skipping_frame() const;
+
+    /**
+     * Call once a frame has been presented (and recorded in the trial metrics). Decides whether to change the level
+     * at the end of every window.
+     */
+    void end_frame();
+
+    static const char *level_name(int level);
+};
+
+/**
+ * How many of the latest orientation samples filtered_azimuth should average over.
+ */
+size_t orientation_filter_taps(const QualityGovernor *governor);
+
+/**
+ * Whether captions should come from the texture cache (even if they're a little behind) rather than be rasterized.
+ */
+bool cached_captions_only(const QualityGovernor *governor);
+
+#endif //COG_GROUP_CONVO_CPP_QUALITY_GOVERNOR_HPP
@@ -0,0 +1,45 @@
+#ifndef COG_GROUP_CONVO_CPP_RENDER_CONFIG_HPP
+#define COG_GROUP_CONVO_CPP_RENDER_CONFIG_HPP
+
+#include <memory>
+#include <vector>
+#include "AppContext.hpp"
+#include "caption_layout.hpp"
+
+/**
+ * Everything the main loop can change while VLC is rendering: the window size, and what depends on it (the caption
+ * layout, and the glyph atlases the fonts are drawn with at that size).
+ * Snapshots are immutable once published. The main loop swaps in a new one with publish_render_config, and the render
+ * thread picks it up at the start of its next frame with apply_render_config, so it never sees a half-updated config
+ * and never has to wait on the main loop.
+ */
+struct RenderConfig {
+    int window_width;
+    int window_height;
+    int y; // Where non-registered captions go
+    std::shared_ptr<const CaptionLayout> caption_layout;
+    std::shared_ptr<const std::vector<GlyphAtlas>> glyph_atlases; // nullptr when fonts are at the scene's own sizes
+};
+
+/**
+ * Derives glyph atlases at font_scale times the scene's font sizes (unless it's 1), lays the caption track out for the
+ * given window size with them, and wraps both up in a new snapshot.
+ */
+std::shared_ptr<const RenderConfig> create_render_config(const std::vector<CaptionCue> &cues,
+                                                         const SpeakerRegistry *speakers, int window_width,
+                                                         int window_height, int y, double font_scale);
+
+/**
+ * Makes config the one the render thread uses from its next frame on. Safe to call from any thread.
+ */
+void publish_render_config(AppContext *context, std::shared_ptr<const RenderConfig> config);
+
+/**
+ * Copies the latest published snapshot into the context's window size, display rect, y, caption layout and glyph
+ * atlases, and keeps
+ * the snapshot alive for as long as the context uses it. Only the render thread should call this.
+ * @return true if the snapshot changed since the last call.
+ */
+bool apply_render_config(AppContext *context);
+
+#endif //COG_GROUP_CONVO_CPP_RENDER_CONFIG_HPP
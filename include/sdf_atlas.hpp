@@ -0,0 +1,56 @@
+#ifndef COG_GROUP_CONVO_CPP_SDF_ATLAS_HPP
+#define COG_GROUP_CONVO_CPP_SDF_ATLAS_HPP
+
+#include <array>
+#include <string>
+#include <vector>
+#include <SDL_ttf.h>
+#include "glyph_atlas.hpp"
+
+constexpr int SDF_REFERENCE_SIZE = 64; // Point size the distance fields are generated at
+constexpr int SDF_SPREAD = 6; // How far (in reference pixels) from a glyph's edge distances are encoded
+constexpr uint32_t SDF_CACHE_VERSION = 1;
+#define SDF_CACHE_MAGIC "COGS"
+
+/**
+ * A glyph's distance field. The field covers the glyph's bitmap plus SDF_SPREAD pixels of padding on every side.
+ */
+struct SdfGlyph {
+    size_t offset; // Index of the field's first byte in SdfAtlas::distance
+    int width; // Size of the glyph's bitmap at the reference size, not counting padding
+    int height;
+    int advance;
+};
+
+/**
+ * Signed distance fields for every printable ASCII glyph of a font, generated once per font file at
+ * SDF_REFERENCE_SIZE. A GlyphAtlas for any font size can be derived from it without touching FreeType, so different
+ * speakers (or conditions) can use different sizes without opening the font again.
+ *
+ * Distances are stored as bytes: 128 is the glyph's edge, larger is inside, and every step of 127 / SDF_SPREAD is one
+ * reference pixel.
+ */
+struct SdfAtlas {
+    std::array<SdfGlyph, ATLAS_GLYPH_COUNT> glyphs;
+    std::vector<uint8_t> distance;
+    int height;
+    int line_skip;
+};
+
+/**
+ * Rasterizes every glyph from a font opened at SDF_REFERENCE_SIZE, and turns each one into a distance field.
+ */
+SdfAtlas build_sdf_atlas(TTF_Font *font);
+
+/**
+ * Returns the SDF atlas for a font file, reading it from <path_to_font>.sdf if that cache is up to date, and
+ * otherwise generating it (and writing the cache, if possible). Exits if the font can't be opened.
+ */
+SdfAtlas load_sdf_atlas(const std::string &path_to_font);
+
+/**
+ * Derives the coverage atlas for a font size from the distance fields, with a one-pixel anti-aliased edge.
+ */
+GlyphAtlas glyph_atlas_from_sdf(const SdfAtlas *sdf, int font_size);
+
+#endif //COG_GROUP_CONVO_CPP_SDF_ATLAS_HPP
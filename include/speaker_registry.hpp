@@ -0,0 +1,108 @@
+#ifndef COG_GROUP_CONVO_CPP_SPEAKER_REGISTRY_HPP
+#define COG_GROUP_CONVO_CPP_SPEAKER_REGISTRY_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <SDL.h>
+#include "cog-flatbuffer-definitions/caption_message_generated.h"
+#include "glyph_atlas.hpp"
+#include "sdf_atlas.hpp"
+
+/**
+ * Dense index of a speaker in the SpeakerRegistry, in the order the scene config lists them.
+ */
+using SpeakerId = uint8_t;
+
+/**
+ * Everything we need to know about each person speaking in the video, stored as parallel arrays indexed by SpeakerId
+ * so per-frame lookups are a single array access.
+ */
+struct SpeakerRegistry {
+    std::vector<std::string> ids; // The speaker_id used in the caption tracks, e.g. "juror-a"
+    std::vector<cog::Juror> wire_ids; // What's sent to the HWD for this speaker
+    std::vector<double> anchor_x; // Where registered captions go, as fractions of the window size
+    std::vector<double> anchor_y;
+    std::vector<double> interval_width; // How wide (in pixels) the speaker's interval is, starting at anchor_x
+    std::vector<int> font_sizes;
+    std::vector<size_t> font_index; // Index into glyph_atlases of the speaker's font size
+    std::vector<SDL_Color> colors; // Foreground color of the speaker's captions
+
+    // One entry per distinct font size, shared between speakers, all derived from the same distance fields.
+    std::vector<int> distinct_font_sizes;
+    std::vector<GlyphAtlas> glyph_atlases;
+    SdfAtlas sdf_atlas;
+};
+
+/**
+ * Reads a scene config shaped like:
+ *
+ *   {"reference_size": [1920, 1080],
+ *    "speakers": [{"id": "juror-a", "juror": "JurorA", "anchor": [1050, 550], "interval_width": 300,
+ *                  "font_size": 26, "color": "255,255,255,255"}, ...]}
+ *
+ * Anchors are in pixels of a reference_size frame. "juror" is the name of the cog::Juror sent to the HWD for that
+ * speaker, and no two speakers may share one, so a scene has at most as many speakers as there are cog::Juror values.
+ * "font_size" and "color" are optional, defaulting to default_font_size and default_color.
+ * Exits if the config can't be read, or two speakers share a juror.
+ */
+SpeakerRegistry load_speaker_registry(const std::string &path, int default_font_size, SDL_Color default_color);
+
+/**
+ * Returns the SpeakerId for a caption track speaker_id. Exits if the speaker isn't in the scene.
+ */
+SpeakerId speaker_from_string(const SpeakerRegistry *registry, const std::string &speaker_str);
+
+/**
+ * Finds the speaker that's sent to the HWD as wire_id.
+ * @return false if no speaker in the scene is.
+ */
+bool speaker_from_wire_id(const SpeakerRegistry *registry, cog::Juror wire_id, SpeakerId *speaker);
+
+/**
+ * Loads the font's distance fields (generating them the first time a font file is used) and derives a GlyphAtlas for
+ * every distinct font size in the registry. Atlases are read-only afterwards, so any thread can draw from them.
+ */
+void load_speaker_fonts(SpeakerRegistry *registry, const std::string &path_to_font);
+
+/**
+ * Derives a GlyphAtlas for every distinct font size in the registry, scaled by font_scale (e.g. after the window has
+ * been resized), from the distance fields load_speaker_fonts loaded. They're indexed like glyph_atlases, so font_index
+ * works for either. Only reads the registry, so it's safe while the render thread is drawing.
+ */
+std::vector<GlyphAtlas> derive_speaker_atlases(const SpeakerRegistry *registry, double font_scale);
+
+void close_speaker_fonts(SpeakerRegistry *registry);
+
+inline size_t speaker_count(const SpeakerRegistry *registry) {
+    return registry->ids.size();
+}
+
+/**
+ * Returns the speaker's glyph atlas, or nullptr if load_speaker_fonts hasn't been called.
+ */
+inline const GlyphAtlas *speaker_atlas(const SpeakerRegistry *registry, SpeakerId speaker) {
+    return registry->glyph_atlases.empty() ? nullptr : &registry->glyph_atlases[registry->font_index[speaker]];
+}
+
+/**
+ * Returns the speaker's atlas from glyph_atlases (from derive_speaker_atlases), or from the registry's own atlases if
+ * that's nullptr.
+ */
+inline const GlyphAtlas *speaker_atlas(const SpeakerRegistry *registry, const std::vector<GlyphAtlas> *glyph_atlases,
+                                       SpeakerId speaker) {
+    return glyph_atlases == nullptr ? speaker_atlas(registry, speaker)
+                                    : &(*glyph_atlases)[registry->font_index[speaker]];
+}
+
+/**
+ * Returns the left and right edges (in pixels) of the speaker's interval in a window of the given width.
+ */
+inline std::pair<double, double> speaker_interval(const SpeakerRegistry *registry, SpeakerId speaker,
+                                                  int window_width) {
+    const double left = registry->anchor_x[speaker] * window_width;
+    return std::make_pair(left, left + registry->interval_width[speaker]);
+}
+
+#endif //COG_GROUP_CONVO_CPP_SPEAKER_REGISTRY_HPP
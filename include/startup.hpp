@@ -0,0 +1,51 @@
+#ifndef COG_GROUP_CONVO_CPP_STARTUP_HPP
+#define COG_GROUP_CONVO_CPP_STARTUP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * One step of getting a trial ready (opening the window, decoding an image, scanning VLC's plugins...).
+ */
+struct StartupStep {
+    std::string name;
+    std::function<void()> run;
+    std::vector<size_t> dependencies; // Steps that must have finished before this one starts
+    bool main_thread; // Whether this step has to run on the thread that called run_startup_graph (e.g. window creation)
+    double started_ms; // Filled in by run_startup_graph, relative to when the graph started
+    double finished_ms;
+};
+
+/**
+ * Everything that has to happen before a trial can start, and which of it depends on what. Anything that doesn't
+ * depend on something else runs at the same time as it.
+ */
+struct StartupGraph {
+    std::vector<StartupStep> steps;
+    double finished_ms; // How long the whole graph took
+};
+
+/**
+ * Adds a step to the graph.
+ * @param dependencies Indices (as returned by this function) of the steps that must finish first
+ * @param main_thread Whether the step must run on the thread that calls run_startup_graph. SDL's video functions
+ * generally have to be called from the main thread.
+ * @return The step's index, to depend on it.
+ */
+size_t add_startup_step(StartupGraph *graph, const std::string &name, std::function<void()> run,
+                        const std::vector<size_t> &dependencies = {}, bool main_thread = false);
+
+/**
+ * Runs every step in the graph, each as soon as its dependencies have finished, on the calling thread plus up to
+ * `workers` threads of its own. Returns once every step has finished. Exits if the graph has a cycle.
+ */
+void run_startup_graph(StartupGraph *graph, size_t workers);
+
+/**
+ * Prints when each step started and how long it took, in the order they started.
+ */
+void print_startup_timings(const StartupGraph *graph);
+
+#endif //COG_GROUP_CONVO_CPP_STARTUP_HPP
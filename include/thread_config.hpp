@@ -0,0 +1,131 @@
+#ifndef COG_GROUP_CONVO_CPP_THREAD_CONFIG_HPP
+#define COG_GROUP_CONVO_CPP_THREAD_CONFIG_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include "metrics.hpp"
+
+/**
+ * Every long-running thread of a trial, by what it does. Each gets its own name (as shown by top -H, ps -L or a
+ * debugger) and can be given its own CPU and priority.
+ */
+enum TrialThread {
+    RENDER_THREAD = 0, // VLC's video output thread (lock/unlock/display), or the proxy player
+    ORIENTATION_THREAD = 1, // Receives orientation from the HWDs, or replays a recording
+    CAPTION_THREAD = 2, // Reveals captions on their schedule
+    SENDER_THREAD = 3, // Sends queued captions to the HWDs
+    CAPTION_READER_THREAD = 4, // Reads ahead in a streamed caption track
+    INGEST_THREAD = 5, // Receives live captions
+    SIMULATOR_THREAD = 6, // Stands in for a live recognizer
+    METRICS_THREAD = 7, // Serves the live metrics
+};
+constexpr size_t TRIAL_THREAD_COUNT = 8;
+constexpr std::chrono::milliseconds PLAYBACK_POLL{1}; // How often a thread waiting for playback checks if it's started
+constexpr std::chrono::milliseconds STOP_POLL{50}; // How often a sleeping thread checks if the trial is stopping
+
+/**
+ * How one kind of thread should be scheduled. Anything left at its default is left to the OS.
+ */
+struct ThreadSettings {
+    int cpu = -1; // The only CPU it may run on, or -1 for any
+    int realtime_priority = 0; // If positive, run it SCHED_FIFO at this priority
+    int nice = 0; // Otherwise, its nice value
+};
+
+struct ThreadConfig {
+    std::array<ThreadSettings, TRIAL_THREAD_COUNT> threads{};
+};
+
+/**
+ * How late a kind of thread woke up, compared to when it meant to.
+ */
+struct WakeupJitter {
+    Histogram lateness_ms;
+    std::atomic<int64_t> max_us{0};
+};
+
+/**
+ * The scheduling every trial thread is configured with as it starts. Set it before any trial thread is started.
+ */
+extern ThreadConfig trial_thread_config;
+
+/**
+ * Reads a thread config from a JSON file shaped like:
+ *
+ *   {"render": {"cpu": 2, "realtime_priority": 50},
+ *    "orientation": {"cpu": 3, "realtime_priority": 60},
+ *    "captions": {"realtime_priority": 40, "nice": -10}}
+ *
+ * Threads are named as in thread_name, without the "cog-" prefix. Every field is optional, and so is every thread.
+ * "nice" only applies if the thread can't be made real-time (or isn't asked to be).
+ */
+ThreadConfig load_thread_config(const std::string &path);
+
+/**
+ * e.g. "cog-render". Under the 15 characters Linux allows thread names.
+ */
+const char *thread_name(TrialThread thread);
+
+/**
+ * Names the calling thread and applies its settings from trial_thread_config. Settings that aren't permitted (real-time
+ * scheduling and negative nice values normally need CAP_SYS_NICE, or an rtprio limit) are reported and skipped, and
+ * the thread carries on without them; so are CPU pinning and per-thread nice values anywhere but Linux. Only does
+ * anything the first time it's called on a thread, so it can be called from callbacks on threads that aren't ours
+ * (like VLC's).
+ */
+void configure_current_thread(TrialThread thread);
+
+/**
+ * Starts a thread that configures itself as `thread` before calling function(args...).
+ */
+template<typename Function, typename... Args>
+std::thread start_trial_thread(TrialThread thread, Function function, Args... args) {
+    return std::thread([thread, function, args...] {
+        configure_current_thread(thread);
+        std::invoke(function, args...);
+    });
+}
+
+/**
+ * Blocks until started is set (playback has begun), checking every PLAYBACK_POLL. Threads that wait for playback must
+ * sleep rather than spin: they may be running SCHED_FIFO, and calibration can take minutes, which a spin would spend
+ * holding its CPU against everything else pinned there.
+ * @param stopping If given, stop waiting once it's set
+ * @return false if the trial stopped before playback started.
+ */
+bool wait_for_playback(const std::atomic<bool> *started, const std::atomic<bool> *stopping = nullptr);
+
+/**
+ * Sleeps until deadline, waking every STOP_POLL to give up early if the trial is stopping.
+ * @return false if it is.
+ */
+bool sleep_until_or_stopping(std::chrono::steady_clock::time_point deadline, const std::atomic<bool> *stopping);
+
+/**
+ * Call when a thread wakes up from sleeping until `intended`.
+ */
+void record_wakeup(TrialThread thread, std::chrono::steady_clock::time_point intended);
+
+/**
+ * Call when a thread wakes up from a blocking receive on socket: the intended wake-up is when the kernel received the
+ * datagram (SIOCGSTAMPNS, so there's nothing to set up on the socket first). Only measured on Linux.
+ */
+void record_packet_wakeup(TrialThread thread, int socket);
+
+/**
+ * Call when a thread paced by something else (like VLC's clock) starts its next period at now_us, having started the
+ * previous one at previous_us: it was meant to wake up one period after the previous one. Gaps much longer than a
+ * period are frames being dropped, which is counted elsewhere, so they're left out.
+ */
+void record_paced_wakeup(TrialThread thread, int64_t previous_us, int64_t now_us, int64_t period_us);
+
+/**
+ * Prints the wake-up jitter of every thread that recorded any, and what each thread's settings came to.
+ */
+void print_thread_report();
+
+#endif //COG_GROUP_CONVO_CPP_THREAD_CONFIG_HPP
@@ -0,0 +1,56 @@
+#ifndef COG_GROUP_CONVO_CPP_VIEWPORTS_HPP
+#define COG_GROUP_CONVO_CPP_VIEWPORTS_HPP
+
+#include <memory>
+#include <vector>
+#include <SDL.h>
+#include "AppContext.hpp"
+#include "caption_overlay.hpp"
+#include "caption_server.hpp"
+
+/**
+ * One participant's view of the trial: the shared video frame, with captions drawn for their own head orientation,
+ * field of view and presentation method.
+ */
+struct Viewport {
+    AppContext context; // A copy of the main context, pointing at this participant's orientation and overlay
+    CaptionOverlay overlay;
+    CaptionClient *client;
+    SDL_Rect screen_rect; // Where this view goes in the window
+};
+
+/**
+ * A view per registered client, tiled over the window. Every view shares the one decoded frame, the caption layout and
+ * the caption texture cache; only the overlays (which are redrawn when that participant's captions actually change)
+ * and the copies onto the screen are per view. Only the render thread may use it.
+ */
+struct ViewportSet {
+    CaptionServer *server;
+    std::vector<std::unique_ptr<Viewport>> viewports;
+};
+
+/**
+ * Adds a view for every client that's registered since the last call, copies the context into every view if its
+ * config changed (or the view is new), and picks up each client's current presentation method and field of view.
+ * Call at the start of every frame, after apply_render_config.
+ */
+void sync_viewports(ViewportSet *viewport_set, const AppContext *context, bool config_changed);
+
+/**
+ * Whether the context should be drawn as several views rather than one full-window one.
+ */
+bool has_multiple_viewports(const AppContext *context);
+
+/**
+ * Copies the decoded frame into every view.
+ */
+void display_viewports(const ViewportSet *viewport_set, SDL_Renderer *renderer, SDL_Texture *frame);
+
+/**
+ * Draws each view's captions over its copy of the frame.
+ */
+void composite_viewports(const ViewportSet *viewport_set);
+
+void destroy_viewports(ViewportSet *viewport_set);
+
+#endif //COG_GROUP_CONVO_CPP_VIEWPORTS_HPP
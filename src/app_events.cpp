@@ -0,0 +1,51 @@
+#include <atomic>
+#include <iostream>
+#include "app_events.hpp"
+
+// (Uint32) -1 is what SDL_RegisterEvents returns when it's out of user events, so it doubles as "not registered".
+static std::atomic<Uint32> app_event_type{(Uint32) -1};
+
+void register_app_events() {
+    const auto type = SDL_RegisterEvents(1);
+    if (type == (Uint32) -1) {
+        std::cerr << "Unable to register app events: " << SDL_GetError() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    app_event_type = type;
+}
+
+void post_app_event(AppEvent app_event) {
+    const auto type = app_event_type.load();
+    if (type == (Uint32) -1) {
+        return;
+    }
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = type;
+    event.user.code = app_event;
+    if (SDL_PushEvent(&event) < 0) {
+        std::cerr << "Unable to post " << app_event_name(app_event) << ": " << SDL_GetError() << std::endl;
+    }
+}
+
+int app_event_code(const SDL_Event *event) {
+    const auto type = app_event_type.load();
+    if (type == (Uint32) -1 || event->type != type) {
+        return -1;
+    }
+    return event->user.code;
+}
+
+const char *app_event_name(AppEvent app_event) {
+    switch (app_event) {
+        case PLAYBACK_ENDED:
+            return "PLAYBACK_ENDED";
+        case CAPTIONS_FINISHED:
+            return "CAPTIONS_FINISHED";
+        case ORIENTATION_LOST:
+            return "ORIENTATION_LOST";
+        case QUALITY_CHANGED:
+            return "QUALITY_CHANGED";
+    }
+    return "UNKNOWN";
+}
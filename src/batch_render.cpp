@@ -0,0 +1,140 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+#include "batch_render.hpp"
+#include "offline_export.hpp"
+#include "orientation_recording.hpp"
+#include "presentation_methods.hpp"
+
+std::vector<RenderJob> load_render_jobs(const std::string &path, int *invalid_jobs) {
+    std::ifstream jobs_file(path.c_str());
+    if (!jobs_file) {
+        std::cerr << "Unable to open batch file " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    nlohmann::json json;
+    jobs_file >> json;
+    std::vector<RenderJob> jobs;
+    for (const auto &entry: json) {
+        RenderJob job{};
+        job.video_section = entry["video_section"].get<int>();
+        job.presentation_method = entry["presentation_method"].get<int>();
+        const int field_of_view = entry["field_of_view"].get<int>();
+        job.half_fov = field_of_view / 2;
+        job.orientation_path = entry.value("orientation", "");
+        job.output_path = entry["output"].get<std::string>();
+        if (job.video_section <= 0 || job.video_section > 4) {
+            std::cerr << "Skipping " << job.output_path << ": video section must be between 1-4." << std::endl;
+            ++(*invalid_jobs);
+            continue;
+        }
+        if (job.presentation_method < REGISTERED_GRAPHICS || job.presentation_method > CONTROL) {
+            std::cerr << "Skipping " << job.output_path << ": presentation method must be between "
+                      << REGISTERED_GRAPHICS << "-" << CONTROL << "." << std::endl;
+            ++(*invalid_jobs);
+            continue;
+        }
+        if (field_of_view < MIN_FIELD_OF_VIEW || field_of_view > MAX_FIELD_OF_VIEW) {
+            std::cerr << "Skipping " << job.output_path << ": field of view must be between " << MIN_FIELD_OF_VIEW
+                      << "-" << MAX_FIELD_OF_VIEW << " degrees." << std::endl;
+            ++(*invalid_jobs);
+            continue;
+        }
+        jobs.push_back(job);
+    }
+    std::cout << "Loaded " << jobs.size() << " render jobs from " << path << std::endl;
+    return jobs;
+}
+
+AppContext create_worker_context(const AppContext *prototype) {
+    AppContext context = *prototype;
+    // Creating a texture from a surface can update the surface's blit map, so every worker gets its own copy.
+    context.back_arrow = SDL_ConvertSurfaceFormat(prototype->back_arrow, SDL_PIXELFORMAT_ARGB8888, 0);
+    context.forward_arrow = SDL_ConvertSurfaceFormat(prototype->forward_arrow, SDL_PIXELFORMAT_ARGB8888, 0);
+    context.renderer = nullptr;
+    context.texture = nullptr;
+    context.mutex = nullptr;
+    context.caption_model = nullptr;
+    context.azimuth_mutex = nullptr;
+    context.azimuth_buffer = nullptr;
+    return context;
+}
+
+void destroy_worker_context(AppContext *context) {
+    SDL_FreeSurface(context->back_arrow);
+    context->back_arrow = nullptr;
+    SDL_FreeSurface(context->forward_arrow);
+    context->forward_arrow = nullptr;
+}
+
+int run_batch_render(const AppContext *prototype, const std::vector<RenderJob> &jobs, size_t workers, int fps) {
+    if (prototype->speakers->glyph_atlases.empty()) {
+        std::cerr << "Batch rendering needs glyph atlases, load the speakers' fonts first." << std::endl;
+        return (int) jobs.size();
+    }
+    // Load every caption track and orientation recording once, up front. Jobs only ever read them.
+    std::map<int, std::vector<CaptionCue>> caption_tracks;
+    std::map<std::string, std::vector<OrientationRecord>> recordings;
+    for (const auto &job: jobs) {
+        if (caption_tracks.find(job.video_section) == caption_tracks.end()) {
+            caption_tracks[job.video_section] = load_caption_track(load_captions(job.video_section),
+                                                                    prototype->speakers);
+        }
+        if (!job.orientation_path.empty() && recordings.find(job.orientation_path) == recordings.end()) {
+            recordings[job.orientation_path] = load_orientation_recording(job.orientation_path);
+        }
+    }
+    const std::vector<OrientationRecord> synthetic_orientation;
+
+    workers = std::max<size_t>(1, std::min(workers, jobs.size()));
+    std::vector<AppContext> worker_contexts;
+    for (size_t i = 0; i < workers; ++i) {
+        worker_contexts.push_back(create_worker_context(prototype));
+    }
+
+    std::cout << "Rendering " << jobs.size() << " jobs on " << workers << " workers." << std::endl;
+    std::atomic<size_t> next_job{0};
+    std::atomic<size_t> total_frames{0};
+    std::atomic<int> failed_jobs{0};
+    std::mutex output_mutex;
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t worker = 0; worker < workers; ++worker) {
+        threads.emplace_back([&, worker] {
+            for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+                const auto &job = jobs[i];
+                AppContext context = worker_contexts[worker];
+                context.video_section = job.video_section;
+                set_presentation_method(&context, job.presentation_method);
+                context.half_fov = job.half_fov;
+                const auto *orientation = job.orientation_path.empty() ? &synthetic_orientation
+                                                                       : &recordings.at(job.orientation_path);
+                const auto stats = export_captioned_video(&context, &caption_tracks.at(job.video_section),
+                                                          orientation, job.output_path, fps);
+                total_frames += stats.frames;
+                if (!stats.succeeded) {
+                    ++failed_jobs;
+                }
+                std::lock_guard<std::mutex> lock(output_mutex);
+                std::cout << "[worker " << worker << "] job " << i + 1 << "/" << jobs.size() << " "
+                          << job.output_path << ": " << stats.frames << " frames, "
+                          << (stats.seconds > 0 ? stats.frames / stats.seconds : 0) << " frames/s"
+                          << (stats.succeeded ? "" : " (failed)") << std::endl;
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (auto &context: worker_contexts) {
+        destroy_worker_context(&context);
+    }
+    std::cout << "Batch finished: " << jobs.size() - failed_jobs << "/" << jobs.size() << " jobs, "
+              << total_frames << " frames in " << elapsed.count() << "s ("
+              << total_frames / elapsed.count() << " frames/s across " << workers << " workers)" << std::endl;
+    return failed_jobs;
+}
@@ -0,0 +1,441 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "caption_blend.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COG_BLEND_X86 1
+#include <immintrin.h>
+#else
+#define COG_BLEND_X86 0
+#endif
+
+/**
+ * x / 255, rounded to nearest, for 0 <= x <= 255 * 255. The SIMD kernels compute exactly the same thing with
+ * mulhi(x + 128, 257), so every kernel produces identical pixels.
+ */
+static inline uint32_t div255(uint32_t x) {
+    return (x + 128 + ((x + 128) >> 8)) >> 8;
+}
+
+static inline uint32_t expand5(uint32_t value) {
+    return value << 3 | value >> 2;
+}
+
+static inline uint32_t expand6(uint32_t value) {
+    return value << 2 | value >> 4;
+}
+
+static void blend_bgr565_scalar(uint16_t *destination, const uint8_t *coverage, int count,
+                                const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    for (int i = 0; i < count; ++i) {
+        const uint32_t cov = coverage[i];
+        const uint32_t inv = 255 - cov;
+        const uint32_t alpha = div255(background_color->a * inv + foreground_color->a * cov);
+        const uint32_t red = div255(background_color->r * inv + foreground_color->r * cov);
+        const uint32_t green = div255(background_color->g * inv + foreground_color->g * cov);
+        const uint32_t blue = div255(background_color->b * inv + foreground_color->b * cov);
+        const uint32_t pixel = destination[i];
+        const uint32_t inverse_alpha = 255 - alpha;
+        const uint32_t out_red = div255(expand5(pixel & 0x1F) * inverse_alpha + red * alpha);
+        const uint32_t out_green = div255(expand6((pixel >> 5) & 0x3F) * inverse_alpha + green * alpha);
+        const uint32_t out_blue = div255(expand5(pixel >> 11) * inverse_alpha + blue * alpha);
+        destination[i] = (uint16_t) ((out_blue >> 3) << 11 | (out_green >> 2) << 5 | out_red >> 3);
+    }
+}
+
+static void blend_argb8888_scalar(uint32_t *destination, const uint8_t *coverage, int count,
+                                  const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    for (int i = 0; i < count; ++i) {
+        const uint32_t cov = coverage[i];
+        const uint32_t inv = 255 - cov;
+        const uint32_t alpha = div255(background_color->a * inv + foreground_color->a * cov);
+        const uint32_t red = div255(background_color->r * inv + foreground_color->r * cov);
+        const uint32_t green = div255(background_color->g * inv + foreground_color->g * cov);
+        const uint32_t blue = div255(background_color->b * inv + foreground_color->b * cov);
+        const uint32_t pixel = destination[i];
+        const uint32_t inverse_alpha = 255 - alpha;
+        // Same as SDL_BLENDMODE_BLEND: the frame's alpha becomes alpha + frame alpha * (1 - alpha).
+        destination[i] = div255((pixel >> 24) * inverse_alpha + 255 * alpha) << 24 |
+                         div255(((pixel >> 16) & 0xFF) * inverse_alpha + red * alpha) << 16 |
+                         div255(((pixel >> 8) & 0xFF) * inverse_alpha + green * alpha) << 8 |
+                         div255((pixel & 0xFF) * inverse_alpha + blue * alpha);
+    }
+}
+
+#if COG_BLEND_X86
+
+// All the SIMD kernels work on 16-bit lanes: every product below is at most 255 * 255, and every sum of two products
+// has weights adding up to 255, so nothing overflows.
+
+__attribute__((target("sse2")))
+static inline __m128i div255_sse2(__m128i x) {
+    return _mm_mulhi_epu16(_mm_add_epi16(x, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i mix_sse2(__m128i from, __m128i to, __m128i weight) {
+    const __m128i inverse = _mm_sub_epi16(_mm_set1_epi16(255), weight);
+    return div255_sse2(_mm_add_epi16(_mm_mullo_epi16(from, inverse), _mm_mullo_epi16(to, weight)));
+}
+
+__attribute__((target("sse2")))
+static void blend_bgr565_sse2(uint16_t *destination, const uint8_t *coverage, int count,
+                              const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i foreground_alpha = _mm_set1_epi16(foreground_color->a);
+    const __m128i foreground_red = _mm_set1_epi16(foreground_color->r);
+    const __m128i foreground_green = _mm_set1_epi16(foreground_color->g);
+    const __m128i foreground_blue = _mm_set1_epi16(foreground_color->b);
+    const __m128i background_alpha = _mm_set1_epi16(background_color->a);
+    const __m128i background_red = _mm_set1_epi16(background_color->r);
+    const __m128i background_green = _mm_set1_epi16(background_color->g);
+    const __m128i background_blue = _mm_set1_epi16(background_color->b);
+    const __m128i five_bits = _mm_set1_epi16(0x1F);
+    const __m128i six_bits = _mm_set1_epi16(0x3F);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i cov = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) (coverage + i)), zero);
+        const __m128i alpha = mix_sse2(background_alpha, foreground_alpha, cov);
+        const __m128i red = mix_sse2(background_red, foreground_red, cov);
+        const __m128i green = mix_sse2(background_green, foreground_green, cov);
+        const __m128i blue = mix_sse2(background_blue, foreground_blue, cov);
+
+        const __m128i pixels = _mm_loadu_si128((const __m128i *) (destination + i));
+        __m128i frame_red = _mm_and_si128(pixels, five_bits);
+        frame_red = _mm_or_si128(_mm_slli_epi16(frame_red, 3), _mm_srli_epi16(frame_red, 2));
+        __m128i frame_green = _mm_and_si128(_mm_srli_epi16(pixels, 5), six_bits);
+        frame_green = _mm_or_si128(_mm_slli_epi16(frame_green, 2), _mm_srli_epi16(frame_green, 4));
+        __m128i frame_blue = _mm_srli_epi16(pixels, 11);
+        frame_blue = _mm_or_si128(_mm_slli_epi16(frame_blue, 3), _mm_srli_epi16(frame_blue, 2));
+
+        const __m128i out_red = mix_sse2(frame_red, red, alpha);
+        const __m128i out_green = mix_sse2(frame_green, green, alpha);
+        const __m128i out_blue = mix_sse2(frame_blue, blue, alpha);
+        const __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(out_blue, 3), 11),
+                                                      _mm_slli_epi16(_mm_srli_epi16(out_green, 2), 5)),
+                                         _mm_srli_epi16(out_red, 3));
+        _mm_storeu_si128((__m128i *) (destination + i), out);
+    }
+    blend_bgr565_scalar(destination + i, coverage + i, count - i, foreground_color, background_color);
+}
+
+/**
+ * Blends two ARGB8888 pixels, unpacked to 16-bit lanes (b, g, r, a, b, g, r, a), with their coverage in every lane.
+ */
+__attribute__((target("sse2")))
+static inline __m128i blend_argb_pair_sse2(__m128i frame, __m128i cov, __m128i foreground, __m128i background) {
+    // The caption's color and alpha, with alpha ending up in lane 3 of each pixel.
+    const __m128i caption = mix_sse2(background, foreground, cov);
+    __m128i alpha = _mm_shufflelo_epi16(caption, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    // Blending towards 255 in the alpha lane gives SDL_BLENDMODE_BLEND's alpha + frame alpha * (1 - alpha).
+    const __m128i color_lanes = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i opaque_alpha = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    const __m128i source = _mm_or_si128(_mm_and_si128(caption, color_lanes), opaque_alpha);
+    return mix_sse2(frame, source, alpha);
+}
+
+__attribute__((target("sse2")))
+static void blend_argb8888_sse2(uint32_t *destination, const uint8_t *coverage, int count,
+                                const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i foreground = _mm_setr_epi16(foreground_color->b, foreground_color->g, foreground_color->r,
+                                              foreground_color->a, foreground_color->b, foreground_color->g,
+                                              foreground_color->r, foreground_color->a);
+    const __m128i background = _mm_setr_epi16(background_color->b, background_color->g, background_color->r,
+                                              background_color->a, background_color->b, background_color->g,
+                                              background_color->r, background_color->a);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32_t four_coverages;
+        memcpy(&four_coverages, coverage + i, sizeof(four_coverages));
+        __m128i cov = _mm_cvtsi32_si128(four_coverages);
+        cov = _mm_unpacklo_epi8(cov, cov);
+        cov = _mm_unpacklo_epi16(cov, cov); // Each pixel's coverage, repeated for all four of its channels
+        const __m128i pixels = _mm_loadu_si128((const __m128i *) (destination + i));
+        const __m128i low = blend_argb_pair_sse2(_mm_unpacklo_epi8(pixels, zero), _mm_unpacklo_epi8(cov, zero),
+                                                 foreground, background);
+        const __m128i high = blend_argb_pair_sse2(_mm_unpackhi_epi8(pixels, zero), _mm_unpackhi_epi8(cov, zero),
+                                                  foreground, background);
+        _mm_storeu_si128((__m128i *) (destination + i), _mm_packus_epi16(low, high));
+    }
+    blend_argb8888_scalar(destination + i, coverage + i, count - i, foreground_color, background_color);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i div255_avx2(__m256i x) {
+    return _mm256_mulhi_epu16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mix_avx2(__m256i from, __m256i to, __m256i weight) {
+    const __m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(255), weight);
+    return div255_avx2(_mm256_add_epi16(_mm256_mullo_epi16(from, inverse), _mm256_mullo_epi16(to, weight)));
+}
+
+__attribute__((target("avx2")))
+static void blend_bgr565_avx2(uint16_t *destination, const uint8_t *coverage, int count,
+                              const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    const __m256i foreground_alpha = _mm256_set1_epi16(foreground_color->a);
+    const __m256i foreground_red = _mm256_set1_epi16(foreground_color->r);
+    const __m256i foreground_green = _mm256_set1_epi16(foreground_color->g);
+    const __m256i foreground_blue = _mm256_set1_epi16(foreground_color->b);
+    const __m256i background_alpha = _mm256_set1_epi16(background_color->a);
+    const __m256i background_red = _mm256_set1_epi16(background_color->r);
+    const __m256i background_green = _mm256_set1_epi16(background_color->g);
+    const __m256i background_blue = _mm256_set1_epi16(background_color->b);
+    const __m256i five_bits = _mm256_set1_epi16(0x1F);
+    const __m256i six_bits = _mm256_set1_epi16(0x3F);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i cov = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (coverage + i)));
+        const __m256i alpha = mix_avx2(background_alpha, foreground_alpha, cov);
+        const __m256i red = mix_avx2(background_red, foreground_red, cov);
+        const __m256i green = mix_avx2(background_green, foreground_green, cov);
+        const __m256i blue = mix_avx2(background_blue, foreground_blue, cov);
+
+        const __m256i pixels = _mm256_loadu_si256((const __m256i *) (destination + i));
+        __m256i frame_red = _mm256_and_si256(pixels, five_bits);
+        frame_red = _mm256_or_si256(_mm256_slli_epi16(frame_red, 3), _mm256_srli_epi16(frame_red, 2));
+        __m256i frame_green = _mm256_and_si256(_mm256_srli_epi16(pixels, 5), six_bits);
+        frame_green = _mm256_or_si256(_mm256_slli_epi16(frame_green, 2), _mm256_srli_epi16(frame_green, 4));
+        __m256i frame_blue = _mm256_srli_epi16(pixels, 11);
+        frame_blue = _mm256_or_si256(_mm256_slli_epi16(frame_blue, 3), _mm256_srli_epi16(frame_blue, 2));
+
+        const __m256i out_red = mix_avx2(frame_red, red, alpha);
+        const __m256i out_green = mix_avx2(frame_green, green, alpha);
+        const __m256i out_blue = mix_avx2(frame_blue, blue, alpha);
+        const __m256i out = _mm256_or_si256(
+                _mm256_or_si256(_mm256_slli_epi16(_mm256_srli_epi16(out_blue, 3), 11),
+                                _mm256_slli_epi16(_mm256_srli_epi16(out_green, 2), 5)),
+                _mm256_srli_epi16(out_red, 3));
+        _mm256_storeu_si256((__m256i *) (destination + i), out);
+    }
+    blend_bgr565_sse2(destination + i, coverage + i, count - i, foreground_color, background_color);
+}
+
+/**
+ * Blends four ARGB8888 pixels, unpacked to 16-bit lanes, two per 128-bit half. See blend_argb_pair_sse2.
+ */
+__attribute__((target("avx2")))
+static inline __m256i blend_argb_quad_avx2(__m256i frame, __m256i cov, __m256i foreground, __m256i background) {
+    const __m256i caption = mix_avx2(background, foreground, cov);
+    __m256i alpha = _mm256_shufflelo_epi16(caption, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m256i color_lanes = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+    const __m256i opaque_alpha = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    const __m256i source = _mm256_or_si256(_mm256_and_si256(caption, color_lanes), opaque_alpha);
+    return mix_avx2(frame, source, alpha);
+}
+
+__attribute__((target("avx2")))
+static void blend_argb8888_avx2(uint32_t *destination, const uint8_t *coverage, int count,
+                                const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    const __m256i foreground = _mm256_setr_epi16(
+            foreground_color->b, foreground_color->g, foreground_color->r, foreground_color->a,
+            foreground_color->b, foreground_color->g, foreground_color->r, foreground_color->a,
+            foreground_color->b, foreground_color->g, foreground_color->r, foreground_color->a,
+            foreground_color->b, foreground_color->g, foreground_color->r, foreground_color->a);
+    const __m256i background = _mm256_setr_epi16(
+            background_color->b, background_color->g, background_color->r, background_color->a,
+            background_color->b, background_color->g, background_color->r, background_color->a,
+            background_color->b, background_color->g, background_color->r, background_color->a,
+            background_color->b, background_color->g, background_color->r, background_color->a);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i cov = _mm_loadl_epi64((const __m128i *) (coverage + i));
+        cov = _mm_unpacklo_epi8(cov, cov);
+        const __m128i first_four = _mm_unpacklo_epi16(cov, cov);
+        const __m128i last_four = _mm_unpackhi_epi16(cov, cov);
+        const __m256i pixels = _mm256_loadu_si256((const __m256i *) (destination + i));
+        const __m256i low = blend_argb_quad_avx2(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(pixels)),
+                                                 _mm256_cvtepu8_epi16(first_four), foreground, background);
+        const __m256i high = blend_argb_quad_avx2(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(pixels, 1)),
+                                                  _mm256_cvtepu8_epi16(last_four), foreground, background);
+        // packus works within each 128-bit half, which leaves the pixels as 0-1, 4-5, 2-3, 6-7.
+        const __m256i packed = _mm256_packus_epi16(low, high);
+        _mm256_storeu_si256((__m256i *) (destination + i), _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    blend_argb8888_sse2(destination + i, coverage + i, count - i, foreground_color, background_color);
+}
+
+#endif
+
+BlendKernel select_blend_kernel() {
+#if COG_BLEND_X86
+    if (SDL_HasAVX2()) {
+        return BLEND_AVX2;
+    }
+    if (SDL_HasSSE2()) {
+        return BLEND_SSE2;
+    }
+#endif
+    return BLEND_SCALAR;
+}
+
+const char *blend_kernel_name(BlendKernel kernel) {
+    switch (kernel) {
+        case BLEND_SCALAR:
+            return "scalar";
+        case BLEND_SSE2:
+            return "SSE2";
+        case BLEND_AVX2:
+            return "AVX2";
+    }
+    return "unknown";
+}
+
+BGR565RowBlend bgr565_row_blend(BlendKernel kernel) {
+    switch (kernel) {
+        case BLEND_SCALAR:
+            return blend_bgr565_scalar;
+#if COG_BLEND_X86
+        case BLEND_SSE2:
+            return blend_bgr565_sse2;
+        case BLEND_AVX2:
+            return blend_bgr565_avx2;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+ARGB8888RowBlend argb8888_row_blend(BlendKernel kernel) {
+    switch (kernel) {
+        case BLEND_SCALAR:
+            return blend_argb8888_scalar;
+#if COG_BLEND_X86
+        case BLEND_SSE2:
+            return blend_argb8888_sse2;
+        case BLEND_AVX2:
+            return blend_argb8888_avx2;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static std::tuple<int, int> blend_text_with(BlendKernel kernel, SDL_Surface *surface, const GlyphAtlas *atlas,
+                                            std::string_view text, int x, int y, const SDL_Rect *clip_rect,
+                                            const SDL_Color *foreground_color, const SDL_Color *background_color,
+                                            std::pmr::memory_resource *scratch = std::pmr::get_default_resource()) {
+    const auto format = surface->format->format;
+    if (format != SDL_PIXELFORMAT_BGR565 && format != SDL_PIXELFORMAT_ARGB8888) {
+        std::cerr << "Can't blend captions into pixel format " << SDL_GetPixelFormatName(format) << std::endl;
+        return std::make_tuple(0, 0);
+    }
+    const auto[width, height] = measure_text(atlas, text);
+    const SDL_Rect caption_rect{x, y, width, height};
+    SDL_Rect visible_rect{0, 0, surface->w, surface->h};
+    if ((clip_rect != nullptr && !SDL_IntersectRect(&visible_rect, clip_rect, &visible_rect)) ||
+        !SDL_IntersectRect(&visible_rect, &caption_rect, &visible_rect)) {
+        return std::make_tuple(width, height);
+    }
+
+    // Only the visible part of the caption is laid out, so a caption that's mostly out of view costs next to nothing.
+    const SDL_Rect visible_region{visible_rect.x - x, visible_rect.y - y, visible_rect.w, visible_rect.h};
+    std::pmr::vector<uint8_t> coverage((size_t) visible_region.w * visible_region.h, 0, scratch);
+    accumulate_text_coverage_in(atlas, text, &visible_region, coverage.data());
+    const auto bgr565_blend = bgr565_row_blend(kernel);
+    const auto argb8888_blend = argb8888_row_blend(kernel);
+    SDL_LockSurface(surface);
+    for (int row = visible_rect.y; row < visible_rect.y + visible_rect.h; ++row) {
+        auto *pixels = (uint8_t *) surface->pixels + (size_t) row * surface->pitch;
+        const uint8_t *row_coverage = &coverage[(size_t) (row - visible_rect.y) * visible_rect.w];
+        if (format == SDL_PIXELFORMAT_BGR565) {
+            bgr565_blend((uint16_t *) pixels + visible_rect.x, row_coverage, visible_rect.w, foreground_color,
+                         background_color);
+        } else {
+            argb8888_blend((uint32_t *) pixels + visible_rect.x, row_coverage, visible_rect.w, foreground_color,
+                           background_color);
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return std::make_tuple(width, height);
+}
+
+std::tuple<int, int> blend_text(SDL_Surface *surface, const GlyphAtlas *atlas, std::string_view text, int x, int y,
+                                const SDL_Rect *clip_rect, const SDL_Color *foreground_color,
+                                const SDL_Color *background_color, std::pmr::memory_resource *scratch) {
+    static const BlendKernel kernel = select_blend_kernel();
+    return blend_text_with(kernel, surface, atlas, text, x, y, clip_rect, foreground_color, background_color, scratch);
+}
+
+static void fill_test_pattern(SDL_Surface *frame) {
+    SDL_LockSurface(frame);
+    for (int row = 0; row < frame->h; ++row) {
+        auto *pixels = (uint16_t *) ((uint8_t *) frame->pixels + (size_t) row * frame->pitch);
+        for (int column = 0; column < frame->w; ++column) {
+            pixels[column] = (uint16_t) (column * 7 + row * 13);
+        }
+    }
+    SDL_UnlockSurface(frame);
+}
+
+template<typename Composite>
+static double microseconds_per_caption(int iterations, Composite composite) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        composite();
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+void run_blend_benchmark(const GlyphAtlas *atlas, const SDL_Color *foreground_color,
+                         const SDL_Color *background_color, int iterations) {
+    // A typical caption: two full lines, placed roughly where a registered caption would be on a 4K frame.
+    const std::string text = "that kid is guilty, he had\nevery reason to do it, and";
+    const int x = 1250;
+    const int y = 1200;
+    SDL_Surface *frame = SDL_CreateRGBSurfaceWithFormat(0, 3840, 2160, 16, SDL_PIXELFORMAT_BGR565);
+    if (frame == nullptr) {
+        std::cerr << "Unable to create benchmark frame: " << SDL_GetError() << std::endl;
+        return;
+    }
+    const auto[width, height] = measure_text(atlas, text);
+    std::cout << "Blending a " << width << "x" << height << " caption into a " << frame->w << "x" << frame->h
+              << " BGR565 frame, " << iterations << " times. Best kernel on this CPU: "
+              << blend_kernel_name(select_blend_kernel()) << std::endl;
+
+    // The reference output: one blend onto a fresh frame with the scalar kernel.
+    fill_test_pattern(frame);
+    blend_text_with(BLEND_SCALAR, frame, atlas, text, x, y, nullptr, foreground_color, background_color);
+    const auto *frame_pixels = (const uint8_t *) frame->pixels;
+    const std::vector<uint8_t> reference(frame_pixels, frame_pixels + (size_t) frame->pitch * frame->h);
+
+    const auto supported = select_blend_kernel();
+    for (int kernel = BLEND_SCALAR; kernel <= supported; ++kernel) {
+        if (bgr565_row_blend((BlendKernel) kernel) == nullptr) {
+            continue;
+        }
+        fill_test_pattern(frame);
+        blend_text_with((BlendKernel) kernel, frame, atlas, text, x, y, nullptr, foreground_color, background_color);
+        const bool matches = memcmp(reference.data(), frame->pixels, reference.size()) == 0;
+        const auto time = microseconds_per_caption(iterations, [&] {
+            blend_text_with((BlendKernel) kernel, frame, atlas, text, x, y, nullptr, foreground_color,
+                            background_color);
+        });
+        std::cout << "  blend_text (" << blend_kernel_name((BlendKernel) kernel) << "): " << time << " us/caption"
+                  << (matches ? "" : " [OUTPUT DIFFERS FROM SCALAR]") << std::endl;
+    }
+
+    SDL_Rect destination_rect{x, y, width, height};
+    const auto rasterize_and_blit = microseconds_per_caption(iterations, [&] {
+        SDL_Surface *caption = rasterize_text(atlas, text, foreground_color, background_color);
+        SDL_Rect rect = destination_rect;
+        SDL_BlitSurface(caption, nullptr, frame, &rect);
+        SDL_FreeSurface(caption);
+    });
+    std::cout << "  rasterize_text + SDL_BlitSurface: " << rasterize_and_blit << " us/caption" << std::endl;
+    SDL_Surface *caption = rasterize_text(atlas, text, foreground_color, background_color);
+    const auto blit_only = microseconds_per_caption(iterations, [&] {
+        SDL_Rect rect = destination_rect;
+        SDL_BlitSurface(caption, nullptr, frame, &rect);
+    });
+    std::cout << "  SDL_BlitSurface only (caption already rasterized): " << blit_only << " us/caption" << std::endl;
+    SDL_FreeSurface(caption);
+    SDL_FreeSurface(frame);
+}
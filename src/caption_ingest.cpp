@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "caption_ingest.hpp"
+#include "caption_server.hpp"
+#include "metrics.hpp"
+#include "thread_config.hpp"
+
+static sockaddr_in loopback_address(int port) {
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    return address;
+}
+
+int open_caption_ingest_socket(int port) {
+    const int ingest_socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (ingest_socket < 0) {
+        std::cerr << "Couldn't create caption ingest socket: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    const auto address = loopback_address(port);
+    if (bind(ingest_socket, (const sockaddr *) &address, sizeof(address)) < 0) {
+        std::cerr << "Couldn't bind caption ingest to port " << port << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Receiving live captions on 127.0.0.1:" << port << std::endl;
+    return ingest_socket;
+}
+
+void serve_caption_ingest(int socket, CaptionModel *model, CaptionServer *server, const SpeakerRegistry *speakers,
+                          const std::atomic<bool> *stopping) {
+    std::array<uint8_t, MAX_INGEST_MESSAGE_SIZE> buffer{};
+    while (true) {
+        const auto size = recv(socket, buffer.data(), buffer.size(), 0);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Caption ingest failed: " << strerror(errno) << std::endl;
+            return;
+        }
+        // Once close_caption_ingest_socket shuts the socket down, recv returns 0 straight away. Otherwise it's just an
+        // empty datagram.
+        if (size == 0 && *stopping) {
+            return;
+        }
+        const auto arrived_us = metrics_clock_us();
+        record_packet_wakeup(INGEST_THREAD, socket);
+        flatbuffers::Verifier verifier(buffer.data(), size);
+        if (!cog::VerifyCaptionMessageBuffer(verifier)) {
+            count(&trial_metrics.captions_rejected);
+            continue;
+        }
+        const auto *message = cog::GetCaptionMessage(buffer.data());
+        SpeakerId speaker = 0;
+        if (message->text() == nullptr || !speaker_from_wire_id(speakers, message->speaker_id(), &speaker)) {
+            count(&trial_metrics.captions_rejected);
+            continue;
+        }
+        const auto text = message->text()->str();
+        const auto update = model->update_chunk(text, speaker, message->message_id(), message->chunk_id());
+        if (update == CHUNK_STALE) {
+            count(&trial_metrics.captions_stale);
+            continue;
+        }
+        count(&trial_metrics.captions_ingested);
+        if (update == CHUNK_REPLACED) {
+            count(&trial_metrics.captions_replaced);
+        }
+        record_caption_arrived(&trial_metrics, arrived_us);
+        if (server != nullptr) {
+            // The HWDs get the same message and chunk ids, so they can replace partial hypotheses the same way.
+            const auto transmit_start = metrics_clock_us();
+            server->broadcast_caption(text, message->speaker_id(), message->focused_id(), message->message_id(),
+                                      message->chunk_id());
+            count(&trial_metrics.captions_transmitted);
+            observe(&trial_metrics.transmit_ms, (double) (metrics_clock_us() - transmit_start) / 1000);
+        }
+    }
+}
+
+/**
+ * One datagram simulate_asr sends, at_ms after playback starts.
+ */
+struct SimulatedHypothesis {
+    double at_ms;
+    const CaptionCue *cue;
+    bool partial;
+};
+
+void close_caption_ingest_socket(int socket, std::thread *ingest_thread) {
+    shutdown(socket, SHUT_RDWR);
+    if (ingest_thread->joinable()) {
+        ingest_thread->join();
+    }
+    close(socket);
+}
+
+void simulate_asr(int port, const std::atomic<bool> *started, const std::atomic<bool> *stopping,
+                  const std::vector<CaptionCue> *cues, const SpeakerRegistry *speakers) {
+    const int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sender < 0) {
+        std::cerr << "Couldn't create simulated recognizer socket: " << strerror(errno) << std::endl;
+        return;
+    }
+    std::vector<SimulatedHypothesis> hypotheses;
+    for (const auto &cue: *cues) {
+        if (cue.text.size() >= PARTIAL_HYPOTHESIS_MIN_LENGTH) {
+            hypotheses.push_back(SimulatedHypothesis{std::max(0.0, cue.time_ms - PARTIAL_HYPOTHESIS_LEAD_MS), &cue,
+                                                     true});
+        }
+        hypotheses.push_back(SimulatedHypothesis{cue.time_ms, &cue, false});
+    }
+    std::stable_sort(hypotheses.begin(), hypotheses.end(),
+                     [](const SimulatedHypothesis &a, const SimulatedHypothesis &b) { return a.at_ms < b.at_ms; });
+
+    const auto address = loopback_address(port);
+    flatbuffers::FlatBufferBuilder builder(1024);
+    if (!wait_for_playback(started, stopping)) {
+        close(sender);
+        return;
+    }
+    const auto playback_start = std::chrono::steady_clock::now();
+    for (const auto &hypothesis: hypotheses) {
+        if (!sleep_until_or_stopping(playback_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(hypothesis.at_ms)), stopping)) {
+            break;
+        }
+        const auto &cue = *hypothesis.cue;
+        const auto text = hypothesis.partial ? cue.text.substr(0, cue.text.size() / 2) : cue.text;
+        builder.Clear();
+        builder.Finish(cog::CreateCaptionMessageDirect(builder, text.c_str(), speakers->wire_ids[cue.speaker],
+                                                       cog::Juror_JuryForeman, cue.message_id, cue.chunk_id));
+        if (sendto(sender, builder.GetBufferPointer(), builder.GetSize(), 0, (const sockaddr *) &address,
+                   sizeof(address)) < 0) {
+            std::cerr << "Simulated recognizer couldn't send: " << strerror(errno) << std::endl;
+        }
+    }
+    close(sender);
+    std::cout << "Simulated recognizer finished." << std::endl;
+}
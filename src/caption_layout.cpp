@@ -0,0 +1,62 @@
+#include <iostream>
+#include "caption_layout.hpp"
+#include "presentation_methods.hpp"
+#include "caption_timeline.hpp"
+
+CaptionLayout build_caption_layout(const std::vector<CaptionCue> &cues, const SpeakerRegistry *speakers,
+                                   const std::vector<GlyphAtlas> *glyph_atlases, int window_width, int window_height) {
+    CaptionLayout layout{};
+    layout.window_width = window_width;
+    layout.window_height = window_height;
+    layout.entries.reserve(cues.size());
+
+    // The same accumulation CaptionModel::add_word and get_current_text do: words pile up until the speaker changes.
+    std::string spoken_so_far;
+    SpeakerId current_speaker = 0;
+    for (size_t i = 0; i < cues.size(); ++i) {
+        const auto &cue = cues[i];
+        if (i > 0 && cue.speaker != current_speaker) {
+            spoken_so_far.clear();
+        }
+        current_speaker = cue.speaker;
+        spoken_so_far += cue.text + " ";
+        const auto text = CaptionModel::wrap(spoken_so_far, CaptionModel::LINE_LENGTH);
+
+        CaptionLayoutEntry entry{};
+        entry.speaker = cue.speaker;
+        entry.text_offset = layout.text.size();
+        entry.text_length = text.size();
+        layout.text += text;
+        const auto[width, height] = measure_text(speaker_atlas(speakers, glyph_atlases, cue.speaker), text);
+        entry.width = width;
+        entry.height = height;
+        entry.anchor = SDL_Rect{(int) (speakers->anchor_x[cue.speaker] * layout.window_width),
+                                (int) (speakers->anchor_y[cue.speaker] * layout.window_height),
+                                width, height};
+        const auto[left, right] = speaker_interval(speakers, cue.speaker, layout.window_width);
+        entry.interval_left = (int) left;
+        entry.interval_right = (int) right;
+        layout.entries.push_back(entry);
+    }
+    std::cout << "Laid out " << layout.entries.size() << " captions (" << layout.text.size() << " bytes of text) for "
+              << layout.window_width << "x" << layout.window_height << std::endl;
+    return layout;
+}
+
+bool lookup_caption_layout(const AppContext *context, const CaptionLayoutEntry **entry) {
+    const auto *layout = context->caption_layout;
+    if (layout == nullptr || layout->window_width != context->display_rect.w ||
+        layout->window_height != context->display_rect.h) {
+        return false;
+    }
+    const auto word_count = revealed_caption_count(context);
+    if (word_count > layout->entries.size()) {
+        return false;
+    }
+    *entry = word_count == 0 ? nullptr : &layout->entries[word_count - 1];
+    return true;
+}
+
+std::string_view layout_text(const CaptionLayout *layout, const CaptionLayoutEntry *entry) {
+    return std::string_view(layout->text).substr(entry->text_offset, entry->text_length);
+}
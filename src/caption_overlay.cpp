@@ -0,0 +1,131 @@
+#include <iostream>
+#include "caption_overlay.hpp"
+#include "orientation.hpp"
+#include "presentation_methods.hpp"
+#include "caption_texture_cache.hpp"
+#include "caption_timeline.hpp"
+#include "quality_governor.hpp"
+
+void create_caption_overlay(CaptionOverlay *overlay, SDL_Renderer *renderer, int width, int height) {
+    overlay->texture = nullptr;
+    overlay->width = width;
+    overlay->height = height;
+    overlay->valid = false;
+    overlay->dirty_rects.clear();
+    overlay->bounds = SDL_Rect{0, 0, 0, 0};
+    if (!SDL_RenderTargetSupported(renderer)) {
+        std::cerr << "Renderer can't render to textures, captions will be drawn straight onto every frame."
+                  << std::endl;
+        return;
+    }
+    overlay->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, width, height);
+    if (overlay->texture == nullptr) {
+        std::cerr << "Couldn't create caption overlay: " << SDL_GetError() << std::endl;
+        return;
+    }
+    SDL_SetTextureBlendMode(overlay->texture, SDL_BLENDMODE_BLEND);
+    // Start fully transparent; from here on, only what was drawn gets cleared.
+    SDL_SetRenderTarget(renderer, overlay->texture);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+    SDL_RenderClear(renderer);
+    SDL_SetRenderTarget(renderer, nullptr);
+}
+
+void destroy_caption_overlay(CaptionOverlay *overlay) {
+    if (overlay->texture != nullptr) {
+        SDL_DestroyTexture(overlay->texture);
+    }
+    overlay->texture = nullptr;
+    overlay->valid = false;
+}
+
+void mark_overlay_dirty(const AppContext *context, const SDL_Rect *rect) {
+    if (context->caption_overlay == nullptr) {
+        return;
+    }
+    // Presentation methods happily draw partly off screen; only what's on the overlay needs clearing and copying.
+    const SDL_Rect overlay_rect{0, 0, context->caption_overlay->width, context->caption_overlay->height};
+    SDL_Rect visible_rect;
+    if (SDL_IntersectRect(rect, &overlay_rect, &visible_rect)) {
+        context->caption_overlay->dirty_rects.push_back(visible_rect);
+    }
+}
+
+/**
+ * Clears whatever was drawn last time, and draws the current captions onto the overlay.
+ */
+static void redraw_caption_overlay(const AppContext *context, CaptionOverlay *overlay) {
+    SDL_SetRenderTarget(context->renderer, overlay->texture);
+    SDL_SetRenderDrawBlendMode(context->renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(context->renderer, 0, 0, 0, 0);
+    for (const auto &rect: overlay->dirty_rects) {
+        SDL_RenderFillRect(context->renderer, &rect);
+    }
+    overlay->dirty_rects.clear();
+    render_captions(context);
+    SDL_SetRenderTarget(context->renderer, nullptr);
+
+    overlay->bounds = SDL_Rect{0, 0, 0, 0};
+    for (const auto &rect: overlay->dirty_rects) {
+        if (overlay->bounds.w == 0 || overlay->bounds.h == 0) {
+            overlay->bounds = rect;
+        } else {
+            SDL_UnionRect(&overlay->bounds, &rect, &overlay->bounds);
+        }
+    }
+}
+
+bool refresh_caption_overlay(const AppContext *context) {
+    auto *overlay = context->caption_overlay;
+    if (overlay == nullptr) {
+        return false;
+    }
+    if (overlay->width != context->window_width || overlay->height != context->window_height) {
+        destroy_caption_overlay(overlay);
+        create_caption_overlay(overlay, context->renderer, context->window_width, context->window_height);
+    }
+    if (overlay->texture == nullptr) {
+        return false;
+    }
+
+    // Everything the presentation methods draw is placed at whole pixels, so the azimuth only matters to the overlay
+    // once it moves to a different pixel.
+    const auto current_revision = caption_revision(context);
+    const auto azimuth_bucket = angle_to_pixel_position(
+            filtered_azimuth(context->azimuth_buffer, context->azimuth_mutex,
+                             orientation_filter_taps(context->quality_governor)));
+    if (!overlay->valid || current_revision != overlay->caption_revision ||
+        azimuth_bucket != overlay->azimuth_bucket) {
+        if (context->caption_textures != nullptr) {
+            context->caption_textures->served_stale = false;
+        }
+        redraw_caption_overlay(context, overlay);
+        // A caption that was drawn from an older revision still needs redrawing once it's caught up.
+        if (context->caption_textures == nullptr || !context->caption_textures->served_stale) {
+            overlay->caption_revision = current_revision;
+        }
+        overlay->azimuth_bucket = azimuth_bucket;
+        overlay->valid = true;
+    }
+    return true;
+}
+
+void composite_caption_overlay(const AppContext *context) {
+    if (context->presentation_method == CONTROL) {
+        // Captions go to the HWD instead, so there's never anything to draw over the video.
+        return;
+    }
+    auto *overlay = context->caption_overlay;
+    if (!refresh_caption_overlay(context)) {
+        // Nowhere to keep the captions between frames, so they're drawn from scratch every time.
+        render_captions(context);
+        if (overlay != nullptr) {
+            overlay->dirty_rects.clear();
+        }
+        return;
+    }
+    if (overlay->bounds.w > 0 && overlay->bounds.h > 0) {
+        SDL_RenderCopy(context->renderer, overlay->texture, &overlay->bounds, &overlay->bounds);
+    }
+}
@@ -0,0 +1,501 @@
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "caption_server.hpp"
+#include "orientation.hpp"
+#include "presentation_methods.hpp"
+#include "app_events.hpp"
+#include "metrics.hpp"
+#include "thread_config.hpp"
+
+static uint64_t client_key(const sockaddr_in &address) {
+    return ((uint64_t) address.sin_addr.s_addr << 16) | address.sin_port;
+}
+
+std::string address_string(const sockaddr_in &address) {
+    return std::string(inet_ntoa(address.sin_addr)) + ":" + std::to_string(ntohs(address.sin_port));
+}
+
+static void write_uint16(std::vector<uint8_t> *frame, uint16_t value) {
+    frame->push_back(value & 0xFF);
+    frame->push_back(value >> 8);
+}
+
+static void write_uint32(std::vector<uint8_t> *frame, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) {
+        frame->push_back((value >> shift) & 0xFF);
+    }
+}
+
+static uint16_t read_uint16(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8);
+}
+
+static uint32_t read_uint32(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+/**
+ * Frames captions from the front of queue for a sequenced client, taking as many as fit in one datagram (and always
+ * at least one, however big).
+ */
+static std::vector<uint8_t> pack_captions(std::deque<PendingCaption> *queue, bool retransmission,
+                                          std::vector<PendingCaption> *packed) {
+    std::vector<uint8_t> frame(CAPTION_DATAGRAM_MAGIC, CAPTION_DATAGRAM_MAGIC + sizeof(CAPTION_DATAGRAM_MAGIC));
+    frame.push_back(CAPTION_TRANSPORT_VERSION);
+    frame.push_back(retransmission ? CAPTION_RETRANSMISSION : 0);
+    write_uint16(&frame, 0); // Count, filled in below
+    uint16_t count = 0;
+    while (!queue->empty() && count < UINT16_MAX) {
+        const auto &caption = queue->front();
+        const size_t entry_size = CAPTION_ENTRY_HEADER_SIZE + caption.message->size();
+        if (count > 0 && frame.size() + entry_size > MAX_CAPTION_DATAGRAM_SIZE) {
+            break;
+        }
+        write_uint32(&frame, caption.sequence);
+        write_uint16(&frame, caption.message->size());
+        frame.insert(frame.end(), caption.message->begin(), caption.message->end());
+        packed->push_back(std::move(queue->front()));
+        queue->pop_front();
+        count++;
+    }
+    frame[6] = count & 0xFF;
+    frame[7] = count >> 8;
+    return frame;
+}
+
+CaptionServer::CaptionServer(int socket, int default_presentation_method, int default_half_fov, int coalesce_ms) :
+        socket(socket), default_presentation_method(default_presentation_method), default_half_fov(default_half_fov),
+        coalesce_window(coalesce_ms), replay_ring(REPLAY_RING_SIZE) {
+    sender = start_trial_thread(SENDER_THREAD, &CaptionServer::send_queued_captions, this);
+}
+
+CaptionServer::~CaptionServer() {
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        stopping = true;
+    }
+    captions_queued.notify_all();
+    sender.join();
+}
+
+CaptionClient *CaptionServer::add_client(const sockaddr_in &address, int presentation_method, int half_fov) {
+    auto client = std::make_unique<CaptionClient>();
+    client->address = address;
+    client->presentation_method = presentation_method;
+    client->half_fov = half_fov;
+    client->primary = clients.empty();
+    std::cout << "Registered client " << address_string(address) << " with presentation method "
+              << presentation_method << " and field of view " << 2 * half_fov
+              << (client->primary ? " (primary)" : "") << std::endl;
+    auto *added = client.get();
+    clients[client_key(address)] = std::move(client);
+    registration_order.push_back(added);
+    return added;
+}
+
+CaptionClient *CaptionServer::handle_packet(const sockaddr_in &address, const uint8_t *packet, size_t size) {
+    const size_t prefix_length = strlen(CLIENT_REGISTRATION_PREFIX);
+    if (size > prefix_length && memcmp(packet, CLIENT_REGISTRATION_PREFIX, prefix_length) == 0) {
+        handle_registration(address, packet + prefix_length, size - prefix_length);
+        return nullptr;
+    }
+    if (size >= sizeof(CAPTION_NACK_MAGIC) && memcmp(packet, CAPTION_NACK_MAGIC, sizeof(CAPTION_NACK_MAGIC)) == 0) {
+        handle_nack(address, packet + sizeof(CAPTION_NACK_MAGIC), size - sizeof(CAPTION_NACK_MAGIC));
+        return nullptr;
+    }
+
+    if (!verify_orientation_sample(packet, size)) {
+        count(&trial_metrics.orientation_rejected);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    auto existing = clients.find(client_key(address));
+    if (existing != clients.end()) {
+        existing->second->orientation_packets++;
+        return existing->second.get();
+    }
+    if (clients.size() >= MAX_CLIENTS) {
+        count(&trial_metrics.orientation_rejected);
+        return nullptr;
+    }
+    auto *client = add_client(address, default_presentation_method, default_half_fov);
+    client->orientation_packets++;
+    return client;
+}
+
+void CaptionServer::handle_registration(const sockaddr_in &address, const uint8_t *packet, size_t size) {
+    std::istringstream registration_fields(std::string(reinterpret_cast<const char *>(packet), size));
+    int presentation_method = default_presentation_method;
+    int field_of_view = 2 * default_half_fov;
+    bool sequenced = false;
+    if (!(registration_fields >> presentation_method)) {
+        std::cerr << "Ignoring malformed registration from " << address_string(address) << std::endl;
+        return;
+    }
+    // The field of view and transport are both optional; without them, the client sees as much as the trial's, and
+    // gets bare caption messages.
+    std::string field;
+    while (registration_fields >> field) {
+        if (field == SEQUENCED_TRANSPORT) {
+            sequenced = true;
+        } else if (!field.empty() && isdigit(field[0])) {
+            errno = 0;
+            char *end = nullptr;
+            const long parsed = strtol(field.c_str(), &end, 10);
+            if (errno != 0 || *end != '\0' || parsed < MIN_FIELD_OF_VIEW || parsed > MAX_FIELD_OF_VIEW) {
+                std::cerr << "Ignoring registration from " << address_string(address) << " with field of view "
+                          << field << " (must be " << MIN_FIELD_OF_VIEW << "-" << MAX_FIELD_OF_VIEW << " degrees)"
+                          << std::endl;
+                return;
+            }
+            field_of_view = (int) parsed;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto existing = clients.find(client_key(address));
+        auto *client = existing != clients.end() ? existing->second.get() : nullptr;
+        if (client != nullptr) {
+            client->presentation_method = presentation_method;
+            client->half_fov = field_of_view / 2;
+        } else if (clients.size() >= MAX_CLIENTS) {
+            std::cerr << "Ignoring registration from " << address_string(address) << ", there are already "
+                      << MAX_CLIENTS << " clients" << std::endl;
+            return;
+        } else {
+            client = add_client(address, presentation_method, field_of_view / 2);
+        }
+        client->sequenced = sequenced;
+    }
+    std::string reply = CLIENT_REGISTRATION_REPLY + std::to_string(presentation_method);
+    if (sequenced) {
+        reply += " " SEQUENCED_TRANSPORT;
+    }
+    if (sendto(socket, reply.data(), reply.size(), 0, (const struct sockaddr *) &address, sizeof(address)) < 0) {
+        std::cerr << "sendto failed: " << strerror(errno) << std::endl;
+    }
+}
+
+void CaptionServer::handle_nack(const sockaddr_in &address, const uint8_t *packet, size_t size) {
+    if (size < 2) {
+        std::cerr << "Ignoring malformed NACK from " << address_string(address) << std::endl;
+        return;
+    }
+    const uint16_t count = read_uint16(packet);
+    if (size < 2 + (size_t) count * CAPTION_ENTRY_HEADER_SIZE) {
+        std::cerr << "Ignoring malformed NACK from " << address_string(address) << std::endl;
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        auto existing = clients.find(client_key(address));
+        if (existing == clients.end() || !existing->second->sequenced) {
+            std::cerr << "Ignoring NACK from " << address_string(address) << ", which isn't a sequenced client"
+                      << std::endl;
+            return;
+        }
+        auto *client = existing->second.get();
+        client->nacks_received++;
+        size_t requested = 0;
+        for (uint16_t i = 0; i < count && requested < MAX_NACKED_SEQUENCES; i++) {
+            const uint8_t *range = packet + 2 + i * CAPTION_ENTRY_HEADER_SIZE;
+            const uint32_t first = read_uint32(range);
+            const uint16_t length = read_uint16(range + 4);
+            for (uint32_t sequence = first; sequence - first < length && requested < MAX_NACKED_SEQUENCES; sequence++) {
+                requested++;
+                const auto &entry = replay_ring[sequence % REPLAY_RING_SIZE];
+                if (entry.message == nullptr || entry.sequence != sequence) {
+                    client->unrecoverable++;
+                    continue;
+                }
+                client->retransmit_queue.push_back(PendingCaption{entry.message, sequence, now});
+            }
+        }
+    }
+    captions_queued.notify_one();
+}
+
+void CaptionServer::broadcast_caption(const std::string &text, cog::Juror speaker_id, cog::Juror focused_id,
+                                      int message_id, int chunk_id) {
+    flatbuffers::FlatBufferBuilder builder(1024);
+    auto caption_message = cog::CreateCaptionMessageDirect(builder, text.c_str(), speaker_id, focused_id, message_id,
+                                                           chunk_id);
+    builder.Finish(caption_message);
+    auto message = std::make_shared<const std::vector<uint8_t>>(builder.GetBufferPointer(),
+                                                                builder.GetBufferPointer() + builder.GetSize());
+    const auto now = std::chrono::steady_clock::now();
+    size_t recipients = 0;
+    {
+        std::lock_guard<std::mutex> lock(clients_mutex);
+        const uint32_t sequence = next_sequence;
+        for (auto &[_, client]: clients) {
+            if (client->presentation_method != CONTROL) {
+                continue;
+            }
+            if (client->send_queue.size() == MAX_QUEUE_DEPTH) {
+                client->send_queue.pop_front();
+                client->captions_dropped++;
+            }
+            client->send_queue.push_back(PendingCaption{message, sequence, now});
+            client->max_queue_depth = std::max(client->max_queue_depth, client->send_queue.size());
+            recipients++;
+        }
+        if (recipients > 0) {
+            replay_ring[sequence % REPLAY_RING_SIZE] = ReplayEntry{sequence, message};
+            next_sequence++;
+        }
+    }
+    if (recipients > 0) {
+        captions_queued.notify_one();
+        std::cout << text << std::endl;
+    }
+}
+
+/**
+ * One datagram's worth of captions for one client.
+ */
+struct OutgoingDatagram {
+    CaptionClient *client;
+    std::vector<PendingCaption> captions;
+    std::vector<uint8_t> frame; // Empty for clients that get bare caption messages
+    bool retransmission;
+};
+
+/**
+ * Runs on the server's own thread. Takes up to MAX_BATCH datagrams' worth of queued captions (across every client) at
+ * a time, and hands them all to the kernel at once. A sequenced client's captions are held until the oldest has waited
+ * coalesce_window (or the server is stopping), so any revealed in the meantime go out in the same datagram;
+ * retransmissions never wait.
+ */
+void CaptionServer::send_queued_captions() {
+#ifdef __linux__
+    std::array<mmsghdr, MAX_BATCH> headers{};
+#endif
+    std::array<iovec, MAX_BATCH> vectors{};
+    std::vector<OutgoingDatagram> batch;
+    batch.reserve(MAX_BATCH);
+
+    std::unique_lock<std::mutex> lock(clients_mutex);
+    while (true) {
+        const auto now = std::chrono::steady_clock::now();
+        auto next_deadline = std::chrono::steady_clock::time_point::max();
+        batch.clear();
+        // Round-robin over the clients, so one with a long queue can't starve the others.
+        bool took_any = true;
+        while (batch.size() < MAX_BATCH && took_any) {
+            took_any = false;
+            for (auto &[_, client]: clients) {
+                if (batch.size() == MAX_BATCH) {
+                    break;
+                }
+                OutgoingDatagram datagram{client.get(), {}, {}, false};
+                if (!client->retransmit_queue.empty()) {
+                    datagram.retransmission = true;
+                    datagram.frame = pack_captions(&client->retransmit_queue, true, &datagram.captions);
+                } else if (client->send_queue.empty()) {
+                    continue;
+                } else if (!client->sequenced) {
+                    datagram.captions.push_back(std::move(client->send_queue.front()));
+                    client->send_queue.pop_front();
+                } else {
+                    const auto deadline = client->send_queue.front().queued_at + coalesce_window;
+                    if (deadline > now && !stopping) {
+                        next_deadline = std::min(next_deadline, deadline);
+                        continue;
+                    }
+                    datagram.frame = pack_captions(&client->send_queue, false, &datagram.captions);
+                }
+                batch.push_back(std::move(datagram));
+                took_any = true;
+            }
+        }
+        if (batch.empty()) {
+            if (stopping) {
+                return;
+            }
+            if (next_deadline == std::chrono::steady_clock::time_point::max()) {
+                captions_queued.wait(lock);
+            } else {
+                captions_queued.wait_until(lock, next_deadline);
+            }
+            continue;
+        }
+        lock.unlock();
+
+        const size_t count = batch.size();
+        for (size_t i = 0; i < count; i++) {
+            auto &datagram = batch[i];
+            if (datagram.frame.empty()) {
+                vectors[i].iov_base = const_cast<uint8_t *>(datagram.captions.front().message->data());
+                vectors[i].iov_len = datagram.captions.front().message->size();
+            } else {
+                vectors[i].iov_base = datagram.frame.data();
+                vectors[i].iov_len = datagram.frame.size();
+            }
+#ifdef __linux__
+            headers[i] = mmsghdr{};
+            headers[i].msg_hdr.msg_name = &datagram.client->address;
+            headers[i].msg_hdr.msg_namelen = sizeof(datagram.client->address);
+            headers[i].msg_hdr.msg_iov = &vectors[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+#endif
+        }
+        std::vector<bool> sent(count, false);
+#ifdef __linux__
+        size_t next = 0;
+        while (next < count) {
+            const int result = sendmmsg(socket, &headers[next], count - next, 0);
+            if (result < 0) {
+                // Skip the datagram that failed, and carry on with the rest.
+                std::cerr << "sendmmsg failed: " << strerror(errno) << std::endl;
+                next++;
+                continue;
+            }
+            for (int i = 0; i < result; i++) {
+                sent[next + i] = true;
+            }
+            next += result;
+        }
+#else
+        // Without sendmmsg, each datagram is its own system call.
+        for (size_t i = 0; i < count; i++) {
+            const auto &address = batch[i].client->address;
+            if (sendto(socket, vectors[i].iov_base, vectors[i].iov_len, 0, (const struct sockaddr *) &address,
+                       sizeof(address)) < 0) {
+                std::cerr << "sendto failed: " << strerror(errno) << std::endl;
+                continue;
+            }
+            sent[i] = true;
+        }
+#endif
+        const auto sent_at = std::chrono::steady_clock::now();
+
+        lock.lock();
+        for (size_t i = 0; i < count; i++) {
+            const auto &datagram = batch[i];
+            auto *client = datagram.client;
+            if (!sent[i]) {
+                client->send_failures += datagram.captions.size();
+                continue;
+            }
+            client->datagrams_sent++;
+            if (datagram.retransmission) {
+                // Counted apart, so a lossy link doesn't skew the latency of first sends.
+                client->retransmissions += datagram.captions.size();
+                continue;
+            }
+            for (const auto &caption: datagram.captions) {
+                const std::chrono::duration<double, std::micro> latency = sent_at - caption.queued_at;
+                client->captions_sent++;
+                client->total_latency_us += latency.count();
+                client->max_latency_us = std::max(client->max_latency_us, latency.count());
+            }
+        }
+        // Let go of the messages now, rather than holding them until the next batch.
+        batch.clear();
+    }
+}
+
+size_t CaptionServer::client_count() {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    return clients.size();
+}
+
+std::vector<CaptionClient *> CaptionServer::client_list() {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    return registration_order;
+}
+
+std::vector<CaptionClientStats> CaptionServer::client_stats() {
+    std::lock_guard<std::mutex> lock(clients_mutex);
+    std::vector<CaptionClientStats> stats;
+    for (const auto *client: registration_order) {
+        stats.push_back(CaptionClientStats{
+                client->address,
+                client->presentation_method,
+                client->half_fov,
+                client->primary,
+                client->sequenced,
+                client->orientation_packets,
+                client->captions_sent,
+                client->datagrams_sent,
+                client->nacks_received,
+                client->retransmissions,
+                client->unrecoverable,
+                client->send_failures,
+                client->captions_dropped,
+                client->send_queue.size(),
+                client->max_queue_depth,
+                client->captions_sent > 0 ? client->total_latency_us / client->captions_sent : 0.0,
+                client->max_latency_us
+        });
+    }
+    return stats;
+}
+
+void CaptionServer::print_client_stats() {
+    const auto stats = client_stats();
+    std::cout << stats.size() << " client(s) connected." << std::endl;
+    for (const auto &client: stats) {
+        printf("  %-21s method %d, FOV %d%s%s: %llu orientation packets, %llu captions sent in %llu datagrams "
+               "(%llu failed, %llu dropped), queue %zu (max %zu), latency mean %.1f us max %.1f us\n",
+               address_string(client.address).c_str(), client.presentation_method, 2 * client.half_fov,
+               client.primary ? " (primary)" : "", client.sequenced ? " (sequenced)" : "",
+               (unsigned long long) client.orientation_packets, (unsigned long long) client.captions_sent,
+               (unsigned long long) client.datagrams_sent, (unsigned long long) client.send_failures,
+               (unsigned long long) client.captions_dropped, client.queue_depth, client.max_queue_depth,
+               client.mean_latency_us, client.max_latency_us);
+        if (client.sequenced) {
+            printf("  %-21s %llu NACKs, %llu captions resent, %llu no longer in the replay ring\n", "",
+                   (unsigned long long) client.nacks_received, (unsigned long long) client.retransmissions,
+                   (unsigned long long) client.unrecoverable);
+        }
+    }
+}
+
+void serve_clients(int socket, CaptionServer *server, std::mutex *azimuth_mutex, std::deque<float> *orientation_buffer,
+                   const std::atomic<bool> *stopping, OrientationRecorder *recorder) {
+    std::array<uint8_t, 256> buffer{};
+    sockaddr_in sender_address{};
+    socklen_t len = sizeof(sender_address);
+
+    ssize_t num_bytes_read = recvfrom(socket, buffer.data(), buffer.size(), 0, (struct sockaddr *) &sender_address,
+                                      &len);
+    while (num_bytes_read != -1) {
+        // Once the trial shuts the socket down at exit, recvfrom returns 0 straight away.
+        if (num_bytes_read == 0 && *stopping) {
+            return;
+        }
+        record_packet_wakeup(ORIENTATION_THREAD, socket);
+        auto *client = server->handle_packet(sender_address, buffer.data(), num_bytes_read);
+        if (client != nullptr) {
+            const auto current_azimuth = push_orientation_sample(buffer.data(), &client->azimuth_mutex,
+                                                                 &client->azimuth_buffer);
+            if (client->primary) {
+                if (recorder != nullptr) {
+                    recorder->record_sample(buffer.data(), num_bytes_read);
+                }
+                push_azimuth(current_azimuth, azimuth_mutex, orientation_buffer);
+                record_orientation_sample(&trial_metrics);
+                std::cout << "Current Orientation: " << current_azimuth << "\n";
+            }
+        }
+        len = sizeof(sender_address);
+        num_bytes_read = recvfrom(socket, buffer.data(), buffer.size(), 0, (struct sockaddr *) &sender_address, &len);
+        if (num_bytes_read < 0) {
+            std::cerr << "recvfrom failed: " << strerror(errno) << std::endl;
+        }
+    }
+    post_app_event(ORIENTATION_LOST);
+}
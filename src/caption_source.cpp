@@ -0,0 +1,181 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "caption_source.hpp"
+#include "app_events.hpp"
+#include "metrics.hpp"
+#include "thread_config.hpp"
+
+/**
+ * Turns the parser's events into cues, handing each one to the source as soon as its object closes. Only the cue
+ * being parsed is ever held here.
+ */
+class CaptionCueParser : public nlohmann::json_sax<nlohmann::json> {
+private:
+    CaptionSource *source;
+    const SpeakerRegistry *speakers;
+    int depth = 0; // 1 inside the track's array, 2 inside a cue
+    std::string current_key;
+    CaptionCue cue{};
+
+    bool number(double value) {
+        if (depth != 2) {
+            return true;
+        }
+        if (current_key == "delay") {
+            cue.time_ms = value;
+        } else if (current_key == "message_id") {
+            cue.message_id = (int) value;
+        } else if (current_key == "chunk_id") {
+            cue.chunk_id = (int) value;
+        }
+        return true;
+    }
+
+public:
+    CaptionCueParser(CaptionSource *source, const SpeakerRegistry *speakers) : source(source), speakers(speakers) {}
+
+    bool null() override { return true; }
+
+    bool boolean(bool) override { return true; }
+
+    bool number_integer(number_integer_t value) override { return number((double) value); }
+
+    bool number_unsigned(number_unsigned_t value) override { return number((double) value); }
+
+    bool number_float(number_float_t value, const string_t &) override { return number(value); }
+
+    bool string(string_t &value) override {
+        if (depth != 2) {
+            return true;
+        }
+        if (current_key == "text") {
+            cue.text = std::move(value);
+        } else if (current_key == "speaker_id") {
+            cue.speaker = speaker_from_string(speakers, value);
+        }
+        return true;
+    }
+
+    bool binary(binary_t &) override { return true; }
+
+    bool start_object(std::size_t) override {
+        if (++depth == 2) {
+            cue = CaptionCue{};
+        }
+        return true;
+    }
+
+    bool key(string_t &value) override {
+        current_key = value;
+        return true;
+    }
+
+    bool end_object() override {
+        if (depth-- == 2) {
+            // Stops the parse if nobody wants any more cues.
+            return source->push(std::move(cue));
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) override {
+        depth++;
+        return true;
+    }
+
+    bool end_array() override {
+        depth--;
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string &, const nlohmann::detail::exception &error) override {
+        std::cerr << "Caption track is malformed at byte " << position << ": " << error.what() << std::endl;
+        return false;
+    }
+};
+
+/**
+ * Runs on the source's own thread, feeding it every cue in the file.
+ */
+static void read_caption_track(CaptionSource *source, const std::string path, const SpeakerRegistry *speakers) {
+    std::ifstream track_file(path.c_str());
+    if (!track_file) {
+        std::cerr << "Unable to open caption track " << path << ": " << strerror(errno) << std::endl;
+        source->finish();
+        return;
+    }
+    CaptionCueParser parser(source, speakers);
+    nlohmann::json::sax_parse(track_file, &parser);
+    source->finish();
+}
+
+CaptionSource::CaptionSource(const std::string &path, const SpeakerRegistry *speakers, size_t capacity) :
+        capacity(capacity) {
+    std::cout << "Streaming captions from " << path << std::endl;
+    reader = start_trial_thread(CAPTION_READER_THREAD, read_caption_track, this, path, speakers);
+}
+
+CaptionSource::~CaptionSource() {
+    close();
+    reader.join();
+}
+
+bool CaptionSource::next(CaptionCue *cue) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_changed.wait(lock, [this] { return !look_ahead.empty() || finished || closed; });
+    if (look_ahead.empty() || closed) {
+        return false;
+    }
+    *cue = std::move(look_ahead.front());
+    look_ahead.pop_front();
+    queue_changed.notify_all();
+    return true;
+}
+
+bool CaptionSource::push(CaptionCue cue) {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    queue_changed.wait(lock, [this] { return look_ahead.size() < capacity || closed; });
+    if (closed) {
+        return false;
+    }
+    look_ahead.push_back(std::move(cue));
+    cues_read++;
+    queue_changed.notify_all();
+    return true;
+}
+
+void CaptionSource::finish() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    finished = true;
+    queue_changed.notify_all();
+}
+
+void CaptionSource::close() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    closed = true;
+    queue_changed.notify_all();
+}
+
+size_t CaptionSource::cue_count() {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return cues_read;
+}
+
+void stream_caption_track(const std::atomic<bool> *started, const std::atomic<bool> *stopping, CaptionServer *server,
+                          CaptionSource *source, CaptionModel *model, const SpeakerRegistry *speakers) {
+    if (!wait_for_playback(started, stopping)) {
+        return;
+    }
+    const auto stream_start = metrics_clock_us();
+    double previous_time_ms = 0.0;
+    CaptionCue cue{};
+    while (source->next(&cue)) {
+        if (!reveal_caption_cue(cue, cue.time_ms - previous_time_ms, server, model, speakers, stopping)) {
+            return;
+        }
+        record_caption_revealed(&trial_metrics, (double) (metrics_clock_us() - stream_start) / 1000 - cue.time_ms);
+        previous_time_ms = cue.time_ms;
+    }
+    post_app_event(CAPTIONS_FINISHED);
+}
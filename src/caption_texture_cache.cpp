@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <iostream>
+#include "caption_texture_cache.hpp"
+
+SDL_Texture *create_caption_region_texture(SDL_Renderer *renderer, FrameArena *arena, const GlyphAtlas *glyph_atlas,
+                                           std::string_view text, const SDL_Rect *region,
+                                           const SDL_Color *foreground_color, const SDL_Color *background_color) {
+    if (arena == nullptr) {
+        auto *text_surface = SDL_CreateRGBSurfaceWithFormat(0, region->w, region->h, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (text_surface == nullptr) {
+            return nullptr;
+        }
+        rasterize_text_region_into(text_surface, glyph_atlas, text, region, foreground_color, background_color,
+                                   std::pmr::get_default_resource());
+        auto *texture = SDL_CreateTextureFromSurface(renderer, text_surface);
+        SDL_FreeSurface(text_surface);
+        return texture;
+    }
+    auto *text_surface = arena->text_surface(region->w, region->h);
+    if (text_surface == nullptr) {
+        return nullptr;
+    }
+    rasterize_text_region_into(text_surface, glyph_atlas, text, region, foreground_color, background_color, arena);
+    // Only the top-left of the pooled surface holds this caption, so it's uploaded with the surface's own pitch.
+    auto *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, region->w,
+                                      region->h);
+    if (texture != nullptr) {
+        SDL_UpdateTexture(texture, nullptr, text_surface->pixels, text_surface->pitch);
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+    }
+    return texture;
+}
+
+/**
+ * Rasterizes a caption into the slot's texture, first growing it (the only time it's reallocated) if it's too small.
+ */
+static bool fill_caption_slot(CachedCaptionTexture *slot, SDL_Renderer *renderer, FrameArena *arena,
+                              const GlyphAtlas *glyph_atlas, std::string_view text, const SDL_Color *foreground_color,
+                              const SDL_Color *background_color) {
+    const auto[text_width, text_height] = measure_text(glyph_atlas, text);
+    const int width = std::max(text_width, 1);
+    const int height = std::max(text_height, 1);
+    if (slot->texture == nullptr || width > slot->texture_width || height > slot->texture_height) {
+        const auto round_up = [](int size) {
+            return (size + CAPTION_TEXTURE_GROWTH - 1) / CAPTION_TEXTURE_GROWTH * CAPTION_TEXTURE_GROWTH;
+        };
+        const int texture_width = round_up(std::max(width, slot->texture_width));
+        const int texture_height = round_up(std::max(height, slot->texture_height));
+        auto *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                          texture_width, texture_height);
+        if (texture == nullptr) {
+            return false;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        SDL_DestroyTexture(slot->texture);
+        slot->texture = texture;
+        slot->texture_width = texture_width;
+        slot->texture_height = texture_height;
+    }
+    const SDL_Rect whole_text{0, 0, width, height};
+    SDL_Surface *text_surface = arena != nullptr
+                                ? arena->text_surface(width, height)
+                                : SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (text_surface == nullptr) {
+        return false;
+    }
+    rasterize_text_region_into(text_surface, glyph_atlas, text, &whole_text, foreground_color, background_color,
+                               frame_memory(arena));
+    SDL_UpdateTexture(slot->texture, &whole_text, text_surface->pixels, text_surface->pitch);
+    if (arena == nullptr) {
+        SDL_FreeSurface(text_surface);
+    }
+    slot->width = width;
+    slot->height = height;
+    return true;
+}
+
+const CachedCaptionTexture *cached_caption_texture(CaptionTextureCache *cache, SDL_Renderer *renderer,
+                                                   FrameArena *arena, size_t revision, const GlyphAtlas *glyph_atlas,
+                                                   SpeakerId juror, std::string_view text,
+                                                   const SDL_Color *foreground_color,
+                                                   const SDL_Color *background_color, bool cached_only) {
+    if (revision != cache->revision) {
+        if (cached_only && std::chrono::steady_clock::now() - cache->rasterized_at <
+                           std::chrono::milliseconds(CACHED_CAPTION_REFRESH_MS)) {
+            for (size_t i = 0; i < cache->used; ++i) {
+                const auto &entry = cache->entries[i];
+                if (entry.juror == juror) {
+                    cache->stale_hits++;
+                    cache->served_stale = true;
+                    return &entry;
+                }
+            }
+        }
+        clear_caption_texture_cache(cache);
+        cache->revision = revision;
+    }
+    for (size_t i = 0; i < cache->used; ++i) {
+        const auto &entry = cache->entries[i];
+        if (entry.juror == juror && entry.text == text) {
+            cache->hits++;
+            return &entry;
+        }
+    }
+    cache->misses++;
+    if (cache->used == cache->entries.size()) {
+        if (cache->entries.empty()) {
+            cache->entries.reserve(CAPTION_TEXTURE_POOL_SIZE);
+        }
+        cache->entries.push_back(CachedCaptionTexture{0, {}, nullptr, 0, 0, 0, 0});
+        cache->entries.back().text.reserve(CAPTION_TEXT_CAPACITY);
+    }
+    auto *slot = &cache->entries[cache->used];
+    if (!fill_caption_slot(slot, renderer, arena, glyph_atlas, text, foreground_color, background_color)) {
+        std::cerr << "Couldn't create caption texture: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+    // Assigning into the slot's string reuses its capacity, which only grows for a longer caption than it's held.
+    slot->juror = juror;
+    slot->text.assign(text.data(), text.size());
+    cache->used++;
+    cache->rasterized_at = std::chrono::steady_clock::now();
+    return slot;
+}
+
+SDL_Texture *cached_image_texture(CaptionTextureCache *cache, SDL_Renderer *renderer, const SDL_Surface *image) {
+    for (const auto &[cached_image, texture]: cache->images) {
+        if (cached_image == image) {
+            return texture;
+        }
+    }
+    auto *texture = SDL_CreateTextureFromSurface(renderer, const_cast<SDL_Surface *>(image));
+    if (texture == nullptr) {
+        std::cerr << "Couldn't create image texture: " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+    cache->images.emplace_back(image, texture);
+    return texture;
+}
+
+void clear_caption_texture_cache(CaptionTextureCache *cache) {
+    cache->used = 0;
+}
+
+void destroy_caption_texture_cache(CaptionTextureCache *cache) {
+    for (auto &entry: cache->entries) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    cache->entries.clear();
+    cache->used = 0;
+    for (auto &[_, texture]: cache->images) {
+        SDL_DestroyTexture(texture);
+    }
+    cache->images.clear();
+}
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "caption_timeline.hpp"
+#include "app_events.hpp"
+#include "metrics.hpp"
+
+#define STALE_CUE_MS 1000.0
+
+CaptionTimeline build_caption_timeline(const std::vector<CaptionCue> *cues, CaptionServer *server,
+                                       const SpeakerRegistry *speakers) {
+    CaptionTimeline timeline{cues, {}, {}, server, speakers};
+    timeline.reveal_times_ms.reserve(cues->size());
+    timeline.run_starts.reserve(cues->size());
+    double latest_ms = 0.0;
+    for (size_t i = 0; i < cues->size(); i++) {
+        // A cue timed before the one ahead of it is revealed straight after it, as start_caption_stream does.
+        latest_ms = std::max(latest_ms, cues->at(i).time_ms);
+        timeline.reveal_times_ms.push_back(latest_ms);
+        const bool same_speaker = i > 0 && cues->at(i).speaker == cues->at(i - 1).speaker;
+        timeline.run_starts.push_back(same_speaker ? timeline.run_starts.back() : i);
+    }
+    return timeline;
+}
+
+void advance_caption_timeline(CaptionTimeline *timeline, double media_time_ms) {
+    const auto &times = timeline->reveal_times_ms;
+    timeline->revealed = std::upper_bound(times.begin(), times.end(), media_time_ms) - times.begin();
+
+    if (timeline->revealed < timeline->transmitted) {
+        timeline->transmitted = timeline->revealed;
+    } else if (timeline->revealed > timeline->transmitted) {
+        // Anything revealed too long ago to still be news was skipped over by a seek, unless it's still on screen.
+        const size_t recent = std::lower_bound(times.begin(), times.end(), media_time_ms - STALE_CUE_MS) -
+                              times.begin();
+        timeline->transmitted = std::max(timeline->transmitted,
+                                         std::min<size_t>(recent, timeline->run_starts[timeline->revealed - 1]));
+    }
+    for (; timeline->transmitted < timeline->revealed; timeline->transmitted++) {
+        // Revealed on the first frame at or after its time, so it's late by at most a frame (unless frames are late).
+        record_caption_revealed(&trial_metrics, media_time_ms - times[timeline->transmitted]);
+        if (timeline->server != nullptr) {
+            transmit_caption_cue(timeline->cues->at(timeline->transmitted), timeline->server, timeline->speakers);
+        }
+    }
+
+    if (!timeline->finished && !times.empty() && timeline->revealed == times.size()) {
+        timeline->finished = true;
+        post_app_event(CAPTIONS_FINISHED);
+    }
+}
+
+std::pair<SpeakerId, std::string> caption_timeline_text(const CaptionTimeline *timeline, size_t revealed) {
+    if (revealed == 0) {
+        return std::make_pair(0, "");
+    }
+    std::string current_speech;
+    for (size_t i = timeline->run_starts[revealed - 1]; i < revealed; i++) {
+        current_speech += timeline->cues->at(i).text + " ";
+    }
+    return std::make_pair(timeline->cues->at(revealed - 1).speaker,
+                          CaptionModel::wrap(current_speech, CaptionModel::LINE_LENGTH));
+}
+
+size_t revealed_caption_count(const AppContext *context) {
+    if (context->caption_timeline != nullptr) {
+        return context->caption_timeline->revealed;
+    }
+    return context->caption_model->word_count();
+}
+
+size_t caption_revision(const AppContext *context) {
+    if (context->caption_timeline != nullptr) {
+        return context->caption_timeline->revealed;
+    }
+    return context->caption_model->revision();
+}
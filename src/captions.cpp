@@ -1,6 +1,12 @@
-#include <thread>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <thread>
 #include "captions.hpp"
+#include "app_events.hpp"
+#include "caption_server.hpp"
+#include "metrics.hpp"
+#include "thread_config.hpp"
 
 std::string CaptionModel::wrap(const std::string &text, const int line_length) {
     std::istringstream words(text);
@@ -29,85 +35,142 @@ std::string CaptionModel::wrap(const std::string &text, const int line_length) {
     return wrapped_lines.at(wrapped_lines.size() - 2) + '\n' + wrapped_lines.at(wrapped_lines.size() - 1);
 }
 
-void CaptionModel::add_word(const std::string &new_word, cog::Juror speaker) {
+void CaptionModel::add_word(const std::string &new_word, SpeakerId speaker) {
     text_mutex.lock();
-    if (!spoken_so_far.empty() && spoken_so_far.back().first != speaker) {
+    if (!spoken_so_far.empty() && spoken_so_far.back().speaker != speaker) {
         spoken_so_far.clear();
     }
-    spoken_so_far.emplace_back(speaker, new_word);
+    spoken_so_far.push_back(SpokenChunk{speaker, new_word, -1, -1});
+    ++words_added;
+    ++changes;
     text_mutex.unlock();
 }
 
-std::pair<cog::Juror, std::string> CaptionModel::get_current_text(const int line_length) {
+ChunkUpdate CaptionModel::update_chunk(const std::string &text, SpeakerId speaker, int message_id, int chunk_id) {
+    std::lock_guard<std::mutex> lock(text_mutex);
+    for (auto chunk = spoken_so_far.begin(); chunk != spoken_so_far.end(); ++chunk) {
+        if (chunk->message_id == message_id && chunk->chunk_id == chunk_id) {
+            if (text.empty()) {
+                spoken_so_far.erase(chunk);
+            } else {
+                chunk->text = text;
+            }
+            ++changes;
+            return CHUNK_REPLACED;
+        }
+    }
+    if (message_id < latest_message_id || text.empty()) {
+        return CHUNK_STALE;
+    }
+    latest_message_id = message_id;
+    if (!spoken_so_far.empty() && spoken_so_far.back().speaker != speaker) {
+        spoken_so_far.clear();
+    }
+    // Chunks can arrive out of order, but are shown in order.
+    auto position = spoken_so_far.end();
+    while (position != spoken_so_far.begin() && (position - 1)->message_id == message_id &&
+           (position - 1)->chunk_id > chunk_id) {
+        --position;
+    }
+    spoken_so_far.insert(position, SpokenChunk{speaker, text, message_id, chunk_id});
+    ++words_added;
+    ++changes;
+    return CHUNK_ADDED;
+}
+
+size_t CaptionModel::word_count() {
+    std::lock_guard<std::mutex> lock(text_mutex);
+    return words_added;
+}
+
+size_t CaptionModel::revision() {
+    std::lock_guard<std::mutex> lock(text_mutex);
+    return changes;
+}
+
+std::pair<SpeakerId, std::string> CaptionModel::get_current_text(const int line_length) {
     std::string current_speech;
-    cog::Juror current_juror = cog::Juror_JuryForeman;
+    SpeakerId current_juror = 0;
     text_mutex.lock();
     if (!spoken_so_far.empty()) {
-        current_juror = spoken_so_far.front().first;
-        for (const auto&[_, word]: spoken_so_far) {
-            current_speech += word + " ";
+        current_juror = spoken_so_far.front().speaker;
+        for (const auto &chunk: spoken_so_far) {
+            current_speech += chunk.text + " ";
         }
     }
     text_mutex.unlock();
     return std::make_pair(current_juror, wrap(current_speech, line_length));
 }
 
-cog::Juror juror_from_string(const std::string &juror_str) {
-    cog::Juror juror;
-    if (juror_str == "juror-a") {
-        juror = cog::Juror_JurorA;
-    } else if (juror_str == "juror-b") {
-        juror = cog::Juror_JurorB;
-    } else if (juror_str == "juror-c") {
-        juror = cog::Juror_JurorC;
-    } else if (juror_str == "jury-foreman") {
-        juror = cog::Juror_JuryForeman;
-    } else {
-        std::cerr << "Unknown speaker ID encountered: " << juror_str << std::endl;
-        throw;
+std::vector<CaptionCue> load_caption_track(const nlohmann::json &caption_json, const SpeakerRegistry *speakers) {
+    std::vector<CaptionCue> cues;
+    cues.reserve(caption_json.size());
+    for (const auto &entry: caption_json) {
+        cues.push_back(CaptionCue{
+                entry["delay"].get<double>(),
+                entry["text"].get<std::string>(),
+                speaker_from_string(speakers, entry["speaker_id"].get<std::string>()),
+                entry["message_id"].get<int>(),
+                entry["chunk_id"].get<int>()
+        });
     }
-    return juror;
+    return cues;
 }
 
-void transmit_caption(int socket, sockaddr_in *client_address, const std::string &text, cog::Juror speaker_id,
-                      cog::Juror focused_id, int message_id, int chunk_id) {
-    flatbuffers::FlatBufferBuilder builder(1024);
-    auto caption_message = cog::CreateCaptionMessageDirect(builder, text.c_str(), speaker_id, focused_id, message_id,
-                                                           chunk_id);
-    builder.Finish(caption_message);
-    uint8_t *buffer = builder.GetBufferPointer();
-    const auto size = builder.GetSize();
-    socklen_t len = sizeof(*client_address);
+std::string caption_track_path(int video_section) {
+    std::ostringstream os;
+    os << "resources/captions/merged_captions." << video_section << ".json";
+    return os.str();
+}
 
-    if (sendto(socket, buffer, size, 0, (struct sockaddr *) &(*client_address),
-               len) < 0) {
-        std::cerr << "sendto failed: " << strerror(errno) << std::endl;
-    }
-    std::cout << text << std::endl;
+nlohmann::json load_captions(int video_section) {
+    nlohmann::json json;
+    std::string captions_path = caption_track_path(video_section);
+    std::cout << "Captions path = " << captions_path << std::endl;
+    std::ifstream captions_file(captions_path.c_str());
+    captions_file >> json;
+    return json;
+}
+
+void transmit_caption_cue(const CaptionCue &cue, CaptionServer *server, const SpeakerRegistry *speakers) {
+    auto focused_id = cog::Juror_JuryForeman;
+    const auto transmit_start = metrics_clock_us();
+    server->broadcast_caption(cue.text, speakers->wire_ids[cue.speaker], focused_id, cue.message_id, cue.chunk_id);
+    count(&trial_metrics.captions_transmitted);
+    observe(&trial_metrics.transmit_ms, (double) (metrics_clock_us() - transmit_start) / 1000);
 }
 
+bool reveal_caption_cue(const CaptionCue &cue, double delay_ms, CaptionServer *server, CaptionModel *model,
+                        const SpeakerRegistry *speakers, const std::atomic<bool> *stopping) {
+    if (server != nullptr) {
+        transmit_caption_cue(cue, server, speakers);
+    }
+    const auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double, std::ratio<1, 1000>>(delay_ms));
+    const auto wake_at = std::chrono::steady_clock::now() + delay;
+    if (!sleep_until_or_stopping(wake_at, stopping)) {
+        return false;
+    }
+    record_wakeup(CAPTION_THREAD, wake_at);
+    model->add_word(cue.text, cue.speaker);
+    return true;
+}
 
 void
-start_caption_stream(const bool *started, int socket, sockaddr_in *client_address, nlohmann::json *caption_json,
-                     CaptionModel *model, const int presentation_method) {
-    while (!(*started)) {}
-    for (auto i = 0; i < caption_json->size(); ++i) {
-        auto text = caption_json->at(i)["text"].get<std::string>();
-        double delay;
-        if (i == 0) {
-            delay = caption_json->at(i)["delay"].get<double>();
-        } else {
-            delay = caption_json->at(i)["delay"].get<double>() - caption_json->at(i - 1)["delay"].get<double>();
-        }
-        auto speaker_id_str = caption_json->at(i)["speaker_id"].get<std::string>();
-        auto speaker_id = juror_from_string(speaker_id_str);
-        auto message_id = caption_json->at(i)["message_id"].get<int>();
-        auto chunk_id = caption_json->at(i)["chunk_id"].get<int>();
-        auto focused_id = cog::Juror_JuryForeman;
-        if (presentation_method == 4) {
-            transmit_caption(socket, client_address, text, speaker_id, focused_id, message_id, chunk_id);
+start_caption_stream(const std::atomic<bool> *started, const std::atomic<bool> *stopping, CaptionServer *server,
+                     const std::vector<CaptionCue> *cues, CaptionModel *model, const SpeakerRegistry *speakers) {
+    if (!wait_for_playback(started, stopping)) {
+        return;
+    }
+    const auto stream_start = metrics_clock_us();
+    double previous_time_ms = 0.0;
+    for (const auto &cue: *cues) {
+        if (!reveal_caption_cue(cue, cue.time_ms - previous_time_ms, server, model, speakers, stopping)) {
+            return;
         }
-        std::this_thread::sleep_for(std::chrono::duration<double, std::ratio<1, 1000>>(delay));
-        model->add_word(text, speaker_id);
+        // Each delay is slept from the previous caption, so any lateness builds up over the track.
+        record_caption_revealed(&trial_metrics, (double) (metrics_clock_us() - stream_start) / 1000 - cue.time_ms);
+        previous_time_ms = cue.time_ms;
     }
+    post_app_event(CAPTIONS_FINISHED);
 }
@@ -4,7 +4,57 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <qrencode.h>
+
+#define QR_MARGIN 2 // Quiet zone around the code, in modules; scanners need some light space around it
+
+/**
+ * Encodes text as a QR code and prints it to the console with ANSI background colors, two spaces per module (which
+ * comes out roughly square in most terminals). This is what `qrencode -t ANSI` prints, without starting a process.
+ */
+static void print_qr_code(const std::string &text) {
+    QRcode *qr_code = QRcode_encodeString(text.c_str(), 0, QR_ECLEVEL_L, QR_MODE_8, 1);
+    if (qr_code == nullptr) {
+        std::cerr << "Couldn't encode \"" << text << "\" as a QR code: " << strerror(errno) << std::endl;
+        return;
+    }
+    const std::string light = "\033[47m  ";
+    const std::string dark = "\033[40m  ";
+    const std::string reset = "\033[0m";
+    std::string blank_row;
+    for (int x = 0; x < qr_code->width + 2 * QR_MARGIN; x++) {
+        blank_row += light;
+    }
+    blank_row += reset + "\n";
+
+    // Build the whole code first, so that other threads printing at startup can't end up in the middle of it.
+    std::string output;
+    for (int i = 0; i < QR_MARGIN; i++) {
+        output += blank_row;
+    }
+    for (int y = 0; y < qr_code->width; y++) {
+        for (int i = 0; i < QR_MARGIN; i++) {
+            output += light;
+        }
+        for (int x = 0; x < qr_code->width; x++) {
+            // The lowest bit of each module is whether it's dark; the rest describe what part of the code it's in.
+            output += (qr_code->data[y * qr_code->width + x] & 1) ? dark : light;
+        }
+        for (int i = 0; i < QR_MARGIN; i++) {
+            output += light;
+        }
+        output += reset + "\n";
+    }
+    for (int i = 0; i < QR_MARGIN; i++) {
+        output += blank_row;
+    }
+    std::cout << output << std::flush;
+    QRcode_free(qr_code);
+}
 
 /**
  * Prints a QR code to the console. The QR code's contents are formatted as follows:
@@ -23,13 +73,10 @@ void print_connection_qr(int presentation_method, int port) {
             addr = inet_ntoa(sa->sin_addr);
             std::string interface = std::string(ifa->ifa_name);
             if (interface == "wlp3s0" || interface == "wlan0" || interface == "en0" || interface == "en1") {
-                std::ostringstream command;
-
-                std::string address = std::string(addr);
-                std::string address_port = address + ":" + std::to_string(port);
-                command << "qrencode -t ANSI \"" << addr << ":" << port << " " << presentation_method << "\"";
-                std::cout << "Command is: " << command.str() << std::endl;
-                system(command.str().c_str());
+                std::ostringstream contents;
+                contents << addr << ":" << port << " " << presentation_method;
+                std::cout << "QR code contents: " << contents.str() << std::endl;
+                print_qr_code(contents.str());
                 break;
             } else {
                 std::cout << "Interface: " << interface << " Address: " << addr << std::endl;
@@ -81,38 +128,32 @@ SDL_Color color_string_to_color(const std::string &color_str) {
     return result;
 }
 
-std::tuple<int, int, int, SDL_Color, SDL_Color, std::string>
-parse_arguments(int argc, char *argv[]) {
-    int video_section;
-    int presentation_method;
-    int half_fov;
-    SDL_Color foreground_color{0, 0, 0, 0};
-    SDL_Color background_color{0, 0, 0, 0};
-    std::string path_to_font;
-    int font_size;
+ExperimentOptions parse_arguments(int argc, char *argv[]) {
+    ExperimentOptions options;
+    options.workers = std::max(1u, std::thread::hardware_concurrency());
     int cmd_opt;
     int option_index = 0;
     std::string fg_color_str;
     std::string bg_color_str;
-    cmd_opt = getopt_long(argc, argv, "v:m:a:f:b:p:", long_options, &option_index);
+    cmd_opt = getopt_long(argc, argv, "v:m:a:f:b:p:r:R:s:e:F:j:w:c:B:SVC:MP:u:GI:AT:X:Y:", long_options, &option_index);
     while (cmd_opt) {
         if (cmd_opt == -1) {
             break;
         }
         switch (cmd_opt) {
             case 'v':
-                video_section = std::stoi(optarg);
-                if (video_section <= 0 || video_section > 4) {
+                options.video_section = std::stoi(optarg);
+                if (options.video_section <= 0 || options.video_section > 4) {
                     std::cerr << "Please pick a video section between 1-4." << std::endl;
                     exit(EXIT_FAILURE);
                 }
                 break;
             case 'm':
-                presentation_method = std::stoi(optarg);
+                options.presentation_method = std::stoi(optarg);
                 break;
             case 'a':
                 if (std::stoi(optarg) == 10 || std::stoi(optarg) == 20 || std::stoi(optarg) == 30 || std::stoi(optarg) == 40) {
-                    half_fov = (int) std::stoi(optarg) / 2;
+                    options.half_fov = (int) std::stoi(optarg) / 2;
                 } else {
                     std::cerr << "Please input FULL view angle of 10, 20, 30, or 40 degrees." << std::endl;
                     exit(EXIT_FAILURE);
@@ -120,23 +161,138 @@ parse_arguments(int argc, char *argv[]) {
                 break;
             case 'f':
                 fg_color_str = std::string(optarg);
-                foreground_color = color_string_to_color(fg_color_str);
+                options.foreground_color = color_string_to_color(fg_color_str);
                 break;
             case 'b':
                 bg_color_str = std::string(optarg);
-                background_color = color_string_to_color(bg_color_str);
+                options.background_color = color_string_to_color(bg_color_str);
                 break;
             case 'p':
-                path_to_font = std::string(optarg);
+                options.path_to_font = std::string(optarg);
+                break;
+            case 'r':
+                options.record_orientation_path = std::string(optarg);
+                break;
+            case 'R':
+                options.replay_orientation_path = std::string(optarg);
+                break;
+            case 's':
+                options.replay_speed = std::stod(optarg);
+                break;
+            case 'e':
+                options.export_path = std::string(optarg);
+                break;
+            case 'F':
+                options.export_fps = std::stoi(optarg);
+                if (options.export_fps <= 0) {
+                    std::cerr << "Please pick a positive export frame rate." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'j':
+                options.batch_path = std::string(optarg);
+                break;
+            case 'w':
+                if (std::stoi(optarg) <= 0) {
+                    std::cerr << "Please pick a positive number of workers." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                options.workers = std::stoi(optarg);
+                break;
+            case 'c':
+                options.scene_path = std::string(optarg);
+                break;
+            case 'B':
+                options.blend_benchmark_iterations = std::stoi(optarg);
+                break;
+            case 'S':
+                options.stream_captions = true;
+                break;
+            case 'V':
+                options.viewports = true;
+                break;
+            case 'C':
+                if (std::stoi(optarg) < 0) {
+                    std::cerr << "Please pick a non-negative coalescing window." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                options.coalesce_ms = std::stoi(optarg);
+                break;
+            case 'M':
+                options.media_clock = true;
+                break;
+            case 'P':
+                if (std::stoi(optarg) <= 0) {
+                    std::cerr << "Please pick a positive proxy height." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                options.proxy_height = std::stoi(optarg);
+                break;
+            case 'u':
+                options.metrics_socket_path = optarg;
+                break;
+            case 'G':
+                options.governor = true;
+                break;
+            case 'I':
+                if (std::stoi(optarg) <= 0 || std::stoi(optarg) > 65535) {
+                    std::cerr << "Please pick a port between 1 and 65535 to ingest captions on." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                options.ingest_port = std::stoi(optarg);
+                break;
+            case 'A':
+                options.simulate_asr = true;
+                break;
+            case 'T':
+                options.thread_config_path = optarg;
+                break;
+            case 'X':
+                options.frame_ring_name = optarg;
+                if (options.frame_ring_name.empty()) {
+                    std::cerr << "Please pick a name for the frame ring." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                if (options.frame_ring_name.front() != '/') {
+                    options.frame_ring_name = "/" + options.frame_ring_name;
+                }
+                break;
+            case 'Y':
+                if (std::stoi(optarg) <= 0) {
+                    std::cerr << "Please pick a positive frame ring interval." << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                options.frame_ring_interval = std::stoi(optarg);
                 break;
             case '?':
             default:
                 std::cerr << "Unknown option received: " << cmd_opt << std::endl;
         }
-        cmd_opt = getopt_long(argc, argv, "v:m:a:f:b:p:", long_options, &option_index);
+        cmd_opt = getopt_long(argc, argv, "v:m:a:f:b:p:r:R:s:e:F:j:w:c:B:SVC:MP:u:GI:AT:X:Y:", long_options, &option_index);
+    }
+    if (!options.record_orientation_path.empty() && !options.replay_orientation_path.empty()) {
+        std::cerr << "Cannot record and replay orientation in the same trial." << std::endl;
+        exit(EXIT_FAILURE);
     }
-    std::cout << "Using presentation method: " << presentation_method << std::endl;
-    std::cout << "Playing video section: " << video_section << std::endl;
-    std::cout << "Using full field of view (degrees): " << ((int) 2*half_fov) << std::endl;
-    return std::make_tuple(video_section, presentation_method, half_fov, foreground_color, background_color, path_to_font);
-}
\ No newline at end of file
+    if (options.media_clock && options.stream_captions) {
+        std::cerr << "Following the media clock needs the whole caption track, so it can't be streamed." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.ingest_port > 0 && (options.media_clock || options.stream_captions)) {
+        std::cerr << "Live captions don't come from the caption track, so they can't follow the media clock or be "
+                     "streamed from it." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (options.simulate_asr && options.ingest_port <= 0) {
+        std::cerr << "The simulated recognizer needs a port to send to; pick one with --ingest." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Using presentation method: " << options.presentation_method << std::endl;
+    std::cout << "Playing video section: " << options.video_section << std::endl;
+    std::cout << "Using full field of view (degrees): " << ((int) 2 * options.half_fov) << std::endl;
+    if (!options.replay_orientation_path.empty()) {
+        std::cout << "Replaying orientation from: " << options.replay_orientation_path
+                  << " (speed " << options.replay_speed << "x)" << std::endl;
+    }
+    return options;
+}
@@ -0,0 +1,90 @@
+#include <cerrno>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+#include <mutex>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ffmpeg_process.hpp"
+
+extern char **environ;
+
+static std::mutex spawn_mutex;
+
+bool start_ffmpeg(const std::vector<std::string> &arguments, bool reading, FfmpegProcess *process) {
+    // pipe2 (which sets close-on-exec atomically) isn't portable, so spawns are serialized instead: no other ffmpeg
+    // can be started between the pipe being created and it being marked close-on-exec, and inherit it.
+    std::unique_lock<std::mutex> lock(spawn_mutex);
+    int pipe_fds[2];
+    if (pipe(pipe_fds) < 0) {
+        std::cerr << "Unable to create a pipe for ffmpeg: " << strerror(errno) << std::endl;
+        return false;
+    }
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+    const int parent_end = reading ? pipe_fds[0] : pipe_fds[1];
+    const int child_end = reading ? pipe_fds[1] : pipe_fds[0];
+
+    std::vector<char *> argv;
+    argv.push_back(const_cast<char *>("ffmpeg"));
+    for (const auto &argument: arguments) {
+        argv.push_back(const_cast<char *>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    // dup2 clears close-on-exec on the copy, so the child keeps its end as stdin or stdout, and nothing else.
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, child_end, reading ? STDOUT_FILENO : STDIN_FILENO);
+    // Exports ignore SIGPIPE, which a child would inherit; ffmpeg gets the default back.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+    pid_t pid = 0;
+    const int error = posix_spawnp(&pid, "ffmpeg", &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    lock.unlock();
+    close(child_end);
+    if (error != 0) {
+        std::cerr << "Unable to start ffmpeg: " << strerror(error) << std::endl;
+        close(parent_end);
+        return false;
+    }
+    FILE *pipe = fdopen(parent_end, reading ? "r" : "w");
+    if (pipe == nullptr) {
+        std::cerr << "Unable to open ffmpeg's pipe: " << strerror(errno) << std::endl;
+        close(parent_end);
+        waitpid(pid, nullptr, 0);
+        return false;
+    }
+    *process = FfmpegProcess{pid, pipe};
+    return true;
+}
+
+bool finish_ffmpeg(FfmpegProcess *process) {
+    fclose(process->pipe);
+    process->pipe = nullptr;
+    int status = 0;
+    while (waitpid(process->pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            std::cerr << "Unable to wait for ffmpeg: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+std::string ffmpeg_command_line(const std::vector<std::string> &arguments) {
+    std::string command = "ffmpeg";
+    for (const auto &argument: arguments) {
+        command += " " + argument;
+    }
+    return command;
+}
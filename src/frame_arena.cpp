@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include "frame_arena.hpp"
+
+FrameArena::FrameArena(size_t capacity) : block(capacity) {
+    spills.reserve(16);
+}
+
+FrameArena::~FrameArena() {
+    for (const auto &[pointer, layout]: spills) {
+        std::pmr::new_delete_resource()->deallocate(pointer, layout.first, layout.second);
+    }
+    for (auto *surface: surfaces) {
+        SDL_FreeSurface(surface);
+    }
+}
+
+void *FrameArena::do_allocate(size_t bytes, size_t alignment) {
+    needed += bytes + alignment;
+    auto *base = block.data() + used;
+    size_t space = block.size() - used;
+    void *aligned = base;
+    if (std::align(alignment, bytes, aligned, space) != nullptr) {
+        used = (std::byte *) aligned - block.data() + bytes;
+        return aligned;
+    }
+    void *pointer = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    spills.emplace_back(pointer, std::make_pair(bytes, alignment));
+    return pointer;
+}
+
+void FrameArena::do_deallocate([[maybe_unused]] void *pointer, [[maybe_unused]] size_t bytes,
+                               [[maybe_unused]] size_t alignment) {
+    // Everything is released at once, in end_frame.
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+SDL_Surface *FrameArena::text_surface(int width, int height) {
+    if (surfaces_used == surfaces.size()) {
+        surfaces.push_back(nullptr);
+    }
+    auto *&surface = surfaces[surfaces_used];
+    if (surface == nullptr || surface->w < width || surface->h < height) {
+        const int new_width = std::max(width, surface != nullptr ? surface->w : 0);
+        const int new_height = std::max(height, surface != nullptr ? surface->h : 0);
+        SDL_FreeSurface(surface);
+        surface = SDL_CreateRGBSurfaceWithFormat(0, new_width, new_height, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (surface == nullptr) {
+            std::cerr << "Couldn't create text surface: " << SDL_GetError() << std::endl;
+            return nullptr;
+        }
+    }
+    surfaces_used++;
+    return surface;
+}
+
+void FrameArena::end_frame() {
+    frames++;
+    if (!spills.empty()) {
+        spilled_frames++;
+        for (const auto &[pointer, layout]: spills) {
+            std::pmr::new_delete_resource()->deallocate(pointer, layout.first, layout.second);
+        }
+        spills.clear();
+        // Next time, the whole frame fits.
+        block.resize(std::max(block.size() * 2, needed));
+    }
+    used = 0;
+    needed = 0;
+    surfaces_used = 0;
+
+    // The first call only marks where counting starts.
+    // VLC can move its callbacks to another thread (whose count starts elsewhere), so a count that's gone backwards
+    // is ignored.
+    const auto allocations_now = thread_allocation_count();
+    const auto frame_allocations = allocations_now >= allocations_at_frame_start
+                                   ? allocations_now - allocations_at_frame_start : 0;
+    if (frames > 1 && frame_allocations > 0) {
+        allocating_frames++;
+        allocations += frame_allocations;
+        max_frame_allocations = std::max(max_frame_allocations, frame_allocations);
+        last_allocating_frame = frames;
+    }
+    allocations_at_frame_start = thread_allocation_count();
+}
+
+void FrameArena::print_stats() {
+    std::cout << "Frame arena: " << frames << " frames, " << spilled_frames << " outgrew the arena (now "
+              << block.size() / 1024 << " KiB), " << surfaces.size() << " pooled text surface(s)" << std::endl;
+#ifdef COG_COUNT_ALLOCATIONS
+    std::cout << "Render thread allocations: " << allocations << " in " << allocating_frames << " frame(s) (at most "
+              << max_frame_allocations << " in one frame); the last frame that allocated was frame "
+              << last_allocating_frame << std::endl;
+#endif
+}
+
+std::pmr::memory_resource *frame_memory(FrameArena *arena) {
+    if (arena == nullptr) {
+        return std::pmr::get_default_resource();
+    }
+    return arena;
+}
+
+#ifdef COG_COUNT_ALLOCATIONS
+
+static thread_local uint64_t allocation_count = 0;
+
+static void *counted_malloc(size_t size) {
+    allocation_count++;
+    return malloc(size);
+}
+
+static void *counted_calloc(size_t count, size_t size) {
+    allocation_count++;
+    return calloc(count, size);
+}
+
+static void *counted_realloc(void *pointer, size_t size) {
+    allocation_count++;
+    return realloc(pointer, size);
+}
+
+void install_allocation_counter() {
+    if (SDL_SetMemoryFunctions(counted_malloc, counted_calloc, counted_realloc, free) != 0) {
+        std::cerr << "Couldn't count SDL's allocations: " << SDL_GetError() << std::endl;
+    }
+}
+
+uint64_t thread_allocation_count() {
+    return allocation_count;
+}
+
+void *operator new(size_t size) {
+    allocation_count++;
+    if (void *pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    allocation_count++;
+    const auto align = std::max((size_t) alignment, sizeof(void *));
+    if (void *pointer = aligned_alloc(align, (size + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+#else
+
+void install_allocation_counter() {}
+
+uint64_t thread_allocation_count() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "frame_ring.hpp"
+#include "metrics.hpp"
+
+static size_t round_up_to_page(size_t size) {
+    const auto page = (size_t) sysconf(_SC_PAGESIZE);
+    return (size + page - 1) / page * page;
+}
+
+static FrameSlotHeader *frame_slot(const FrameRing *ring, uint64_t frame_number) {
+    const auto index = (frame_number - 1) % ring->header->slot_count;
+    return (FrameSlotHeader *) (ring->memory + FRAME_RING_HEADER_SIZE + index * ring->header->slot_size);
+}
+
+bool open_frame_ring(const std::string &name, int max_width, int max_height, uint32_t frame_interval,
+                     FrameRing *ring) {
+    // Left over from a trial that didn't exit cleanly; its consumers are gone or will notice the new ring.
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Unable to create frame ring " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    const uint32_t pitch = (uint32_t) max_width * SDL_BYTESPERPIXEL(FRAME_RING_PIXEL_FORMAT);
+    const size_t slot_size = round_up_to_page(FRAME_SLOT_HEADER_SIZE + (size_t) pitch * max_height);
+    const size_t size = FRAME_RING_HEADER_SIZE + slot_size * FRAME_RING_SLOTS;
+    if (ftruncate(fd, (off_t) size) < 0) {
+        std::cerr << "Unable to size frame ring " << name << ": " << strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        std::cerr << "Unable to map frame ring " << name << ": " << strerror(errno) << std::endl;
+        close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    // The memory starts out zeroed, so every slot's sequence is already 0 (even, and not yet published).
+    auto *header = new(memory) FrameRingHeader{};
+    header->version = FRAME_RING_VERSION;
+    header->slot_count = FRAME_RING_SLOTS;
+    header->max_width = max_width;
+    header->max_height = max_height;
+    header->pitch = pitch;
+    header->pixel_format = FRAME_RING_PIXEL_FORMAT;
+    header->frame_interval = frame_interval;
+    header->slot_size = slot_size;
+    header->latest_frame.store(0, std::memory_order_relaxed);
+    // The magic goes in last, so a consumer that finds it finds the rest of the header too.
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, FRAME_RING_MAGIC, sizeof(header->magic));
+
+    *ring = FrameRing{name, fd, (uint8_t *) memory, size, header, 0, 0, nullptr};
+    std::cout << "Publishing frames (up to " << max_width << "x" << max_height;
+    if (frame_interval > 1) {
+        std::cout << ", one in every " << frame_interval;
+    }
+    std::cout << ") to shared memory " << name << ", " << size / (1024 * 1024) << " MiB" << std::endl;
+    return true;
+}
+
+void begin_frame_export(FrameRing *ring, SDL_Renderer *renderer, int64_t media_time_ms, float azimuth,
+                        uint64_t caption_revision) {
+    if (ring->presented++ % ring->header->frame_interval != 0) {
+        return;
+    }
+    const auto started_us = metrics_clock_us();
+    const auto frame_number = ++ring->frames;
+    auto *slot = frame_slot(ring, frame_number);
+    const auto sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    // Nothing below may be seen by a consumer before the slot is marked as being written.
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int output_width = 0;
+    int output_height = 0;
+    SDL_GetRendererOutputSize(renderer, &output_width, &output_height);
+    const SDL_Rect frame_rect{0, 0, std::min<int>(output_width, (int) ring->header->max_width),
+                              std::min<int>(output_height, (int) ring->header->max_height)};
+    auto *pixels = (uint8_t *) slot + FRAME_SLOT_HEADER_SIZE;
+    const auto pitch = (int) ring->header->pitch;
+    if (SDL_RenderReadPixels(renderer, &frame_rect, FRAME_RING_PIXEL_FORMAT, pixels, pitch) == 0) {
+        slot->width = frame_rect.w;
+        slot->height = frame_rect.h;
+    } else {
+        slot->width = 0;
+        slot->height = 0;
+    }
+    slot->frame_number = frame_number;
+    slot->media_time_ms = media_time_ms;
+    slot->caption_revision = caption_revision;
+    slot->azimuth = azimuth;
+    ring->writing = slot;
+    observe(&trial_metrics.frame_export_ms, (double) (metrics_clock_us() - started_us) / 1000);
+}
+
+void end_frame_export(FrameRing *ring) {
+    auto *slot = ring->writing;
+    if (slot == nullptr) {
+        return;
+    }
+    slot->presented_us = metrics_clock_us();
+    slot->sequence.store(slot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    ring->header->latest_frame.store(slot->frame_number, std::memory_order_release);
+    ring->writing = nullptr;
+    count(&trial_metrics.frames_exported);
+}
+
+void close_frame_ring(FrameRing *ring) {
+    if (ring->memory == nullptr) {
+        return;
+    }
+    munmap(ring->memory, ring->size);
+    close(ring->fd);
+    shm_unlink(ring->name.c_str());
+    std::cout << "Published " << ring->frames << " frames to " << ring->name << std::endl;
+    ring->memory = nullptr;
+    ring->header = nullptr;
+}
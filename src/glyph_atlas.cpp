@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <iostream>
+#include "glyph_atlas.hpp"
+
+GlyphAtlas build_glyph_atlas(TTF_Font *font) {
+    GlyphAtlas atlas{};
+    atlas.height = TTF_FontHeight(font);
+    atlas.line_skip = TTF_FontLineSkip(font);
+    // Render white-on-black so that the 8-bit palette index of every pixel is exactly its coverage.
+    const SDL_Color white{255, 255, 255, 255};
+    const SDL_Color black{0, 0, 0, 255};
+    for (int character = FIRST_ATLAS_GLYPH; character <= LAST_ATLAS_GLYPH; ++character) {
+        auto &glyph = atlas.glyphs[character - FIRST_ATLAS_GLYPH];
+        int min_x, max_x, min_y, max_y;
+        TTF_GlyphMetrics(font, character, &min_x, &max_x, &min_y, &max_y, &glyph.advance);
+        glyph.offset = atlas.coverage.size();
+        SDL_Surface *surface = TTF_RenderGlyph_Shaded(font, character, white, black);
+        if (surface == nullptr) {
+            std::cerr << "Unable to rasterize glyph '" << (char) character << "': " << TTF_GetError() << std::endl;
+            glyph.width = 0;
+            glyph.height = 0;
+            continue;
+        }
+        glyph.width = surface->w;
+        glyph.height = surface->h;
+        SDL_LockSurface(surface);
+        const auto *pixels = (const uint8_t *) surface->pixels;
+        for (int row = 0; row < surface->h; ++row) {
+            atlas.coverage.insert(atlas.coverage.end(), pixels + row * surface->pitch,
+                                  pixels + row * surface->pitch + surface->w);
+        }
+        SDL_UnlockSurface(surface);
+        SDL_FreeSurface(surface);
+    }
+    return atlas;
+}
+
+const AtlasGlyph &atlas_glyph(const GlyphAtlas *atlas, char character) {
+    if (character < FIRST_ATLAS_GLYPH || character > LAST_ATLAS_GLYPH) {
+        character = '?';
+    }
+    return atlas->glyphs[character - FIRST_ATLAS_GLYPH];
+}
+
+std::tuple<int, int> measure_text(const GlyphAtlas *atlas, std::string_view text) {
+    int width = 0;
+    int lines = 1;
+    int pen_x = 0;
+    int line_width = 0;
+    for (const char character: text) {
+        if (character == '\n') {
+            width = std::max(width, line_width);
+            pen_x = 0;
+            line_width = 0;
+            ++lines;
+            continue;
+        }
+        const auto &glyph = atlas_glyph(atlas, character);
+        line_width = std::max(line_width, pen_x + glyph.width);
+        pen_x += glyph.advance;
+    }
+    width = std::max(width, line_width);
+    return std::make_tuple(width, lines * atlas->line_skip);
+}
+
+void accumulate_text_coverage(const GlyphAtlas *atlas, std::string_view text, int width, int height,
+                              uint8_t *coverage) {
+    const SDL_Rect whole_text{0, 0, width, height};
+    accumulate_text_coverage_in(atlas, text, &whole_text, coverage);
+}
+
+void accumulate_text_coverage_in(const GlyphAtlas *atlas, std::string_view text, const SDL_Rect *region,
+                                 uint8_t *coverage) {
+    const int region_right = region->x + region->w;
+    const int region_bottom = region->y + region->h;
+    int pen_x = 0;
+    int pen_y = 0;
+    for (size_t i = 0; i < text.size() && pen_y < region_bottom; ++i) {
+        if (text[i] == '\n') {
+            pen_x = 0;
+            pen_y += atlas->line_skip;
+            continue;
+        }
+        if (pen_x >= region_right) {
+            // Pens only move right, so nothing else on this line is in the region.
+            const auto line_end = text.find('\n', i);
+            if (line_end == std::string_view::npos) {
+                break;
+            }
+            i = line_end - 1;
+            continue;
+        }
+        const auto &glyph = atlas_glyph(atlas, text[i]);
+        const int first_row = std::max(pen_y, region->y);
+        const int last_row = std::min(pen_y + glyph.height, region_bottom);
+        const int first_column = std::max(pen_x, region->x);
+        const int last_column = std::min(pen_x + glyph.width, region_right);
+        for (int row = first_row; row < last_row; ++row) {
+            const uint8_t *source = &atlas->coverage[glyph.offset + (size_t) (row - pen_y) * glyph.width];
+            uint8_t *destination = &coverage[(size_t) (row - region->y) * region->w];
+            for (int column = first_column; column < last_column; ++column) {
+                destination[column - region->x] = std::max(destination[column - region->x], source[column - pen_x]);
+            }
+        }
+        pen_x += glyph.advance;
+    }
+}
+
+SDL_Surface *rasterize_text(const GlyphAtlas *atlas, std::string_view text, const SDL_Color *foreground_color,
+                            const SDL_Color *background_color) {
+    const auto[width, height] = measure_text(atlas, text);
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, std::max(width, 1), height, 32,
+                                                          SDL_PIXELFORMAT_ARGB8888);
+    if (surface == nullptr) {
+        return nullptr;
+    }
+    rasterize_text_into(surface, atlas, text, surface->w, height, foreground_color, background_color,
+                        std::pmr::get_default_resource());
+    return surface;
+}
+
+void rasterize_text_into(SDL_Surface *surface, const GlyphAtlas *atlas, std::string_view text, int width, int height,
+                         const SDL_Color *foreground_color, const SDL_Color *background_color,
+                         std::pmr::memory_resource *scratch) {
+    const SDL_Rect whole_text{0, 0, width, height};
+    rasterize_text_region_into(surface, atlas, text, &whole_text, foreground_color, background_color, scratch);
+}
+
+void rasterize_text_region_into(SDL_Surface *surface, const GlyphAtlas *atlas, std::string_view text,
+                                const SDL_Rect *region, const SDL_Color *foreground_color,
+                                const SDL_Color *background_color, std::pmr::memory_resource *scratch) {
+    // Coverage is accumulated first (taking the max where glyph boxes overlap), then shaded from background to
+    // foreground in a single pass, the same way SDL_ttf's shaded palette does.
+    const int width = region->w;
+    const int height = region->h;
+    std::pmr::vector<uint8_t> text_coverage((size_t) width * height, 0, scratch);
+    accumulate_text_coverage_in(atlas, text, region, text_coverage.data());
+
+    SDL_LockSurface(surface);
+    for (int row = 0; row < height; ++row) {
+        auto *pixels = (uint32_t *) ((uint8_t *) surface->pixels + row * surface->pitch);
+        for (int column = 0; column < width; ++column) {
+            const int alpha = text_coverage[(size_t) row * width + column];
+            const auto mix = [alpha](Uint8 background, Uint8 foreground) {
+                return (uint32_t) ((background * (255 - alpha) + foreground * alpha) / 255);
+            };
+            pixels[column] = mix(background_color->a, foreground_color->a) << 24 |
+                             mix(background_color->r, foreground_color->r) << 16 |
+                             mix(background_color->g, foreground_color->g) << 8 |
+                             mix(background_color->b, foreground_color->b);
+        }
+    }
+    SDL_UnlockSurface(surface);
+}
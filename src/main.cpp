@@ -6,9 +6,35 @@
 #include "nlohmann/json.hpp"
 #include "captions.hpp"
 #include "orientation.hpp"
+#include "orientation_recording.hpp"
+#include "offline_export.hpp"
+#include "batch_render.hpp"
+#include "caption_layout.hpp"
+#include "render_config.hpp"
+#include "app_events.hpp"
+#include "caption_overlay.hpp"
+#include "caption_blend.hpp"
+#include "startup.hpp"
+#include "caption_source.hpp"
+#include "caption_server.hpp"
+#include "caption_texture_cache.hpp"
+#include "viewports.hpp"
+#include "caption_timeline.hpp"
+#include "proxy_cache.hpp"
+#include "frame_arena.hpp"
+#include "metrics.hpp"
+#include "quality_governor.hpp"
+#include "caption_ingest.hpp"
+#include "thread_config.hpp"
+#include "frame_ring.hpp"
+#include <memory>
 #include <thread>
 #include <fstream>
+#include <sstream>
 #include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <sys/socket.h>
 #include <vlc/vlc.h>
 #include "cog-flatbuffer-definitions/orientation_message_generated.h"
 
@@ -26,19 +52,22 @@
 
 #define WINDOW_TITLE "Four Angry Men"
 
-#define REGISTERED_GRAPHICS 1
-#define NONREGISTERED_GRAPHICS 2
-#define NONREGISTERED_GRAPHICS_WITH_ARROWS 3
-#define CONTROL 4
-
 #define WINDOW_OFFSET_X 83 // ASSUMING 3840x2160 DISPLAY
 #define WINDOW_OFFSET_Y 292
 
+#define EVENT_WAIT_TIMEOUT_MS 1000 // Everything we react to is an event, this is just a backstop for checking `done`
+#define STARTUP_WORKERS 4 // Startup steps mostly wait on the disk or FreeType, so a few threads are plenty
+
 
 /**
  * This function is called prior to VLC rendering a video frame.
  * What we do here is lock our mutex (preventing other threads from touching the texture), and lock the texture from being
  * modified by other threads. This allows VLC to render to the texture peacefully, without data races.
+ * This is also where we pick up any config the main loop has published (e.g. after a resize), so the whole frame is
+ * drawn with one consistent config, and where the caption timeline (if captions follow the media clock) catches up with
+ * the frame's playback time. Frames the quality governor skips are decoded into its scratch buffer instead, and
+ * nothing else happens to them. VLC's video thread is configured as the render thread on its first frame, and is
+ * meant to wake up one frame period after the last frame started.
  * @param data A pointer to data that would be useful for whatever we want to do in this function (in this case, AppContext, for mutex/texture access)
  * @param p_pixels An array of pixels representing the image, stored as concatenated rows
  * @return nullptr.
@@ -46,7 +75,34 @@
 static void *lock(void *data, void **p_pixels) {
     auto *c = (AppContext *) data;
     int pitch;
+    if (c->quality_governor != nullptr && c->quality_governor->begin_frame(c->texture, p_pixels)) {
+        return nullptr;
+    }
     SDL_LockMutex(c->mutex);
+    configure_current_thread(RENDER_THREAD);
+    const auto previous_frame_started_us = trial_metrics.frame_started_us.load(std::memory_order_relaxed);
+    record_frame_started(&trial_metrics);
+    record_paced_wakeup(RENDER_THREAD, previous_frame_started_us,
+                        trial_metrics.frame_started_us.load(std::memory_order_relaxed),
+                        trial_metrics.frame_period_us.load(std::memory_order_relaxed));
+    if (trial_metrics.frame_period_us.load(std::memory_order_relaxed) == 0 && c->media_player != nullptr) {
+        // VLC only knows the frame rate once it's started decoding.
+        set_expected_frame_rate(&trial_metrics, libvlc_media_player_get_fps(c->media_player));
+    }
+    const bool config_changed = apply_render_config(c);
+    if (config_changed) {
+        SDL_RenderSetViewport(c->renderer, nullptr);
+        // The fonts may have been rescaled along with the window, so cached captions are the wrong size.
+        if (c->caption_textures != nullptr) {
+            clear_caption_texture_cache(c->caption_textures);
+        }
+    }
+    if (c->viewports != nullptr) {
+        sync_viewports(c->viewports, c, config_changed);
+    }
+    if (c->caption_timeline != nullptr) {
+        advance_caption_timeline(c->caption_timeline, (double) libvlc_media_player_get_time(c->media_player));
+    }
     SDL_LockTexture(c->texture, nullptr, p_pixels, &pitch);
 
     return nullptr; // Picture identifier, not needed here.
@@ -54,6 +110,8 @@ static void *lock(void *data, void **p_pixels) {
 
 /**
  * This function is called after VLC renders a video frame. Once VLC is done writing a frame, we want to immediately overlay the captions on top of the frame, according to the presentation method provided, and render the frame. Once rendered, that caption, we unlock the mutex and texture for other threads to access.
+ * Captions come from the overlay layer, which is only redrawn when they've actually changed. Once the frame is
+ * presented, everything the render path allocated from the frame arena for it is released.
  * @param data A pointer to data that would be useful for whatever we want to do in this function (in this case, AppContext, for presentation method/mutex/texture access)
  * @param id Honestly? Not really sure what this parameter is, but I haven't needed it. It's here to comply with the function signature expected by VLC.
  * @param p_pixels An array of pixels representing the image, stored as concatenated rows
@@ -61,27 +119,37 @@ static void *lock(void *data, void **p_pixels) {
 static void unlock(void *data, [[maybe_unused]] void *id, [[maybe_unused]] void *const *p_pixels) {
 
     const auto *app_context = (AppContext *) data;
+    if (app_context->quality_governor != nullptr && app_context->quality_governor->skipping_frame()) {
+        return;
+    }
 
-    // Based on the presentation method selected by the researcher, we want to render captions in different ways.
-    switch (app_context->presentation_method) {
-        case REGISTERED_GRAPHICS:
-            // Registered graphics remain stationary in space
-            render_registered_captions(app_context);
-            break;
-        case NONREGISTERED_GRAPHICS:
-            // Non-registered graphics follow the user's head orientation around the screen
-            render_nonregistered_captions(app_context);
-            break;
-        case NONREGISTERED_GRAPHICS_WITH_ARROWS:
-            render_nonregistered_captions_with_indicators(app_context);
-            break;
-        case CONTROL:
-            break;
-        default:
-            std::cout << "Unknown method received: " << app_context->presentation_method << std::endl;
-            break;
+    // Live captions that have arrived by now are drawn into this frame (unless they're only shown on the HWD).
+    const auto undisplayed_since =
+            app_context->presentation_method != CONTROL ? undisplayed_caption_since(&trial_metrics) : 0;
+    if (has_multiple_viewports(app_context)) {
+        composite_viewports(app_context->viewports);
+    } else {
+        composite_caption_overlay(app_context);
+    }
+    if (app_context->frame_ring != nullptr) {
+        begin_frame_export(app_context->frame_ring, app_context->renderer,
+                           libvlc_media_player_get_time(app_context->media_player),
+                           filtered_azimuth(app_context->azimuth_buffer, app_context->azimuth_mutex,
+                                            orientation_filter_taps(app_context->quality_governor)),
+                           caption_revision(app_context));
     }
     SDL_RenderPresent(app_context->renderer);
+    record_frame_presented(&trial_metrics);
+    record_captions_displayed(&trial_metrics, undisplayed_since);
+    if (app_context->frame_ring != nullptr) {
+        end_frame_export(app_context->frame_ring);
+    }
+    if (app_context->quality_governor != nullptr) {
+        app_context->quality_governor->end_frame();
+    }
+    if (app_context->frame_arena != nullptr) {
+        app_context->frame_arena->end_frame();
+    }
     SDL_UnlockTexture(app_context->texture);
     SDL_UnlockMutex(app_context->mutex);
 }
@@ -97,72 +165,107 @@ static void unlock(void *data, [[maybe_unused]] void *id, [[maybe_unused]] void
 static void display(void *data, void *id) {
 
     auto *app_context = (AppContext *) data;
+    if (app_context->quality_governor != nullptr && app_context->quality_governor->skipping_frame()) {
+        return;
+    }
 
-    app_context->display_rect.x = 0;
-    app_context->display_rect.y = 0;
-    app_context->display_rect.w = app_context->window_width;
-    app_context->display_rect.h = app_context->window_height;
-    SDL_SetRenderDrawColor(app_context->renderer,
-                           0,
-                           0,
-                           0,
-                           255);
-    SDL_RenderClear(app_context->renderer);
+    if (has_multiple_viewports(app_context)) {
+        display_viewports(app_context->viewports, app_context->renderer, app_context->texture);
+        return;
+    }
+    // The video covers the whole window unless the window size hasn't caught up with a resize yet, so there's
+    // normally nothing left over to clear.
+    int output_width = 0;
+    int output_height = 0;
+    SDL_GetRendererOutputSize(app_context->renderer, &output_width, &output_height);
+    if (app_context->display_rect.w < output_width || app_context->display_rect.h < output_height) {
+        SDL_SetRenderDrawColor(app_context->renderer,
+                               0,
+                               0,
+                               0,
+                               255);
+        SDL_RenderClear(app_context->renderer);
+    }
     SDL_RenderCopy(app_context->renderer,
                    app_context->texture,
                    nullptr,
                    &app_context->display_rect);
 }
 
-void create_fonts(void *data)
-{
-    auto *app_context = (AppContext *) data;
-//    auto path = app_context->path_to_font;
-//    TTF_Font *smallest_font = TTF_OpenFont(path.c_str(), FONT_SIZE_SMALL);
-    TTF_Font *medium_font = TTF_OpenFont(app_context->path_to_font.c_str(), FONT_SIZE_MEDIUM);
-//    TTF_Font *largest_font = TTF_OpenFont(path.c_str(), FONT_SIZE_LARGE);
-//    app_context->smallest_font = smallest_font;
-    app_context->medium_font = medium_font;
-//    app_context->largest_font = largest_font;
-    const std::map<cog::Juror, TTF_Font *> juror_font_sizes{
-            {cog::Juror_JurorA,      medium_font},
-            {cog::Juror_JurorB,      medium_font},
-            {cog::Juror_JuryForeman, medium_font},
-            {cog::Juror_JurorC,      medium_font}
-    };
-    app_context->juror_font_sizes = &juror_font_sizes;
+/**
+ * Stands in for VLC's video output when frames come from a proxy: shows whichever proxy frame matches VLC's playback
+ * time (VLC still plays the audio, and keeps the clock), going through the same callbacks VLC would have called.
+ * Polls at twice the proxy's frame rate, and only draws when the frame has actually changed.
+ */
+static void play_proxy_frames(const ProxyCache *proxy, AppContext *app_context, libvlc_media_player_t *media_player,
+                              const std::atomic<bool> *started, const std::atomic<bool> *stopping) {
+    const std::chrono::duration<double, std::milli> poll_interval(500.0 / proxy->fps);
+    size_t shown = SIZE_MAX;
+    while (!*stopping) {
+        std::this_thread::sleep_for(poll_interval);
+        if (!*started) {
+            continue;
+        }
+        const auto index = proxy_frame_index(proxy, (double) libvlc_media_player_get_time(media_player));
+        if (index == shown) {
+            continue;
+        }
+        void *pixels = nullptr;
+        lock(app_context, &pixels);
+        if (pixels != nullptr) {
+            memcpy(pixels, proxy_frame(proxy, index), proxy->frame_size);
+        }
+        unlock(app_context, nullptr, &pixels);
+        display(app_context, nullptr);
+        shown = index;
+    }
 }
 
-void create_juror_intervals(void *data) {
-    auto *app_context = (AppContext *) data;
+/**
+ * Restarts VLC's video output, decoding to a texture `divisor` times smaller than decode_width x decode_height (scaled
+ * up to the window like any other frame), and picks up playback where it left off. There's a brief hitch while the
+ * decoder restarts, so the quality governor only asks for this when frames are already struggling. The video falls
+ * behind the wall clock by the length of that hitch, so this is only done when captions follow the video's clock.
+ */
+static void set_decode_scale(VLC_Manager *vlc_manager, AppContext *app_context, int decode_width, int decode_height,
+                             int divisor) {
+    const auto time = libvlc_media_player_get_time(vlc_manager->mp);
+    // Stopping waits for VLC's video thread to finish its frame, so nothing is using the texture after this.
+    libvlc_media_player_stop(vlc_manager->mp);
+    const int width = decode_width / divisor;
+    const int height = decode_height / divisor;
+    SDL_DestroyTexture(app_context->texture);
+    app_context->texture = SDL_CreateTexture(app_context->renderer,
+                                             SDL_PIXELFORMAT_BGR565,
+                                             SDL_TEXTUREACCESS_STREAMING,
+                                             width,
+                                             height);
+    if (app_context->texture == nullptr) {
+        fprintf(stderr, "Couldn't create texture: %s\n", SDL_GetError());
+    }
+    libvlc_video_set_format(vlc_manager->mp, "RV16", width, height, width * 2);
+    // A seek straight after play() is dropped if the input hasn't opened yet, so the media is told where to start
+    // instead. A later option of the same name overrides this one.
+    auto *media = libvlc_media_player_get_media(vlc_manager->mp);
+    const std::string start_time = ":start-time=" + std::to_string((double) time / 1000);
+    libvlc_media_add_option(media, start_time.c_str());
+    libvlc_media_release(media);
+    libvlc_media_player_play(vlc_manager->mp);
+    std::cout << "Decoding at " << width << "x" << height << std::endl;
+}
 
-    const auto juror_a_l = app_context->juror_positions.at(cog::Juror_JurorA).first * app_context->window_width;
-    const auto juror_a_r = juror_a_l + 300.f;
-    const auto juror_b_l = app_context->juror_positions.at(cog::Juror_JurorB).first * app_context->window_width;
-    const auto juror_b_r = juror_b_l + 350.f;
-    const auto juror_c_l = app_context->juror_positions.at(cog::Juror_JurorC).first * app_context->window_width;
-    const auto juror_c_r = juror_c_l + 600.f;
-    const auto jury_foreman_l = app_context->juror_positions.at(cog::Juror_JuryForeman).first * app_context->window_width;
-    const auto jury_foreman_r = jury_foreman_l + 600.f;
-    const std::map<cog::Juror, std::pair<double, double>> juror_intervals{
-            {cog::Juror_JurorA,      {juror_a_l,      juror_a_r}},
-            {cog::Juror_JurorB,      {juror_b_l,      juror_b_r}},
-            {cog::Juror_JurorC,      {juror_c_l,      juror_c_r}},
-            {cog::Juror_JuryForeman, {jury_foreman_l, jury_foreman_r}}
-    };
-    app_context->juror_intervals = juror_intervals;
+/**
+ * Called by VLC (on one of its own threads) when the video section finishes playing.
+ */
+static void playback_ended([[maybe_unused]] const libvlc_event_t *event, [[maybe_unused]] void *data) {
+    post_app_event(PLAYBACK_ENDED);
 }
 
-void create_juror_positions(void *data) {
+void create_fonts(SpeakerRegistry *speakers, void *data)
+{
     auto *app_context = (AppContext *) data;
-    // Hard-coded positions of where captions should be rendered on the video.
-    std::map<cog::Juror, std::pair<double, double>> juror_positions{
-            {cog::Juror_JurorA,      {1050.f / 1920.f, 550.f / 1080.f}},
-            {cog::Juror_JurorB,      {675.f / 1920.f,  550.f / 1080.f}},
-            {cog::Juror_JurorC,      {197.f / 1920.f,  650.f / 1080.f}},
-            {cog::Juror_JuryForeman, {1250.f / 1920.f, 600.f / 1080.f}}
-    };
-    app_context->juror_positions = juror_positions;
+    // Every size comes from the same distance fields, so this only touches FreeType the first time a font is used.
+    load_speaker_fonts(speakers, app_context->path_to_font);
 }
 
 SDL_Surface* load_surface(const std::string& path)
@@ -206,8 +309,14 @@ void initialize_SDL()
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
     }
-    // And initialize SDL_ttf, which will render text on our video frames.
+}
 
+/**
+ * Initializes SDL_ttf (for generating glyph atlases) and SDL_image. Neither needs SDL's video subsystem, so fonts and
+ * images can start loading while that's still initializing.
+ */
+void initialize_SDL_libraries()
+{
     if (TTF_Init() == -1) {
         printf("[ERROR] TTF_Init() Failed with: %s\n", TTF_GetError());
         exit(2);
@@ -266,6 +375,23 @@ void add_VLC_media(void *vlcm, void *data)
                             app_context->window_width * 2);
 }
 
+/**
+ * Stops playback and releases the player and libvlc. Stopping waits for VLC's video output thread, so none of the
+ * lock/unlock/display callbacks are left running against the renderer afterwards.
+ */
+void close_VLC(VLC_Manager *vlc_manager)
+{
+    if (vlc_manager->mp != nullptr) {
+        libvlc_media_player_stop(vlc_manager->mp);
+        libvlc_media_player_release(vlc_manager->mp);
+        vlc_manager->mp = nullptr;
+    }
+    if (vlc_manager->libvlc != nullptr) {
+        libvlc_release(vlc_manager->libvlc);
+        vlc_manager->libvlc = nullptr;
+    }
+}
+
 void create_window(void *data)
 {
     auto *app_context = (AppContext *) data;
@@ -292,29 +418,19 @@ std::tuple<int, sockaddr_in> connect_to_glass(int presentation_method)
     return connect_to_client(PORT);
 }
 
-std::tuple<AppContext,SDL_Color, SDL_Color> create_context(int argc, char * *argv)
+std::tuple<AppContext, ExperimentOptions> create_context(int argc, char * *argv)
 {
     struct AppContext app_context{};
     // Get command-line arguments, which will be used for configuring how captions are rendered.
-    const auto
-    [
-    video_section, // Which video section will we be rendering?
-    presentation_method, // How will we be presenting captions?
-    half_fov, // What is the user's half field of view?
-    foreground_color, // What color will the text be? RGBA format
-    background_color, // What color will the background behind the text be? RGBA format
-    path_to_font // Where's the// smallest_font located?
-    ] = parse_arguments(argc, argv);
-    app_context.presentation_method = presentation_method;
-    app_context.half_fov = half_fov;
+    const auto options = parse_arguments(argc, argv);
+    set_presentation_method(&app_context, options.presentation_method);
+    app_context.half_fov = options.half_fov;
     app_context.window_width = SCREEN_PIXEL_WIDTH;
     app_context.window_height = SCREEN_PIXEL_HEIGHT;
-    app_context.video_section = video_section;
+    app_context.video_section = options.video_section;
     app_context.y = app_context.window_height * 0.6; // For non-registered captions, render them at 75% of the window's height.
-    app_context.path_to_font = path_to_font;
-    create_juror_positions(&app_context);
-    create_juror_intervals(&app_context);
-    return std::make_tuple(app_context,foreground_color,background_color);
+    app_context.path_to_font = options.path_to_font;
+    return std::make_tuple(app_context, options);
 }
 
 void create_renderer(void *data)
@@ -367,65 +483,349 @@ void close_SDL(void *data)
     SDL_Quit();
 }
 
-int main(int argc, char *argv[]) {
-    auto [app_context, foreground_color, background_color] = create_context(argc, argv);
-    app_context.background_color = &background_color;
-    app_context.foreground_color = &foreground_color;
-    auto [
-    socket,
-    cliaddr
-    ] = connect_to_glass(app_context.presentation_method);
-
-    initialize_SDL();
-    create_fonts(&app_context);
-    create_window(&app_context);
-
-    create_renderer(&app_context);
-    create_texture(&app_context);
-    app_context.mutex = SDL_CreateMutex();
-
-    // Load the two indicator images that we'll use to point towards the next speaker.
-    app_context.back_arrow = load_surface("resources/images/arrow_back.png");
-    app_context.forward_arrow = load_surface("resources/images/arrow_forward.png");
-    app_context.calibration_background_left = load_surface("resources/images/calibration_background_left.png");
-    app_context.calibration_background_center = load_surface("resources/images/calibration_background_center.png");
-    app_context.calibration_background_right = load_surface("resources/images/calibration_background_right.png");
+/**
+ * Gets everything a render needs when no window is involved: SDL_ttf, SDL_image, fonts and arrows.
+ * Compositing happens on the CPU, straight into the decoded frames.
+ */
+void initialize_offline_rendering(SpeakerRegistry *speakers, AppContext *app_context)
+{
+    if (TTF_Init() == -1) {
+        printf("[ERROR] TTF_Init() Failed with: %s\n", TTF_GetError());
+        exit(2);
+    }
+    if ((IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG) != IMG_INIT_PNG) {
+        printf("IMG_Init: %s\n", IMG_GetError());
+    }
+    create_fonts(speakers, app_context);
+    app_context->back_arrow = load_surface("resources/images/arrow_back.png");
+    app_context->forward_arrow = load_surface("resources/images/arrow_forward.png");
+}
+
+void close_offline_rendering(SpeakerRegistry *speakers, AppContext *app_context)
+{
+    SDL_FreeSurface(app_context->back_arrow);
+    SDL_FreeSurface(app_context->forward_arrow);
+    close_speaker_fonts(speakers);
+    TTF_Quit();
+    IMG_Quit();
+}
+
+/**
+ * Lets a write to an ffmpeg that has exited fail with EPIPE, instead of SIGPIPE killing the process (and with it, every
+ * other job in a batch).
+ */
+static void ignore_broken_pipes()
+{
+    struct sigaction action{};
+    action.sa_handler = SIG_IGN;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPIPE, &action, nullptr);
+}
+
+/**
+ * Renders the selected section, presentation method and FOV straight to a video file instead of running a trial.
+ * Head orientation comes from --replay_orientation if given, otherwise from a synthetic sweep.
+ */
+int run_export(SpeakerRegistry *speakers, AppContext *app_context, const ExperimentOptions &options)
+{
+    ignore_broken_pipes();
+    initialize_offline_rendering(speakers, app_context);
+    const auto cues = load_caption_track(load_captions(app_context->video_section), speakers);
+    std::vector<OrientationRecord> orientation;
+    if (!options.replay_orientation_path.empty()) {
+        orientation = load_orientation_recording(options.replay_orientation_path);
+    } else {
+        std::cout << "No orientation recording given, using a synthetic head sweep." << std::endl;
+    }
+    const auto stats = export_captioned_video(app_context, &cues, &orientation, options.export_path,
+                                              options.export_fps);
+    close_offline_rendering(speakers, app_context);
+    return stats.succeeded ? 0 : EXIT_FAILURE;
+}
+
+/**
+ * Times the CPU caption blend kernels against SDL's blitter, using the first speaker's font and the colors given on
+ * the command line.
+ */
+int run_benchmark(SpeakerRegistry *speakers, AppContext *app_context, const ExperimentOptions &options)
+{
+    initialize_offline_rendering(speakers, app_context);
+    run_blend_benchmark(speaker_atlas(speakers, 0), &options.foreground_color, &options.background_color,
+                        options.blend_benchmark_iterations);
+    close_offline_rendering(speakers, app_context);
+    return 0;
+}
+
+/**
+ * Renders every job in the --batch file, several at a time.
+ */
+int run_batch(SpeakerRegistry *speakers, AppContext *app_context, const ExperimentOptions &options)
+{
+    ignore_broken_pipes();
+    initialize_offline_rendering(speakers, app_context);
+    int invalid_jobs = 0;
+    const auto jobs = load_render_jobs(options.batch_path, &invalid_jobs);
+    const int failed_jobs = run_batch_render(app_context, jobs, options.workers, options.export_fps);
+    close_offline_rendering(speakers, app_context);
+    if (invalid_jobs > 0) {
+        std::cerr << invalid_jobs << " jobs in " << options.batch_path << " were invalid and skipped." << std::endl;
+    }
+    return failed_jobs + invalid_jobs == 0 ? 0 : EXIT_FAILURE;
+}
 
+int main(int argc, char *argv[]) {
+    install_allocation_counter();
+    auto [app_context, options] = create_context(argc, argv);
+    // Before any trial thread starts, since each one configures itself as it does.
+    if (!options.thread_config_path.empty()) {
+        trial_thread_config = load_thread_config(options.thread_config_path);
+    }
+    app_context.background_color = &options.background_color;
+    app_context.foreground_color = &options.foreground_color;
+    // Who's in the video, where their captions go, and how they look.
+    SpeakerRegistry speakers = load_speaker_registry(options.scene_path, FONT_SIZE_MEDIUM, options.foreground_color);
+    app_context.speakers = &speakers;
+    if (options.blend_benchmark_iterations > 0) {
+        return run_benchmark(&speakers, &app_context, options);
+    }
+    if (!options.batch_path.empty()) {
+        return run_batch(&speakers, &app_context, options);
+    }
+    if (!options.export_path.empty()) {
+        return run_export(&speakers, &app_context, options);
+    }
+    // Most of startup doesn't depend on the rest of it, so it runs side by side instead of one step after another.
+    // Only SDL's video functions stay on this thread.
+    auto *context = &app_context;
+    const auto *trial_options = &options;
+    int socket = -1;
+    CaptionOverlay caption_overlay{};
     VLC_Manager vlc_manager{};
-    initialize_VLC(&vlc_manager);
-    add_VLC_media(&vlc_manager,
-                  &app_context);
-    libvlc_video_set_callbacks(vlc_manager.mp,
-                               lock,
-                               unlock,
-                               display,
-                               &app_context);
+    std::vector<CaptionCue> cues;
+    std::vector<CaptionCue> simulated_cues;
+    std::unique_ptr<CaptionSource> caption_source;
+    std::vector<OrientationRecord> orientation_recording;
+    ProxyCache proxy{};
+    bool proxy_loaded = false;
+
+    StartupGraph startup{};
+    add_startup_step(&startup, "connection QR code", [context, &socket] {
+        std::tie(socket, std::ignore) = connect_to_glass(context->presentation_method);
+    });
+    if (!options.replay_orientation_path.empty()) {
+        add_startup_step(&startup, "orientation recording", [trial_options, &orientation_recording] {
+            orientation_recording = load_orientation_recording(trial_options->replay_orientation_path);
+        });
+    }
+    const auto sdl_libraries = add_startup_step(&startup, "SDL_ttf and SDL_image", initialize_SDL_libraries);
+    const auto sdl = add_startup_step(&startup, "SDL video", [] {
+        initialize_SDL();
+        register_app_events();
+    }, {}, true);
+    add_startup_step(&startup, "window and renderer", [context, &caption_overlay] {
+        create_window(context);
+        create_renderer(context);
+        create_texture(context);
+        create_caption_overlay(&caption_overlay, context->renderer, context->window_width, context->window_height);
+        context->caption_overlay = &caption_overlay;
+        context->mutex = SDL_CreateMutex();
+    }, {sdl}, true);
+    const auto fonts = add_startup_step(&startup, "fonts", [context, &speakers] {
+        create_fonts(&speakers, context);
+    }, {sdl_libraries});
+    // The two indicator images that we'll use to point towards the next speaker, and the calibration backgrounds.
+    const std::vector<std::pair<SDL_Surface **, std::string>> images{
+            {&app_context.back_arrow,                    "resources/images/arrow_back.png"},
+            {&app_context.forward_arrow,                 "resources/images/arrow_forward.png"},
+            {&app_context.calibration_background_left,   "resources/images/calibration_background_left.png"},
+            {&app_context.calibration_background_center, "resources/images/calibration_background_center.png"},
+            {&app_context.calibration_background_right,  "resources/images/calibration_background_right.png"},
+    };
+    for (const auto &image: images) {
+        add_startup_step(&startup, image.second, [image] {
+            *image.first = load_surface(image.second);
+        }, {sdl_libraries});
+    }
+    if (options.proxy_height > 0) {
+        // Only slow the first time a section is played at this size; after that it's just a mapping.
+        add_startup_step(&startup, "proxy", [context, trial_options, &proxy, &proxy_loaded] {
+            // Same aspect ratio as the window, rounded to an even width as the decoder's scaler wants.
+            const int proxy_height = trial_options->proxy_height;
+            const int proxy_width = proxy_height * context->window_width / context->window_height / 2 * 2;
+            proxy_loaded = load_proxy_cache(context->video_section, proxy_width, proxy_height, &proxy);
+        });
+    }
+    // libvlc_new scans every plugin, which is usually the slowest step of all.
+    add_startup_step(&startup, "VLC", [context, &vlc_manager] {
+        initialize_VLC(&vlc_manager);
+        add_VLC_media(&vlc_manager, context);
+    });
+    size_t captions;
+    if (options.stream_captions) {
+        // Only a bounded window of the track is ever in memory, so there's nothing to lay out ahead of time; captions
+        // are laid out as they're drawn instead. The source starts reading ahead straight away.
+        captions = add_startup_step(&startup, "caption stream", [context, &speakers, &caption_source] {
+            caption_source = std::make_unique<CaptionSource>(caption_track_path(context->video_section), &speakers);
+        });
+    } else if (options.ingest_port > 0) {
+        // Live captions aren't known ahead of time either, so they're laid out as they're drawn too. The track is only
+        // needed to stand in for the recognizer.
+        captions = add_startup_step(&startup, "simulated recognizer", [context, trial_options, &speakers,
+                &simulated_cues] {
+            if (trial_options->simulate_asr) {
+                simulated_cues = load_caption_track(load_captions(context->video_section), &speakers);
+            }
+        });
+    } else {
+        captions = add_startup_step(&startup, "captions", [context, &speakers, &cues] {
+            cues = load_caption_track(load_captions(context->video_section), &speakers);
+        });
+    }
+    // When the whole caption track is known ahead of time, lay every caption out now rather than on every frame.
+    // The render thread picks this up on its first frame. After that, the main loop only ever publishes new snapshots.
+    add_startup_step(&startup, "caption layout", [context, &speakers, &cues] {
+        publish_render_config(context, create_render_config(cues, &speakers, context->window_width,
+                                                            context->window_height, context->y, 1.0));
+    }, {fonts, captions});
+    run_startup_graph(&startup, STARTUP_WORKERS);
+    print_startup_timings(&startup);
+
+    if (proxy_loaded) {
+        // Frames come from the proxy, so VLC only has to play the audio and keep time. The video texture is the
+        // proxy's size, and scaled up to the window like VLC's frames are.
+        auto *media = libvlc_media_player_get_media(vlc_manager.mp);
+        libvlc_media_add_option(media, ":no-video");
+        libvlc_media_release(media);
+        SDL_DestroyTexture(app_context.texture);
+        app_context.texture = SDL_CreateTexture(app_context.renderer,
+                                                SDL_PIXELFORMAT_BGR565,
+                                                SDL_TEXTUREACCESS_STREAMING,
+                                                proxy.width,
+                                                proxy.height);
+        if (app_context.texture == nullptr) {
+            fprintf(stderr, "Couldn't create proxy texture: %s\n", SDL_GetError());
+        }
+    } else {
+        if (options.proxy_height > 0) {
+            std::cerr << "No proxy available, VLC will decode the video instead." << std::endl;
+        }
+        libvlc_video_set_callbacks(vlc_manager.mp,
+                                   lock,
+                                   unlock,
+                                   display,
+                                   &app_context);
+    }
+    libvlc_event_attach(libvlc_media_player_event_manager(vlc_manager.mp),
+                        libvlc_MediaPlayerEndReached,
+                        playback_ended,
+                        nullptr);
 
     std::mutex azimuth_mutex;
     app_context.azimuth_mutex = &azimuth_mutex;
     std::deque<float> azimuth_buffer{};
     app_context.azimuth_buffer = &azimuth_buffer;
-    std::thread read_orientation_thread(read_orientation,
-                                        socket,
-                                        &cliaddr,
-                                        &azimuth_mutex,
-                                        &azimuth_buffer);
 
-    std::ostringstream os;
-    nlohmann::json json;
-    os.str("");
-    os.clear();
-    os << "resources/captions/merged_captions." << app_context.video_section << ".json";
-    std::string captions_path = os.str();
-    std::cout << "Captions path = " << captions_path << std::endl;
-    std::ifstream captions_file(captions_path.c_str());
-    captions_file >> json;
+    // Every pair of glasses that connects gets captions (if it's presenting them itself) and its own orientation
+    // stream; the first one to connect drives what's drawn on screen.
+    CaptionServer caption_server(socket, app_context.presentation_method, app_context.half_fov,
+                                 options.coalesce_ms);
+    // Every view shows the same caption text, so it's only rasterized once per revision, however many views there are.
+    CaptionTextureCache caption_textures{};
+    app_context.caption_textures = &caption_textures;
+    // Caption temporaries for a frame come from here, and are all released at once after it's presented.
+    FrameArena frame_arena;
+    app_context.frame_arena = &frame_arena;
+    // A proxy is already decoded small, so there's no resolution to lower. Restarting the decoder pauses the video
+    // briefly, which captions revealed on a thread of their own wouldn't wait for, so they'd drift ahead of it by that
+    // much every time; only captions that follow the video's clock stay in step.
+    QualityGovernor quality_governor(!proxy_loaded && options.media_clock);
+    if (options.governor) {
+        app_context.quality_governor = &quality_governor;
+    }
+    const int decode_width = app_context.window_width;
+    const int decode_height = app_context.window_height;
+    // The scene's font sizes are for the window the trial starts with; they scale with its height after a resize.
+    const int initial_window_height = app_context.window_height;
+    int decode_divisor = 1;
+    ViewportSet viewport_set{&caption_server, {}};
+    if (options.viewports) {
+        app_context.viewports = &viewport_set;
+    }
+    // Captions can follow the video's own clock instead of a thread of their own, so they stay in step with it
+    // through pauses and seeks.
+    CaptionTimeline caption_timeline{};
+    app_context.media_player = vlc_manager.mp;
+    if (options.media_clock) {
+        caption_timeline = build_caption_timeline(&cues, &caption_server, &speakers);
+        app_context.caption_timeline = &caption_timeline;
+    }
+    // Frame, orientation and caption timings are always collected; they're only served if there's somewhere to serve
+    // them.
+    int metrics_socket = -1;
+    std::thread metrics_thread;
+    if (!options.metrics_socket_path.empty()) {
+        metrics_socket = open_metrics_socket(options.metrics_socket_path);
+        metrics_thread = start_trial_thread(METRICS_THREAD, serve_metrics, metrics_socket, &trial_metrics,
+                                            &caption_server);
+    }
+    // Frames are published at the size they're presented, up to the size of the window as it is now.
+    FrameRing frame_ring{};
+    if (!options.frame_ring_name.empty()) {
+        int output_width = 0;
+        int output_height = 0;
+        SDL_GetRendererOutputSize(app_context.renderer, &output_width, &output_height);
+        if (open_frame_ring(options.frame_ring_name, output_width, output_height, options.frame_ring_interval,
+                            &frame_ring)) {
+            app_context.frame_ring = &frame_ring;
+        }
+    }
+
+    // Either listen to the HWDs for orientation (optionally recording it so the session can be re-rendered later), or
+    // feed a previously recorded session back through the same filter.
+    std::atomic<bool> started{false};
+    std::atomic<bool> stopping{false};
+    std::unique_ptr<OrientationRecorder> orientation_recorder;
+    std::thread read_orientation_thread;
+    if (!options.replay_orientation_path.empty()) {
+        read_orientation_thread = start_trial_thread(ORIENTATION_THREAD,
+                                                     replay_orientation,
+                                                     &orientation_recording,
+                                                     options.replay_speed,
+                                                     &started,
+                                                     &stopping,
+                                                     &azimuth_mutex,
+                                                     &azimuth_buffer);
+    } else {
+        if (!options.record_orientation_path.empty()) {
+            orientation_recorder = std::make_unique<OrientationRecorder>(options.record_orientation_path);
+        }
+        read_orientation_thread = start_trial_thread(ORIENTATION_THREAD,
+                                                     serve_clients,
+                                                     socket,
+                                                     &caption_server,
+                                                     &azimuth_mutex,
+                                                     &azimuth_buffer,
+                                                     &stopping,
+                                                     orientation_recorder.get());
+    }
+
     auto caption_model = CaptionModel();
     app_context.caption_model = &caption_model;
+    int ingest_socket = -1;
+    std::thread ingest_thread;
+    std::thread simulator_thread;
+    if (options.ingest_port > 0) {
+        ingest_socket = open_caption_ingest_socket(options.ingest_port);
+        ingest_thread = start_trial_thread(INGEST_THREAD, serve_caption_ingest, ingest_socket, &caption_model,
+                                           &caption_server, &speakers, &stopping);
+        if (options.simulate_asr) {
+            simulator_thread = start_trial_thread(SIMULATOR_THREAD, simulate_asr, options.ingest_port, &started,
+                                                  &stopping, &simulated_cues, &speakers);
+        }
+    }
 
     // Wait for data to start getting transmitted from the phone
     // before we start playing our video on VLC and rendering captions.
-    bool started = false;
     bool calibration_initiated = false;
     bool calibration_right = false;
     bool calibration_center = false;
@@ -434,35 +834,90 @@ int main(int argc, char *argv[]) {
     bool done = false;
     int action = 0;
     // Main loop.
-    std::thread play_captions_thread(start_caption_stream,
-                                     &started,
-                                     socket,
-                                     &cliaddr,
-                                     &json,
-                                     &caption_model,
-                                     app_context.presentation_method);
+    std::thread play_captions_thread;
+    if (caption_source) {
+        play_captions_thread = start_trial_thread(CAPTION_THREAD,
+                                                  stream_caption_track,
+                                                  &started,
+                                                  &stopping,
+                                                  &caption_server,
+                                                  caption_source.get(),
+                                                  &caption_model,
+                                                  &speakers);
+    } else if (!options.media_clock && options.ingest_port <= 0) {
+        play_captions_thread = start_trial_thread(CAPTION_THREAD,
+                                                  start_caption_stream,
+                                                  &started,
+                                                  &stopping,
+                                                  &caption_server,
+                                                  &cues,
+                                                  &caption_model,
+                                                  &speakers);
+    }
+
+    std::thread proxy_thread;
+    if (proxy_loaded) {
+        set_expected_frame_rate(&trial_metrics, proxy.fps);
+        proxy_thread = start_trial_thread(RENDER_THREAD, play_proxy_frames, &proxy, &app_context, vlc_manager.mp,
+                                          &started, &stopping);
+    }
 
     SDL_RenderPresent(app_context.renderer);
 
     while (!done) {
+        // Sleep until there's input, a resize, or news from one of the other threads.
+        if (!SDL_WaitEventTimeout(&event, EVENT_WAIT_TIMEOUT_MS)) {
+            continue;
+        }
         action = 0;
-        while (SDL_PollEvent(&event)) {
-            switch (event.type) {
-                case SDL_QUIT:
-                    done = true;
-                    break;
-                case SDL_KEYDOWN:
-                    action = event.key.keysym.sym;
-                    break;
-                case SDL_WINDOWEVENT:
-                    if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-                        SDL_RenderSetViewport(app_context.renderer, nullptr);
-                        app_context.display_rect.w = app_context.window_width = event.window.data1;
-                        app_context.display_rect.h = app_context.window_height = event.window.data2;
-                        app_context.y = app_context.window_height * 0.75;
+        switch (event.type) {
+            case SDL_QUIT:
+                done = true;
+                break;
+            case SDL_KEYDOWN:
+                action = event.key.keysym.sym;
+                break;
+            case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
+                    // Scale the fonts and lay the captions out for the new size here, off the render thread, and
+                    // hand the result over in one go.
+                    publish_render_config(&app_context, create_render_config(cues, &speakers,
+                                                                             event.window.data1,
+                                                                             event.window.data2,
+                                                                             event.window.data2 * 0.75,
+                                                                             (double) event.window.data2 /
+                                                                             initial_window_height));
+                }
+                break;
+            default:
+                switch (app_event_code(&event)) {
+                    case PLAYBACK_ENDED:
+                        std::cout << "Playback finished." << std::endl;
+                        done = true;
+                        break;
+                    case CAPTIONS_FINISHED:
+                        std::cout << "Every caption has been revealed." << std::endl;
+                        caption_server.print_client_stats();
+                        break;
+                    case ORIENTATION_LOST:
+                        std::cerr << "Lost the orientation stream from the HWD." << std::endl;
+                        break;
+                    case QUALITY_CHANGED: {
+                        const int quality_level = quality_governor.quality_level();
+                        if (orientation_recorder) {
+                            orientation_recorder->mark_quality_changed(quality_level);
+                        }
+                        const int divisor = quality_level >= REDUCED_RESOLUTION ? DECODE_SCALE_DIVISOR : 1;
+                        if (!proxy_loaded && divisor != decode_divisor) {
+                            set_decode_scale(&vlc_manager, &app_context, decode_width, decode_height, divisor);
+                            decode_divisor = divisor;
+                        }
+                        break;
                     }
-                    break;
-            }
+                    default:
+                        break;
+                }
+                break;
         }
 
         switch (action) {
@@ -525,6 +980,9 @@ int main(int argc, char *argv[]) {
                 }
                 else if (!started)
                 {
+                    if (orientation_recorder) {
+                        orientation_recorder->mark_playback_started();
+                    }
                     started = true;
                     libvlc_media_player_play(vlc_manager.mp);
                 }
@@ -532,8 +990,49 @@ int main(int argc, char *argv[]) {
             default:
                 break;
         }
-        SDL_Delay(1000 / 10);
     }
+    // Every trial thread is stopped and joined before anything it uses is torn down. VLC goes first, since its video
+    // output thread draws with the renderer; the proxy player asks it for the time, so that's joined before it.
+    stopping = true;
+    if (proxy_thread.joinable()) {
+        proxy_thread.join();
+    }
+    close_VLC(&vlc_manager);
+    app_context.media_player = nullptr;
+    // Wake the threads blocked on a socket or on the caption source; the rest notice stopping within STOP_POLL.
+    if (socket >= 0) {
+        shutdown(socket, SHUT_RD);
+    }
+    if (caption_source) {
+        caption_source->close();
+    }
+    if (read_orientation_thread.joinable()) {
+        read_orientation_thread.join();
+    }
+    if (play_captions_thread.joinable()) {
+        play_captions_thread.join();
+    }
+    if (simulator_thread.joinable()) {
+        simulator_thread.join();
+    }
+    if (ingest_socket >= 0) {
+        close_caption_ingest_socket(ingest_socket, &ingest_thread);
+    }
+    if (orientation_recorder) {
+        orientation_recorder->close();
+    }
+    caption_server.print_client_stats();
+    frame_arena.print_stats();
+    print_thread_report();
+    if (metrics_socket >= 0) {
+        close_metrics_socket(metrics_socket, options.metrics_socket_path, &metrics_thread);
+    }
+    close_proxy_cache(&proxy);
+    close_frame_ring(&frame_ring);
+    close_speaker_fonts(&speakers);
+    destroy_caption_overlay(&caption_overlay);
+    destroy_viewports(&viewport_set);
+    destroy_caption_texture_cache(&caption_textures);
     close_SDL(&app_context);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,284 @@
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "metrics.hpp"
+#include "caption_server.hpp"
+#include "orientation.hpp"
+
+#define REQUEST_WAIT_MS 100 // How long a connection gets to send a request before it's just sent the snapshot
+
+Metrics trial_metrics;
+
+int64_t metrics_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void count(Counter *counter, uint64_t amount) {
+    counter->value.fetch_add(amount, std::memory_order_relaxed);
+}
+
+void observe(Histogram *histogram, double value_ms) {
+    size_t bucket = 0;
+    while (bucket < HISTOGRAM_BOUNDS_MS.size() && value_ms > HISTOGRAM_BOUNDS_MS[bucket]) {
+        bucket++;
+    }
+    histogram->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram->sum_us.fetch_add((uint64_t) std::llround(std::max(value_ms, 0.0) * 1000), std::memory_order_relaxed);
+}
+
+void set_expected_frame_rate(Metrics *metrics, double fps) {
+    if (fps > 0) {
+        metrics->frame_period_us.store((int64_t) (1000000 / fps), std::memory_order_relaxed);
+    }
+}
+
+void record_frame_started(Metrics *metrics) {
+    metrics->frame_started_us.store(metrics_clock_us(), std::memory_order_relaxed);
+}
+
+void record_frame_presented(Metrics *metrics) {
+    const auto now = metrics_clock_us();
+    count(&metrics->frames);
+    observe(&metrics->frame_render_ms,
+            (double) (now - metrics->frame_started_us.load(std::memory_order_relaxed)) / 1000);
+    const auto previous = metrics->frame_presented_us.exchange(now, std::memory_order_relaxed);
+    if (previous == 0) {
+        return;
+    }
+    const auto interval_us = now - previous;
+    observe(&metrics->frame_interval_ms, (double) interval_us / 1000);
+    const auto period_us = metrics->frame_period_us.load(std::memory_order_relaxed);
+    if (period_us > 0 && (double) interval_us > DROPPED_FRAME_FACTOR * (double) period_us) {
+        count(&metrics->frames_dropped, (uint64_t) std::llround((double) interval_us / (double) period_us) - 1);
+    }
+}
+
+void record_frame_skipped(Metrics *metrics) {
+    count(&metrics->frames_skipped);
+    metrics->frame_presented_us.store(metrics_clock_us(), std::memory_order_relaxed);
+}
+
+void record_orientation_sample(Metrics *metrics) {
+    const auto now = metrics_clock_us();
+    count(&metrics->orientation_packets);
+    const auto previous = metrics->orientation_received_us.exchange(now, std::memory_order_relaxed);
+    if (previous == 0) {
+        return;
+    }
+    const double interval_ms = (double) (now - previous) / 1000;
+    observe(&metrics->orientation_interval_ms, interval_ms);
+    observe(&metrics->filter_lag_ms, (MOVING_AVG_SIZE - 1) / 2.0 * interval_ms);
+}
+
+void record_caption_revealed(Metrics *metrics, double lateness_ms) {
+    count(&metrics->captions_revealed);
+    observe(&metrics->caption_lateness_ms, lateness_ms);
+}
+
+void record_caption_arrived(Metrics *metrics, int64_t arrived_us) {
+    // Only the oldest caption not yet on screen is timed; anything that arrives after it is on screen no later.
+    int64_t none = 0;
+    metrics->caption_undisplayed_since_us.compare_exchange_strong(none, arrived_us, std::memory_order_relaxed);
+}
+
+int64_t undisplayed_caption_since(const Metrics *metrics) {
+    return metrics->caption_undisplayed_since_us.load(std::memory_order_relaxed);
+}
+
+void record_captions_displayed(Metrics *metrics, int64_t undisplayed_since_us) {
+    if (undisplayed_since_us == 0) {
+        return;
+    }
+    // Only cleared if it's still the caption the frame started with. A caption that arrives while the frame is being
+    // drawn (behind the one being timed) is taken to be in it, so latency can be under-measured by up to a frame.
+    if (metrics->caption_undisplayed_since_us.compare_exchange_strong(undisplayed_since_us, 0,
+                                                                      std::memory_order_relaxed)) {
+        observe(&metrics->caption_display_latency_ms, (double) (metrics_clock_us() - undisplayed_since_us) / 1000);
+    }
+}
+
+static void write_counter(std::ostream &out, const char *name, const char *help, const Counter &counter) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " counter\n"
+        << name << " " << counter.value.load(std::memory_order_relaxed) << "\n";
+}
+
+static void write_gauge(std::ostream &out, const char *name, const char *help, const std::atomic<int64_t> &gauge) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " gauge\n"
+        << name << " " << gauge.load(std::memory_order_relaxed) << "\n";
+}
+
+static void write_histogram(std::ostream &out, const char *name, const char *help, const Histogram &histogram) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " histogram\n";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < HISTOGRAM_BOUNDS_MS.size(); i++) {
+        cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{le=\"" << HISTOGRAM_BOUNDS_MS[i] << "\"} " << cumulative << "\n";
+    }
+    cumulative += histogram.buckets.back().load(std::memory_order_relaxed);
+    // The count is the buckets added up (rather than kept separately), so +Inf always agrees with it.
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n"
+        << name << "_sum " << (double) histogram.sum_us.load(std::memory_order_relaxed) / 1000 << "\n"
+        << name << "_count " << cumulative << "\n";
+}
+
+static void write_client_gauge(std::ostream &out, const char *name, const char *help,
+                               const std::vector<CaptionClientStats> &stats,
+                               double (*value)(const CaptionClientStats &)) {
+    out << "# HELP " << name << " " << help << "\n"
+        << "# TYPE " << name << " gauge\n";
+    for (const auto &client: stats) {
+        out << name << "{client=\"" << address_string(client.address) << "\"} " << value(client) << "\n";
+    }
+}
+
+std::string format_metrics(const Metrics *metrics, CaptionServer *server) {
+    std::ostringstream out;
+    write_counter(out, "cog_frames_total", "Frames presented.", metrics->frames);
+    write_counter(out, "cog_frames_dropped_total", "Frames estimated to have been dropped, from gaps between frames.",
+                  metrics->frames_dropped);
+    write_histogram(out, "cog_frame_interval_ms", "Time between frames being presented.", metrics->frame_interval_ms);
+    write_histogram(out, "cog_frame_render_ms", "Time from VLC locking a frame to it being presented.",
+                    metrics->frame_render_ms);
+    write_counter(out, "cog_frames_skipped_total", "Frames the quality governor chose not to draw.",
+                  metrics->frames_skipped);
+    write_counter(out, "cog_frames_exported_total", "Frames published to the shared-memory frame ring.",
+                  metrics->frames_exported);
+    write_histogram(out, "cog_frame_export_ms", "Time to read a frame back into the frame ring.",
+                    metrics->frame_export_ms);
+    write_counter(out, "cog_orientation_packets_total", "Orientation samples from the primary client.",
+                  metrics->orientation_packets);
+    write_counter(out, "cog_orientation_rejected_total",
+                  "Orientation packets that were malformed, or from new clients once the server was full.",
+                  metrics->orientation_rejected);
+    write_histogram(out, "cog_orientation_interval_ms", "Time between orientation samples.",
+                    metrics->orientation_interval_ms);
+    write_histogram(out, "cog_filter_lag_ms", "Delay of the moving average over head orientation.",
+                    metrics->filter_lag_ms);
+    write_counter(out, "cog_captions_revealed_total", "Captions revealed on screen.", metrics->captions_revealed);
+    write_histogram(out, "cog_caption_lateness_ms", "How long after its scheduled time each caption was revealed.",
+                    metrics->caption_lateness_ms);
+    write_counter(out, "cog_captions_transmitted_total", "Captions encoded and queued for the HWDs.",
+                  metrics->captions_transmitted);
+    write_histogram(out, "cog_transmit_ms", "Time to encode a caption and queue it for every client.",
+                    metrics->transmit_ms);
+    write_counter(out, "cog_captions_ingested_total", "Live captions received and shown.", metrics->captions_ingested);
+    write_counter(out, "cog_captions_replaced_total", "Live captions that replaced a partial hypothesis.",
+                  metrics->captions_replaced);
+    write_counter(out, "cog_captions_stale_total", "Live captions dropped because their caption was gone.",
+                  metrics->captions_stale);
+    write_counter(out, "cog_captions_rejected_total", "Live captions that were malformed or from an unknown speaker.",
+                  metrics->captions_rejected);
+    write_histogram(out, "cog_caption_display_latency_ms", "Time from a live caption arriving to it being on screen.",
+                    metrics->caption_display_latency_ms);
+    write_gauge(out, "cog_quality_level", "How many steps the quality governor has degraded (0 is full quality).",
+                metrics->quality_level);
+    write_counter(out, "cog_quality_changes_total", "Times the quality governor changed the quality level.",
+                  metrics->quality_changes);
+    if (server != nullptr) {
+        // Taken under the server's lock, but only when a snapshot is asked for.
+        const auto stats = server->client_stats();
+        write_client_gauge(out, "cog_client_orientation_packets", "Orientation packets from each client.", stats,
+                           [](const CaptionClientStats &client) { return (double) client.orientation_packets; });
+        write_client_gauge(out, "cog_client_captions_sent", "Captions sent to each client.", stats,
+                           [](const CaptionClientStats &client) { return (double) client.captions_sent; });
+        write_client_gauge(out, "cog_client_captions_dropped", "Captions dropped from each client's full queue.",
+                           stats, [](const CaptionClientStats &client) { return (double) client.captions_dropped; });
+        write_client_gauge(out, "cog_client_send_failures", "Datagrams that failed to send to each client.", stats,
+                           [](const CaptionClientStats &client) { return (double) client.send_failures; });
+        write_client_gauge(out, "cog_client_retransmissions", "Captions resent to each client after a NACK.", stats,
+                           [](const CaptionClientStats &client) { return (double) client.retransmissions; });
+        write_client_gauge(out, "cog_client_queue_depth", "Captions waiting to be sent to each client.", stats,
+                           [](const CaptionClientStats &client) { return (double) client.queue_depth; });
+        write_client_gauge(out, "cog_client_send_latency_mean_us",
+                           "Mean time from a caption being queued to it being sent, per client.", stats,
+                           [](const CaptionClientStats &client) { return client.mean_latency_us; });
+    }
+    return out.str();
+}
+
+int open_metrics_socket(const std::string &path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Metrics socket path is too long: " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    const int metrics_socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (metrics_socket < 0) {
+        std::cerr << "Couldn't create metrics socket: " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    unlink(path.c_str());
+    if (bind(metrics_socket, (sockaddr *) &address, sizeof(address)) < 0 || listen(metrics_socket, 4) < 0) {
+        std::cerr << "Couldn't listen on " << path << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "Serving metrics on " << path << std::endl;
+    return metrics_socket;
+}
+
+static void write_all(int connection, const std::string &data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const auto result = send(connection, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // The reader went away, which is its business
+        }
+        written += result;
+    }
+}
+
+void serve_metrics(int socket, const Metrics *metrics, CaptionServer *server) {
+    while (true) {
+        const int connection = accept(socket, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // EINVAL is close_metrics_socket shutting us down.
+            if (errno != EINVAL) {
+                std::cerr << "Metrics socket failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        pollfd request{connection, POLLIN, 0};
+        bool http = false;
+        if (poll(&request, 1, REQUEST_WAIT_MS) > 0) {
+            char buffer[512];
+            const auto size = recv(connection, buffer, sizeof(buffer), 0);
+            http = size >= 4 && strncmp(buffer, "GET ", 4) == 0;
+        }
+        const auto body = format_metrics(metrics, server);
+        if (http) {
+            write_all(connection, "HTTP/1.0 200 OK\r\n"
+                                  "Content-Type: text/plain; version=0.0.4\r\n"
+                                  "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n");
+        }
+        write_all(connection, body);
+        close(connection);
+    }
+}
+
+void close_metrics_socket(int socket, const std::string &path, std::thread *metrics_thread) {
+    // Wakes serve_metrics out of accept, so it's finished with the socket before it's closed.
+    shutdown(socket, SHUT_RDWR);
+    if (metrics_thread->joinable()) {
+        metrics_thread->join();
+    }
+    close(socket);
+    unlink(path.c_str());
+}
@@ -0,0 +1,239 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include "offline_export.hpp"
+#include "ffmpeg_process.hpp"
+#include "frame_queue.hpp"
+#include "caption_layout.hpp"
+#include "orientation.hpp"
+#include "presentation_methods.hpp"
+
+/**
+ * A decoded frame travelling through the export pipeline. Each one owns a software renderer that draws directly into
+ * its pixels, so compositing never copies the frame.
+ */
+struct ExportFrame {
+    std::vector<uint8_t> pixels;
+    SDL_Surface *surface;
+    SDL_Renderer *renderer;
+    size_t index;
+};
+
+/**
+ * Tracks how far into an orientation source we've fed the moving-average filter.
+ */
+struct OrientationCursor {
+    const std::vector<OrientationRecord> *records;
+    uint64_t origin_us;
+    size_t next_record;
+    double next_synthetic_ms;
+};
+
+static double synthetic_azimuth(double media_time_ms) {
+    return SYNTHETIC_SWEEP_AMPLITUDE * std::sin(2 * PI * media_time_ms / SYNTHETIC_SWEEP_PERIOD_MS);
+}
+
+/**
+ * Pushes every orientation sample up to (and including) media_time_ms into the filter, so that filtered_azimuth
+ * returns what it would have returned on screen at that point in the video.
+ */
+static void advance_orientation(OrientationCursor *cursor, double media_time_ms, std::mutex *azimuth_mutex,
+                                std::deque<float> *azimuth_buffer) {
+    if (cursor->records == nullptr || cursor->records->empty()) {
+        while (cursor->next_synthetic_ms <= media_time_ms) {
+            push_azimuth(synthetic_azimuth(cursor->next_synthetic_ms), azimuth_mutex, azimuth_buffer);
+            cursor->next_synthetic_ms += 1000.0 / SYNTHETIC_SAMPLE_RATE;
+        }
+        return;
+    }
+    const auto media_time_us = (uint64_t) (media_time_ms * 1000);
+    while (cursor->next_record < cursor->records->size()) {
+        const auto &record = cursor->records->at(cursor->next_record);
+        // Anything recorded before playback started primes the filter before the first frame.
+        if (record.timestamp_us >= cursor->origin_us && record.timestamp_us - cursor->origin_us > media_time_us) {
+            break;
+        }
+        if (record.kind == ORIENTATION_SAMPLE) {
+            push_orientation_sample(record.payload.data(), azimuth_mutex, azimuth_buffer);
+        }
+        ++cursor->next_record;
+    }
+}
+
+static std::string video_path(int video_section) {
+    std::ostringstream os;
+    os << "resources/videos/main." << video_section << ".mp4";
+    return os.str();
+}
+
+static void destroy_export_frames(std::vector<ExportFrame> *frames) {
+    for (auto &frame: *frames) {
+        SDL_DestroyRenderer(frame.renderer);
+        SDL_FreeSurface(frame.surface);
+    }
+}
+
+static void decode_frames(FILE *decoder, size_t frame_size, FrameQueue<ExportFrame *> *free_frames,
+                          FrameQueue<ExportFrame *> *decoded_frames) {
+    size_t index = 0;
+    while (auto frame = free_frames->pop()) {
+        if (fread((*frame)->pixels.data(), 1, frame_size, decoder) != frame_size) {
+            break;
+        }
+        (*frame)->index = index++;
+        decoded_frames->push(*frame);
+    }
+    decoded_frames->close();
+}
+
+static void composite_frames(AppContext *context, const std::vector<CaptionCue> *cues, OrientationCursor *orientation,
+                             int fps, FrameQueue<ExportFrame *> *decoded_frames,
+                             FrameQueue<ExportFrame *> *composited_frames) {
+    size_t next_cue = 0;
+    while (auto frame = decoded_frames->pop()) {
+        const double media_time_ms = (*frame)->index * 1000.0 / fps;
+        // Words are revealed once their delay has elapsed, just like start_caption_stream does in real time.
+        while (next_cue < cues->size() && cues->at(next_cue).time_ms <= media_time_ms) {
+            context->caption_model->add_word(cues->at(next_cue).text, cues->at(next_cue).speaker);
+            ++next_cue;
+        }
+        advance_orientation(orientation, media_time_ms, context->azimuth_mutex, context->azimuth_buffer);
+
+        context->renderer = (*frame)->renderer;
+        context->frame_surface = (*frame)->surface;
+        render_captions(context);
+        SDL_RenderFlush(context->renderer);
+        composited_frames->push(*frame);
+    }
+    composited_frames->close();
+}
+
+static void encode_frames(FILE *encoder, size_t frame_size, FrameQueue<ExportFrame *> *composited_frames,
+                          FrameQueue<ExportFrame *> *free_frames, size_t *frames_written, bool *write_failed) {
+    const auto start = std::chrono::steady_clock::now();
+    while (auto frame = composited_frames->pop()) {
+        if (fwrite((*frame)->pixels.data(), 1, frame_size, encoder) != frame_size) {
+            std::cerr << "Failed to write frame " << (*frame)->index << " to the encoder: " << strerror(errno)
+                      << std::endl;
+            *write_failed = true;
+            free_frames->close();
+            break;
+        }
+        ++(*frames_written);
+        if (*frames_written % 300 == 0) {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Exported " << *frames_written << " frames ("
+                      << *frames_written / elapsed.count() << " frames/s)" << std::endl;
+        }
+        free_frames->push(*frame);
+    }
+    free_frames->close();
+}
+
+ExportStats export_captioned_video(const AppContext *prototype, const std::vector<CaptionCue> *cues,
+                                   const std::vector<OrientationRecord> *orientation, const std::string &output_path,
+                                   int fps) {
+    AppContext context = *prototype;
+    const int width = context.window_width;
+    const int height = context.window_height;
+    const int pitch = width * 2;
+    const size_t frame_size = (size_t) pitch * height;
+    context.display_rect = SDL_Rect{0, 0, width, height};
+
+    CaptionModel caption_model;
+    context.caption_model = &caption_model;
+    const CaptionLayout caption_layout = build_caption_layout(*cues, context.speakers, nullptr, width, height);
+    context.caption_layout = &caption_layout;
+    std::mutex azimuth_mutex;
+    std::deque<float> azimuth_buffer;
+    context.azimuth_mutex = &azimuth_mutex;
+    context.azimuth_buffer = &azimuth_buffer;
+    OrientationCursor orientation_cursor{orientation, 0, 0, 0};
+    if (orientation != nullptr && !orientation->empty()) {
+        orientation_cursor.origin_us = playback_origin_us(*orientation);
+    }
+
+    const auto source_path = video_path(context.video_section);
+    if (access(source_path.c_str(), R_OK) < 0) {
+        std::cerr << "Unable to read " << source_path << ": " << strerror(errno) << std::endl;
+        return ExportStats{0, 0, false};
+    }
+    const std::vector<std::string> decode_arguments{
+            "-loglevel", "error", "-i", source_path, "-an",
+            "-vf", "fps=" + std::to_string(fps) + ",scale=" + std::to_string(width) + ":" + std::to_string(height),
+            "-f", "rawvideo", "-pix_fmt", "bgr565le", "-"};
+    const std::vector<std::string> encode_arguments{
+            "-loglevel", "error", "-y",
+            "-f", "rawvideo", "-pix_fmt", "bgr565le", "-s", std::to_string(width) + "x" + std::to_string(height),
+            "-r", std::to_string(fps), "-i", "-",
+            "-i", source_path, "-map", "0:v", "-map", "1:a?", "-shortest",
+            "-c:v", "libx264", "-preset", "veryfast", "-pix_fmt", "yuv420p", "-c:a", "aac", output_path};
+    std::cout << "Decoding with: " << ffmpeg_command_line(decode_arguments) << std::endl;
+    std::cout << "Encoding with: " << ffmpeg_command_line(encode_arguments) << std::endl;
+    FfmpegProcess decoder{};
+    FfmpegProcess encoder{};
+    if (!start_ffmpeg(decode_arguments, true, &decoder)) {
+        return ExportStats{0, 0, false};
+    }
+    if (!start_ffmpeg(encode_arguments, false, &encoder)) {
+        finish_ffmpeg(&decoder);
+        return ExportStats{0, 0, false};
+    }
+
+    // Every frame buffer is wrapped in a surface with its own software renderer, and recycled once it's been encoded.
+    std::vector<ExportFrame> frames(EXPORT_PIPELINE_DEPTH, ExportFrame{{}, nullptr, nullptr, 0});
+    FrameQueue<ExportFrame *> free_frames(EXPORT_PIPELINE_DEPTH);
+    FrameQueue<ExportFrame *> decoded_frames(EXPORT_PIPELINE_DEPTH);
+    FrameQueue<ExportFrame *> composited_frames(EXPORT_PIPELINE_DEPTH);
+    for (auto &frame: frames) {
+        frame.pixels.resize(frame_size);
+        frame.surface = SDL_CreateRGBSurfaceWithFormatFrom(frame.pixels.data(), width, height, 16, pitch,
+                                                           SDL_PIXELFORMAT_BGR565);
+        frame.renderer = SDL_CreateSoftwareRenderer(frame.surface);
+        if (frame.surface == nullptr || frame.renderer == nullptr) {
+            std::cerr << "Couldn't create export frame: " << SDL_GetError() << std::endl;
+            destroy_export_frames(&frames);
+            finish_ffmpeg(&decoder);
+            finish_ffmpeg(&encoder);
+            return ExportStats{0, 0, false};
+        }
+        free_frames.push(&frame);
+    }
+
+    size_t frames_written = 0;
+    bool write_failed = false;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread decode_thread(decode_frames, decoder.pipe, frame_size, &free_frames, &decoded_frames);
+    std::thread composite_thread(composite_frames, &context, cues, &orientation_cursor, fps, &decoded_frames,
+                                 &composited_frames);
+    std::thread encode_thread(encode_frames, encoder.pipe, frame_size, &composited_frames, &free_frames,
+                              &frames_written, &write_failed);
+    encode_thread.join();
+    // If the encoder bailed out early, make sure the other stages aren't left waiting on it.
+    decoded_frames.close();
+    composited_frames.close();
+    composite_thread.join();
+    decode_thread.join();
+    const bool decoded = finish_ffmpeg(&decoder);
+    const bool encoded = finish_ffmpeg(&encoder);
+    if (!decoded) {
+        std::cerr << "ffmpeg failed to decode " << source_path << std::endl;
+    }
+    if (!encoded) {
+        std::cerr << "ffmpeg failed to encode " << output_path << std::endl;
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    destroy_export_frames(&frames);
+
+    const double media_seconds = (double) frames_written / fps;
+    std::cout << "Exported " << frames_written << " frames to " << output_path << " in " << elapsed.count() << "s ("
+              << frames_written / elapsed.count() << " frames/s, " << media_seconds / elapsed.count()
+              << "x real time)" << std::endl;
+    return ExportStats{frames_written, elapsed.count(), decoded && encoded && !write_failed && frames_written > 0};
+}
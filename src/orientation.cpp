@@ -1,63 +1,93 @@
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstring>
 #include <deque>
 #include <iostream>
+#include <numeric>
 #include "orientation.hpp"
+#include "app_events.hpp"
 #include "cog-flatbuffer-definitions/orientation_message_generated.h"
 
 int to_pixels(double inches) {
     return inches * PIXELS_PER_INCH;
 }
 
-int angle_to_pixel_position(double angle) {
+int exact_angle_to_pixel_position(double angle) {
     const auto position_in_inches = std::tan(angle) * INCHES_FROM_SCREEN;
     return to_pixels(position_in_inches);
 }
 
+/**
+ * One entry per step around the circle, plus a copy of the first at the end so interpolation never has to wrap.
+ */
+static std::array<int32_t, AZIMUTH_TABLE_SIZE + 1> build_azimuth_table() {
+    std::array<int32_t, AZIMUTH_TABLE_SIZE + 1> table{};
+    for (int i = 0; i <= AZIMUTH_TABLE_SIZE; ++i) {
+        const double angle = 2 * PI * i / AZIMUTH_TABLE_SIZE;
+        const double position = std::tan(angle) * INCHES_FROM_SCREEN * PIXELS_PER_INCH;
+        const double clamped = std::max(-(double) MAX_TABLE_PIXELS, std::min((double) MAX_TABLE_PIXELS, position));
+        table[i] = (int32_t) std::lround(clamped * (1 << PIXEL_FRACTION_BITS));
+    }
+    return table;
+}
+
+static const auto AZIMUTH_TABLE = build_azimuth_table();
+
+int angle_to_pixel_position(double angle) {
+    // The angle in table steps, in the same fixed point as the entries. Masking to a whole turn wraps negative angles
+    // and angles past 2*PI around, just like std::tan does.
+    constexpr double steps_per_radian = AZIMUTH_TABLE_SIZE / (2 * PI) * (1 << PIXEL_FRACTION_BITS);
+    const auto phase = (int64_t) std::llround(angle * steps_per_radian) &
+                       (((int64_t) AZIMUTH_TABLE_SIZE << PIXEL_FRACTION_BITS) - 1);
+    const auto index = (size_t) (phase >> PIXEL_FRACTION_BITS);
+    const auto fraction = phase & ((1 << PIXEL_FRACTION_BITS) - 1);
+    const int64_t low = AZIMUTH_TABLE[index];
+    const int64_t high = AZIMUTH_TABLE[index + 1];
+    const int64_t position = low + (((high - low) * fraction) >> PIXEL_FRACTION_BITS);
+    // Truncated towards zero, like the exact version's conversion to int.
+    return (int) (position / (1 << PIXEL_FRACTION_BITS));
+}
+
 double to_radians(double degrees) {
     return degrees * PI / 180.f;
 }
 
 
-void read_orientation(int socket, sockaddr_in *client_address, std::mutex *azimuth_mutex,
-                      std::deque<float> *orientation_buffer) {
-    size_t len, num_bytes_read;
-    std::array<char, 256> buffer{};
-    len = sizeof(*client_address);
+float push_azimuth(float azimuth, std::mutex *azimuth_mutex, std::deque<float> *orientation_buffer) {
+    auto current_azimuth = azimuth;
+    if (current_azimuth < 0) {
+        current_azimuth = current_azimuth + 2 * PI;
+    }
+    azimuth_mutex->lock();
+    if (orientation_buffer->size() == MOVING_AVG_SIZE) {
+        orientation_buffer->pop_front();
+    }
+    orientation_buffer->push_back(current_azimuth);
+    azimuth_mutex->unlock();
+    return current_azimuth;
+}
 
-    num_bytes_read = recvfrom(socket, buffer.data(), buffer.size(),
-                              0, (struct sockaddr *) &(*client_address),
-                              reinterpret_cast<socklen_t *>(&len));
+bool verify_orientation_sample(const uint8_t *buffer, size_t size) {
+    flatbuffers::Verifier verifier(buffer, size);
+    return cog::VerifyOrientationMessageBuffer(verifier);
+}
 
-    while (num_bytes_read != -1) {
-        azimuth_mutex->lock();
-        if (orientation_buffer->size() == MOVING_AVG_SIZE) {
-            orientation_buffer->pop_front();
-        }
-        auto current_orientation = cog::GetOrientationMessage(buffer.data());
-        auto current_azimuth = current_orientation->gyro_z();
-        std::cout<<"Current Orientation: " << current_azimuth << "\n";
-        if (current_azimuth < 0) {
-            current_azimuth = current_azimuth + 2 * PI;
-        }
-        orientation_buffer->push_back(current_azimuth);
-        azimuth_mutex->unlock();
-        if (recvfrom(socket, buffer.data(), buffer.size(),
-                     0, (struct sockaddr *) &(*client_address),
-                     reinterpret_cast<socklen_t *>(&len)) < 0) {
-            std::cerr << "recvfrom failed: " << strerror(errno) << std::endl;
-        }
-    }
+float push_orientation_sample(const uint8_t *buffer, std::mutex *azimuth_mutex, std::deque<float> *orientation_buffer) {
+    auto current_orientation = cog::GetOrientationMessage(buffer);
+    return push_azimuth(current_orientation->gyro_z(), azimuth_mutex, orientation_buffer);
 }
 
-double filtered_azimuth(std::deque<float> *azimuth_buffer, std::mutex *azimuth_mutex) {
+double filtered_azimuth(std::deque<float> *azimuth_buffer, std::mutex *azimuth_mutex, size_t taps) {
     azimuth_mutex->lock();
-    if (azimuth_buffer->empty()) {
+    if (azimuth_buffer->empty() || taps == 0) {
         azimuth_mutex->unlock();
         return 0;
     }
+    const auto count = std::min(taps, azimuth_buffer->size());
     double average_azimuth =
-            std::accumulate(azimuth_buffer->begin(), azimuth_buffer->end(), 0.0) /
-            azimuth_buffer->size();
+            std::accumulate(azimuth_buffer->end() - count, azimuth_buffer->end(), 0.0) /
+            count;
 //    double median_azimuth = median(azimuth_buffer);
     auto angle = average_azimuth;
     azimuth_mutex->unlock();
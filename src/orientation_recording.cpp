@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include "orientation_recording.hpp"
+#include "orientation.hpp"
+#include "metrics.hpp"
+#include "thread_config.hpp"
+
+constexpr size_t RECORD_HEADER_SIZE = 12;
+
+OrientationRecorder::OrientationRecorder(const std::string &path) : path(path) {
+    file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Unable to open orientation recording " << path << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    uint8_t header[8];
+    memcpy(header, ORIENTATION_RECORDING_MAGIC, 4);
+    for (int i = 0; i < 4; ++i) {
+        header[4 + i] = (ORIENTATION_RECORDING_VERSION >> (8 * i)) & 0xFF;
+    }
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        std::cerr << "Unable to write orientation recording " << path << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    opened_at = std::chrono::steady_clock::now();
+}
+
+OrientationRecorder::~OrientationRecorder() {
+    close();
+}
+
+void OrientationRecorder::append(OrientationRecordKind kind, const uint8_t *payload, uint16_t size) {
+    const uint64_t timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - opened_at).count();
+    // Serialize the header byte-by-byte so the file is little-endian and unpadded regardless of the host.
+    uint8_t header[RECORD_HEADER_SIZE];
+    header[0] = kind;
+    header[1] = 0;
+    header[2] = size & 0xFF;
+    header[3] = (size >> 8) & 0xFF;
+    for (int i = 0; i < 8; ++i) {
+        header[4 + i] = (timestamp_us >> (8 * i)) & 0xFF;
+    }
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (file == nullptr) {
+        return;
+    }
+    bool written = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+                   (size == 0 || fwrite(payload, 1, size, file) == size);
+    // Flush every so often, so that a crash mid-trial only loses the last second or so of motion.
+    if (written && ++records_since_flush >= FLUSH_INTERVAL) {
+        written = fflush(file) == 0;
+        records_since_flush = 0;
+    }
+    if (!written) {
+        // Anything after a failed write could land after a torn record, so the recording stops here. Loading it drops
+        // the torn record, and keeps everything before it.
+        std::cerr << "Unable to write orientation recording " << path << ", it stops here: " << strerror(errno)
+                  << std::endl;
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void OrientationRecorder::record_sample(const uint8_t *buffer, size_t size) {
+    if (size > UINT16_MAX) {
+        // A record's size field can't hold it, and a truncated sample would never decode.
+        std::lock_guard<std::mutex> lock(file_mutex);
+        oversized_samples++;
+        return;
+    }
+    append(ORIENTATION_SAMPLE, buffer, static_cast<uint16_t>(size));
+}
+
+void OrientationRecorder::mark_playback_started() {
+    append(PLAYBACK_STARTED, nullptr, 0);
+}
+
+void OrientationRecorder::mark_quality_changed(int quality_level) {
+    const auto level = static_cast<uint8_t>(quality_level);
+    append(QUALITY_CHANGE, &level, 1);
+}
+
+void OrientationRecorder::close() {
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (oversized_samples > 0) {
+        std::cerr << "Left " << oversized_samples << " orientation samples over " << UINT16_MAX
+                  << " bytes out of " << path << std::endl;
+        oversized_samples = 0;
+    }
+    if (file != nullptr) {
+        if (fclose(file) != 0) {
+            std::cerr << "Unable to finish orientation recording " << path << ": " << strerror(errno) << std::endl;
+        }
+        file = nullptr;
+    }
+}
+
+std::vector<OrientationRecord> load_orientation_recording(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "Unable to open orientation recording " << path << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    uint8_t file_header[8];
+    if (fread(file_header, 1, sizeof(file_header), file) != sizeof(file_header) ||
+        memcmp(file_header, ORIENTATION_RECORDING_MAGIC, 4) != 0) {
+        std::cerr << path << " is not an orientation recording." << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    uint32_t version = 0;
+    for (int i = 0; i < 4; ++i) {
+        version |= static_cast<uint32_t>(file_header[4 + i]) << (8 * i);
+    }
+    if (version != ORIENTATION_RECORDING_VERSION) {
+        std::cerr << "Unsupported orientation recording version " << version << " in " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<OrientationRecord> records;
+    size_t malformed_samples = 0;
+    uint8_t header[RECORD_HEADER_SIZE];
+    while (fread(header, 1, sizeof(header), file) == sizeof(header)) {
+        OrientationRecord record{};
+        record.kind = static_cast<OrientationRecordKind>(header[0]);
+        const uint16_t size = header[2] | (header[3] << 8);
+        for (int i = 0; i < 8; ++i) {
+            record.timestamp_us |= static_cast<uint64_t>(header[4 + i]) << (8 * i);
+        }
+        record.payload.resize(size);
+        if (size > 0 && fread(record.payload.data(), 1, size, file) != size) {
+            // The last record was cut short (most likely the process was killed mid-write), drop it.
+            break;
+        }
+        // Replay decodes samples without checking them again, so a corrupt one is dropped here instead.
+        if (record.kind == ORIENTATION_SAMPLE && !verify_orientation_sample(record.payload.data(), size)) {
+            malformed_samples++;
+            continue;
+        }
+        records.push_back(std::move(record));
+    }
+    fclose(file);
+    if (malformed_samples > 0) {
+        std::cerr << "Skipped " << malformed_samples << " malformed orientation samples in " << path << std::endl;
+    }
+    std::cout << "Loaded " << records.size() << " orientation records from " << path << std::endl;
+    return records;
+}
+
+uint64_t playback_origin_us(const std::vector<OrientationRecord> &records) {
+    for (const auto &record: records) {
+        if (record.kind == PLAYBACK_STARTED) {
+            return record.timestamp_us;
+        }
+    }
+    return records.empty() ? 0 : records.front().timestamp_us;
+}
+
+void replay_orientation(const std::vector<OrientationRecord> *records, double speed, const std::atomic<bool> *started,
+                        const std::atomic<bool> *stopping, std::mutex *azimuth_mutex,
+                        std::deque<float> *orientation_buffer) {
+    const auto origin_us = playback_origin_us(*records);
+    size_t i = 0;
+    // Prime the moving average with whatever the participant was doing before the video started.
+    for (; i < records->size() && records->at(i).timestamp_us < origin_us; ++i) {
+        if (records->at(i).kind == ORIENTATION_SAMPLE) {
+            push_orientation_sample(records->at(i).payload.data(), azimuth_mutex, orientation_buffer);
+        }
+    }
+    if (!wait_for_playback(started, stopping)) {
+        return;
+    }
+    const auto playback_start = std::chrono::steady_clock::now();
+    for (; i < records->size(); ++i) {
+        const auto &record = records->at(i);
+        if (record.kind != ORIENTATION_SAMPLE) {
+            continue;
+        }
+        if (speed > 0) {
+            const auto offset = std::chrono::duration<double, std::micro>(
+                    (double) (record.timestamp_us - origin_us) / speed);
+            const auto wake_at = playback_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset);
+            if (!sleep_until_or_stopping(wake_at, stopping)) {
+                return;
+            }
+            record_wakeup(ORIENTATION_THREAD, wake_at);
+        }
+        push_orientation_sample(record.payload.data(), azimuth_mutex, orientation_buffer);
+        record_orientation_sample(&trial_metrics);
+    }
+    std::cout << "Orientation replay finished." << std::endl;
+}
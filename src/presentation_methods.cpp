@@ -1,9 +1,41 @@
 #include <iostream>
+#include <sstream>
 #include "presentation_methods.hpp"
 #include "orientation.hpp"
+#include "caption_layout.hpp"
+#include "caption_overlay.hpp"
+#include "caption_blend.hpp"
+#include "caption_texture_cache.hpp"
+#include "caption_timeline.hpp"
+#include "quality_governor.hpp"
 
-SDL_Color bg = {0,0,255,128};
-SDL_Color fg = {255,255,255,128};
+/**
+ * The caption currently on screen, taken from the precomputed layout whenever it applies.
+ */
+struct CurrentCaption {
+    SpeakerId juror;
+    std::pmr::string text; // From the frame arena, if the context has one
+    const CaptionLayoutEntry *layout; // nullptr if the caption has to be laid out from scratch
+};
+
+static CurrentCaption current_caption(const AppContext *context) {
+    auto *memory = frame_memory(context->frame_arena);
+    const CaptionLayoutEntry *entry = nullptr;
+    if (lookup_caption_layout(context, &entry)) {
+        if (entry == nullptr) {
+            return CurrentCaption{0, std::pmr::string(memory), nullptr};
+        }
+        return CurrentCaption{entry->speaker, std::pmr::string(layout_text(context->caption_layout, entry), memory),
+                              entry};
+    }
+    // Without a layout, the caption is put together from scratch (on the heap) every time it's drawn.
+    if (context->caption_timeline != nullptr) {
+        auto[juror, text] = caption_timeline_text(context->caption_timeline, revealed_caption_count(context));
+        return CurrentCaption{juror, std::pmr::string(text, memory), nullptr};
+    }
+    auto[juror, text] = context->caption_model->get_current_text();
+    return CurrentCaption{juror, std::pmr::string(text, memory), nullptr};
+}
 
 std::optional<SDL_Rect> rectangle_intersection(const SDL_Rect *a, const SDL_Rect *b) {
     int intersection_tl_x = std::max(a->x, b->x);
@@ -27,107 +59,178 @@ void render_surface_as_texture(SDL_Renderer *renderer, SDL_Surface *surface, SDL
     SDL_DestroyTexture(texture);
 }
 
-std::tuple<int, int>
-render_text(SDL_Renderer *renderer, TTF_Font *font, const std::string &text, int x, int y,
-            const SDL_Color *foreground_color, const SDL_Color *background_color) {
-    auto text_surface = TTF_RenderText_Shaded_Wrapped(font, text.c_str(), *foreground_color,
-                                                      *background_color,
-                                                      WRAP_LENGTH);
-    int w = text_surface->w;
-    int h = text_surface->h;
-    auto destination_rect = SDL_Rect{x, y, w, h};
-    render_surface_as_texture(renderer, text_surface, nullptr, &destination_rect);
-    SDL_FreeSurface(text_surface);
-    return std::make_tuple(w, h);
+/**
+ * Copies a width x height caption (from the top-left of texture, which may be bigger) to (x, y), clipped to clip_rect
+ * if one is given.
+ */
+static void copy_caption_texture(SDL_Renderer *renderer, SDL_Texture *texture, int width, int height, int x, int y,
+                                 const SDL_Rect *clip_rect) {
+    const auto text_rect = SDL_Rect{x, y, width, height};
+    SDL_Rect visible_rect;
+    if (clip_rect == nullptr) {
+        const SDL_Rect source_rect{0, 0, width, height};
+        SDL_RenderCopy(renderer, texture, &source_rect, &text_rect);
+    } else if (SDL_IntersectRect(&text_rect, clip_rect, &visible_rect)) {
+        SDL_Rect source_rect{visible_rect.x - x, visible_rect.y - y, visible_rect.w, visible_rect.h};
+        SDL_RenderCopy(renderer, texture, &source_rect, &visible_rect);
+    }
 }
 
-
-void render_nonregistered_captions(const AppContext *context) {
-    auto left_x = filtered_azimuth(context->azimuth_buffer, context->azimuth_mutex);
-    const auto adjusted_x = angle_to_pixel_position(left_x) + context->window_width / 3;
-    auto[juror, text] = context->caption_model->get_current_text();
-    if (text.empty()) {
+/**
+ * Draws an image (e.g. an arrow) at destination_rect, from the context's texture cache if it has one.
+ */
+static void draw_image(const AppContext *context, SDL_Surface *image, SDL_Rect *destination_rect) {
+    if (context->caption_textures == nullptr) {
+        render_surface_as_texture(context->renderer, image, nullptr, destination_rect);
         return;
     }
-    render_text(context->renderer, context->medium_font, text, adjusted_x, context->y,
-                context->foreground_color,
-                context->background_color);
+    auto *texture = cached_image_texture(context->caption_textures, context->renderer, image);
+    SDL_SetRenderDrawColor(context->renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+    SDL_RenderCopy(context->renderer, texture, nullptr, destination_rect);
 }
 
+/**
+ * Draws a speaker's caption at (x, y), clipped to clip_rect if one is given. When compositing on the CPU, the caption
+ * is blended straight into the frame. Otherwise it's copied through the renderer, from the context's texture cache if
+ * it has one (so the caption is only rasterized once per revision), or rasterized from scratch if not. Either way,
+ * only the glyphs inside clip_rect are laid out per frame; the cache keeps whole captions, since a turn of the head
+ * brings a different part of the caption into view.
+ * @return The width and height of the whole caption.
+ */
+static std::tuple<int, int> draw_caption(const AppContext *context, SpeakerId juror, std::string_view text, int x,
+                                         int y, const SDL_Rect *clip_rect) {
+    const auto *glyph_atlas = speaker_atlas(context->speakers, context->glyph_atlases, juror);
+    const auto *foreground_color = &context->speakers->colors[juror];
+    if (context->frame_surface != nullptr) {
+        // Anything already queued on the renderer (e.g. an arrow) has to land in the frame before we write to it.
+        SDL_RenderFlush(context->renderer);
+        return blend_text(context->frame_surface, glyph_atlas, text, x, y, clip_rect, foreground_color,
+                          context->background_color, frame_memory(context->frame_arena));
+    }
+    if (context->caption_textures != nullptr) {
+        const auto *cached = cached_caption_texture(context->caption_textures, context->renderer,
+                                                    context->frame_arena, caption_revision(context), glyph_atlas,
+                                                    juror, text, foreground_color, context->background_color,
+                                                    cached_captions_only(context->quality_governor));
+        if (cached != nullptr) {
+            copy_caption_texture(context->renderer, cached->texture, cached->width, cached->height, x, y, clip_rect);
+            return std::make_tuple(cached->width, cached->height);
+        }
+    }
+    // Without a cache, nothing is kept for the next frame, so only the part of the caption that's in view is
+    // rasterized.
+    const auto[text_width, text_height] = measure_text(glyph_atlas, text);
+    const auto text_rect = SDL_Rect{x, y, std::max(text_width, 1), text_height};
+    SDL_Rect visible_rect = text_rect;
+    if (clip_rect != nullptr && !SDL_IntersectRect(&text_rect, clip_rect, &visible_rect)) {
+        return std::make_tuple(text_rect.w, text_rect.h);
+    }
+    const SDL_Rect visible_region{visible_rect.x - x, visible_rect.y - y, visible_rect.w, visible_rect.h};
+    auto texture = create_caption_region_texture(context->renderer, context->frame_arena, glyph_atlas, text,
+                                                 &visible_region, foreground_color, context->background_color);
+    SDL_RenderCopy(context->renderer, texture, nullptr, &visible_rect);
+    SDL_DestroyTexture(texture);
+    return std::make_tuple(text_rect.w, text_rect.h);
+}
 
-void render_nonregistered_captions_with_indicators(const AppContext *context) {
-    auto left_x = filtered_azimuth(context->azimuth_buffer, context->azimuth_mutex);
+/**
+ * Non-registered captions follow the user's head orientation around the screen. With arrows, an arrow beside the caption
+ * points towards whoever is speaking whenever they're off to one side of it.
+ */
+template<bool WithArrows>
+static void render_nonregistered(const AppContext *context) {
+    auto left_x = filtered_azimuth(context->azimuth_buffer, context->azimuth_mutex,
+                                   orientation_filter_taps(context->quality_governor));
     const auto adjusted_x = angle_to_pixel_position(left_x) + context->window_width / 3;
-    auto[juror, text] = context->caption_model->get_current_text();
-    if (text.empty()) {
+    const auto caption = current_caption(context);
+    if (caption.text.empty()) {
         return;
     }
-    const auto[text_width, text_height] = render_text(context->renderer,
-                                                      context->medium_font, text, adjusted_x,
-                                                      context->y,
-                                                      context->foreground_color, context->background_color);
-    bool should_show_forward_arrow = false;
-    bool should_show_back_arrow = false;
-    const auto[left, right] = context->juror_intervals.at(juror);
-    if ((adjusted_x + text_width / 2) < left) {
-        should_show_forward_arrow = true;
-    } else if ((adjusted_x + text_width / 2) > right) {
-        should_show_back_arrow = true;
-    }
-    int arrow_x = adjusted_x;
-    SDL_Surface *arrow_surface = nullptr;
-    if (should_show_back_arrow) {
-        arrow_surface = context->back_arrow;
-        arrow_x -= arrow_surface->w;
-    } else if (should_show_forward_arrow) {
-        arrow_surface = context->forward_arrow;
-        arrow_x += text_width;
-    }
+    const auto[text_width, text_height] = draw_caption(context, caption.juror, caption.text, adjusted_x, context->y,
+                                                       nullptr);
+    const auto text_rect = SDL_Rect{adjusted_x, context->y, text_width, text_height};
+    mark_overlay_dirty(context, &text_rect);
+    if constexpr (WithArrows) {
+        bool should_show_forward_arrow = false;
+        bool should_show_back_arrow = false;
+        const auto[left, right] = caption.layout != nullptr
+                                  ? std::pair<double, double>(caption.layout->interval_left,
+                                                              caption.layout->interval_right)
+                                  : speaker_interval(context->speakers, caption.juror, context->window_width);
+        if ((adjusted_x + text_width / 2) < left) {
+            should_show_forward_arrow = true;
+        } else if ((adjusted_x + text_width / 2) > right) {
+            should_show_back_arrow = true;
+        }
+        int arrow_x = adjusted_x;
+        SDL_Surface *arrow_surface = nullptr;
+        if (should_show_back_arrow) {
+            arrow_surface = context->back_arrow;
+            arrow_x -= arrow_surface->w;
+        } else if (should_show_forward_arrow) {
+            arrow_surface = context->forward_arrow;
+            arrow_x += text_width;
+        }
 
-    if (!(should_show_back_arrow || should_show_forward_arrow)) {
-        return;
+        if (!(should_show_back_arrow || should_show_forward_arrow)) {
+            return;
+        }
+        auto destination_rect = SDL_Rect{arrow_x, context->y, arrow_surface->w, arrow_surface->h};
+        draw_image(context, arrow_surface, &destination_rect);
+        mark_overlay_dirty(context, &destination_rect);
     }
-    auto destination_rect = SDL_Rect{arrow_x, context->y, arrow_surface->w, arrow_surface->h};
-    render_surface_as_texture(context->renderer, arrow_surface, nullptr, &destination_rect);
+}
+
+void render_nonregistered_captions(const AppContext *context) {
+    render_nonregistered<false>(context);
+}
+
+void render_nonregistered_captions_with_indicators(const AppContext *context) {
+    render_nonregistered<true>(context);
 }
 
 void render_registered_captions(const AppContext *context) {
-    const auto[juror, text] = context->caption_model->get_current_text();
-    if (text.empty()) {
+    const auto caption = current_caption(context);
+    if (caption.text.empty()) {
         return;
     }
-    // We've previously identified where on the screen to place the captions u nderneath the jurors. Those are represented as percentages of the VLC surface fov_x_2/height
-    auto[left_x_percent, left_y_percent] = context->juror_positions.at(juror);
-    // Now we just re-hydrate those values with the current size of the VLC surface to get where the captions should be positioned.
-    int text_x = left_x_percent * context->display_rect.w;
-    int text_y = left_y_percent * context->display_rect.h;
-    // Retrieve the font to be used for the current juror
-    auto font = context->juror_font_sizes->at(juror);
-    // And let's create a surface of the text we've been given.
-    auto text_surface = TTF_RenderText_Shaded_Wrapped(font, text.c_str(), *context->foreground_color,
-                                                      *context->background_color,
-                                                      WRAP_LENGTH);
-//    SDL_Rect rect = {text_x, text_y, text_surface->w, text_surface->h};
-//    render_surface_as_texture(context->renderer, text_surface, nullptr, &rect);
-//    return;
-
-    // Now, here's where we do our clipping behavior.
-    // The general idea is as follows:
-    //
-    // The text surface has a width and height, and we know the text_x and text_y of where we're going to draw the
-    // caption (assuming no clipping at all).
-    const auto surface_rect = SDL_Rect{text_x, text_y, text_surface->w, text_surface->h};
+    SDL_Rect surface_rect;
+    if (caption.layout != nullptr) {
+        // The layout already knows where this caption goes and how big it is.
+        surface_rect = caption.layout->anchor;
+    } else {
+        // We've previously identified where on the screen to place the captions u nderneath the jurors. Those are represented as percentages of the VLC surface fov_x_2/height
+        const auto left_x_percent = context->speakers->anchor_x[caption.juror];
+        const auto left_y_percent = context->speakers->anchor_y[caption.juror];
+        // Now we just re-hydrate those values with the current size of the VLC surface to get where the captions should be positioned.
+        int text_x = left_x_percent * context->display_rect.w;
+        int text_y = left_y_percent * context->display_rect.h;
+        // And let's measure the text we've been given; nothing is rasterized until we know it's at least partly in
+        // view.
+        const auto[text_width, text_height] = measure_text(
+                speaker_atlas(context->speakers, context->glyph_atlases, caption.juror), caption.text);
+
+        // Now, here's where we do our clipping behavior.
+        // The general idea is as follows:
+        //
+        // The text surface has a width and height, and we know the text_x and text_y of where we're going to draw the
+        // caption (assuming no clipping at all).
+        surface_rect = SDL_Rect{text_x, text_y, text_width, text_height};
+    }
+    const int text_x = surface_rect.x;
+    const int text_y = surface_rect.y;
 
     // We also have a pre-defined field-of-view (FOV), which is how much the person would be able to see if they were
     // wearing a realistic HWD.
-    auto azimuth = filtered_azimuth(context->azimuth_buffer, context->azimuth_mutex);
+    auto azimuth = filtered_azimuth(context->azimuth_buffer, context->azimuth_mutex,
+                                    orientation_filter_taps(context->quality_governor));
     const auto half_fov_in_radians = to_radians(context->half_fov);
 
-    // We can calculate how much of the window fov_x_2 the FOV covers with some trig...
-    const auto fov_x = angle_to_pixel_position(azimuth) - angle_to_pixel_position(to_radians(context->half_fov)) +
-                       context->window_width / 3;
-    const auto fov_x_2 = angle_to_pixel_position(azimuth) + angle_to_pixel_position(to_radians(context->half_fov)) +
-                         context->window_width / 3;
+    // We can calculate how much of the window fov_x_2 the FOV covers with some trig (looked up, rather than worked out)...
+    const auto azimuth_x = angle_to_pixel_position(azimuth);
+    const auto half_fov_x = angle_to_pixel_position(half_fov_in_radians);
+    const auto fov_x = azimuth_x - half_fov_x + context->window_width / 3;
+    const auto fov_x_2 = azimuth_x + half_fov_x + context->window_width / 3;
     auto l = std::min(fov_x, fov_x_2);
     auto r = std::max(fov_x, fov_x_2);
     const auto fov_region = SDL_Rect{l, 0, r - l, context->window_height};
@@ -153,26 +256,77 @@ void render_registered_captions(const AppContext *context) {
             arrow_surface = context->forward_arrow;
         }
         auto destination_rect = SDL_Rect{arrow_x, context->y - 400 , arrow_surface->w, arrow_surface->h};
-        render_surface_as_texture(context->renderer, arrow_surface, nullptr, &destination_rect);
-        SDL_FreeSurface(text_surface);
+        draw_image(context, arrow_surface, &destination_rect);
+        mark_overlay_dirty(context, &destination_rect);
         return;
     }
     SDL_Rect intersection_rect = intersection.value();
+    // Only the part of the caption inside the intersection gets drawn (whether that's by the blend on the CPU, or by
+    // copying just that part of the caption's texture), at the same place on screen it would be if it weren't clipped.
+    draw_caption(context, caption.juror, caption.text, text_x, text_y, &intersection_rect);
+    mark_overlay_dirty(context, &intersection_rect);
+}
+
+/**
+ * Each presentation method's whole draw, specialized at compile time so that nothing in it has to check the method.
+ */
+template<int Method>
+static void render_pipeline(const AppContext *context);
+
+template<>
+void render_pipeline<REGISTERED_GRAPHICS>(const AppContext *context) {
+    // Registered graphics remain stationary in space
+    render_registered_captions(context);
+}
+
+template<>
+void render_pipeline<NONREGISTERED_GRAPHICS>(const AppContext *context) {
+    // Non-registered graphics follow the user's head orientation around the screen
+    render_nonregistered<false>(context);
+}
+
+template<>
+void render_pipeline<NONREGISTERED_GRAPHICS_WITH_ARROWS>(const AppContext *context) {
+    render_nonregistered<true>(context);
+}
 
-    // One thing to note: our intersection rectangle could be located anywhere on the screen
-    // (0 <= intersection_x <= WINDOW_WIDTH) and (0 <= intersection_y <= WINDOW_HEIGHT)
-    // But that's not what we want! We want to know how much of the TEXT SURFACE we want to render.
-    // So let's calculate how far intersection_rect.x is from text_x, and how far intersection_rect.y is from text_y
-    SDL_Rect text_surface_clip_region = {
-            intersection_rect.x - text_x, // This won't ever be negative, because intersection_x >= text_x always
-            intersection_rect.y - text_y, // Same here
-            intersection_rect.w, // And this is how much of the text surface we want to clip
-            intersection_rect.h
-    };
-    // Now, last thing: We now know what part of the text surface we need to clip, but we need to RENDER it at the
-    // intersection between the FOV and the caption rectangle.
-    // We're going to copy the pixels from the region outlined by text_surface_clip_region on text_surface to the
-    // pixels outlined by intersection_rect. That should give us the clipped caption on the display!
-    render_surface_as_texture(context->renderer, text_surface, &text_surface_clip_region, &intersection_rect);
-    SDL_FreeSurface(text_surface);
-}
\ No newline at end of file
+template<>
+void render_pipeline<CONTROL>(const AppContext *) {
+}
+
+static void render_unknown_method(const AppContext *) {
+}
+
+CaptionPipeline caption_pipeline(int presentation_method) {
+    // Based on the presentation method selected by the researcher, we want to render captions in different ways.
+    switch (presentation_method) {
+        case REGISTERED_GRAPHICS:
+            return render_pipeline<REGISTERED_GRAPHICS>;
+        case NONREGISTERED_GRAPHICS:
+            return render_pipeline<NONREGISTERED_GRAPHICS>;
+        case NONREGISTERED_GRAPHICS_WITH_ARROWS:
+            return render_pipeline<NONREGISTERED_GRAPHICS_WITH_ARROWS>;
+        case CONTROL:
+            return render_pipeline<CONTROL>;
+        default:
+            std::cout << "Unknown method received: " << presentation_method << std::endl;
+            return render_unknown_method;
+    }
+}
+
+void set_presentation_method(AppContext *context, int presentation_method) {
+    if (context->caption_pipeline != nullptr && context->presentation_method == presentation_method) {
+        return;
+    }
+    context->presentation_method = presentation_method;
+    context->caption_pipeline = caption_pipeline(presentation_method);
+}
+
+void render_captions(const AppContext *context) {
+    if (context->caption_pipeline == nullptr) {
+        // Only a context that never had its method set gets here; it's looked up every frame, like it used to be.
+        caption_pipeline(context->presentation_method)(context);
+        return;
+    }
+    context->caption_pipeline(context);
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "proxy_cache.hpp"
+#include "ffmpeg_process.hpp"
+
+static std::string video_path(int video_section) {
+    std::ostringstream os;
+    os << "resources/videos/main." << video_section << ".mp4";
+    return os.str();
+}
+
+static void put_u32(std::vector<uint8_t> *bytes, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        bytes->push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static void put_u64(std::vector<uint8_t> *bytes, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        bytes->push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint64_t get_u64(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= (uint64_t) bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * The header that identifies a proxy: which video (by size and modification time), and at what size and frame rate.
+ */
+static std::vector<uint8_t> proxy_header(const struct stat *video_stat, int width, int height) {
+    std::vector<uint8_t> header(PROXY_CACHE_MAGIC, PROXY_CACHE_MAGIC + 4);
+    put_u32(&header, PROXY_CACHE_VERSION);
+    put_u64(&header, (uint64_t) video_stat->st_size);
+    put_u64(&header, (uint64_t) video_stat->st_mtime);
+    put_u32(&header, width);
+    put_u32(&header, height);
+    put_u32(&header, PROXY_FPS);
+    return header;
+}
+
+static bool map_proxy_cache(const std::string &cache_path, const std::vector<uint8_t> &expected_header, int width,
+                            int height, ProxyCache *proxy) {
+    const int fd = open(cache_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat cache_stat{};
+    const size_t fixed_size = expected_header.size() + 8;
+    if (fstat(fd, &cache_stat) != 0 || (size_t) cache_stat.st_size < fixed_size) {
+        close(fd);
+        return false;
+    }
+    void *mapping = mmap(nullptr, cache_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file open on its own.
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Unable to map " << cache_path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    const auto *contents = (const uint8_t *) mapping;
+    const size_t frame_size = (size_t) width * height * 2;
+    const auto frame_count = get_u64(contents + expected_header.size());
+    if (!std::equal(expected_header.begin(), expected_header.end(), contents) || frame_count == 0 ||
+        (size_t) cache_stat.st_size != fixed_size + frame_count * frame_size) {
+        munmap(mapping, cache_stat.st_size);
+        return false;
+    }
+    *proxy = ProxyCache{width, height, PROXY_FPS, frame_count, frame_size, contents + fixed_size, mapping,
+                        (size_t) cache_stat.st_size};
+    return true;
+}
+
+/**
+ * Decodes the whole video into a temporary file next to the cache, and only moves it into place once it's complete,
+ * so an interrupted build never leaves a proxy that looks valid.
+ */
+static bool build_proxy_cache(const std::string &source_path, const std::string &cache_path,
+                              const std::vector<uint8_t> &header, int width, int height) {
+    const std::vector<std::string> decode_arguments{
+            "-loglevel", "error", "-i", source_path, "-an",
+            "-vf", "fps=" + std::to_string(PROXY_FPS) + ",scale=" + std::to_string(width) + ":" +
+                   std::to_string(height),
+            "-f", "rawvideo", "-pix_fmt", "bgr565le", "-"};
+    std::cout << "Building proxy " << cache_path << " with: " << ffmpeg_command_line(decode_arguments) << std::endl;
+    const auto partial_path = cache_path + ".partial";
+    FILE *output = fopen(partial_path.c_str(), "wb");
+    if (output == nullptr) {
+        std::cerr << "Unable to write proxy " << partial_path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    FfmpegProcess decoder{};
+    if (!start_ffmpeg(decode_arguments, true, &decoder)) {
+        fclose(output);
+        unlink(partial_path.c_str());
+        return false;
+    }
+
+    std::vector<uint8_t> contents = header;
+    put_u64(&contents, 0); // Frame count, filled in once decoding finishes
+    bool ok = fwrite(contents.data(), 1, contents.size(), output) == contents.size();
+    std::vector<uint8_t> frame((size_t) width * height * 2);
+    uint64_t frame_count = 0;
+    const auto start = std::chrono::steady_clock::now();
+    while (ok && fread(frame.data(), 1, frame.size(), decoder.pipe) == frame.size()) {
+        ok = fwrite(frame.data(), 1, frame.size(), output) == frame.size();
+        ++frame_count;
+        if (frame_count % 900 == 0) {
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "Decoded " << frame_count << " proxy frames (" << frame_count / elapsed.count()
+                      << " frames/s)" << std::endl;
+        }
+    }
+    ok = finish_ffmpeg(&decoder) && ok;
+    if (ok) {
+        std::vector<uint8_t> count;
+        put_u64(&count, frame_count);
+        ok = fseek(output, (long) header.size(), SEEK_SET) == 0 &&
+             fwrite(count.data(), 1, count.size(), output) == count.size();
+    }
+    ok = fclose(output) == 0 && ok && frame_count > 0;
+    if (!ok || rename(partial_path.c_str(), cache_path.c_str()) != 0) {
+        std::cerr << "Unable to build proxy " << cache_path << ": " << strerror(errno) << std::endl;
+        unlink(partial_path.c_str());
+        return false;
+    }
+    std::cout << "Decoded " << frame_count << " frames into " << cache_path << std::endl;
+    return true;
+}
+
+bool load_proxy_cache(int video_section, int width, int height, ProxyCache *proxy) {
+    const auto source_path = video_path(video_section);
+    struct stat video_stat{};
+    if (stat(source_path.c_str(), &video_stat) != 0) {
+        std::cerr << "Unable to find video " << source_path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    const auto cache_path = source_path + "." + std::to_string(height) + "p.proxy";
+    const auto header = proxy_header(&video_stat, width, height);
+    if (map_proxy_cache(cache_path, header, width, height, proxy)) {
+        std::cout << "Loaded proxy " << cache_path << std::endl;
+        return true;
+    }
+    return build_proxy_cache(source_path, cache_path, header, width, height) &&
+           map_proxy_cache(cache_path, header, width, height, proxy);
+}
+
+size_t proxy_frame_index(const ProxyCache *proxy, double media_time_ms) {
+    if (media_time_ms <= 0) {
+        return 0;
+    }
+    return std::min((size_t) (media_time_ms * proxy->fps / 1000.0), proxy->frame_count - 1);
+}
+
+const uint8_t *proxy_frame(const ProxyCache *proxy, size_t index) {
+    return proxy->frames + index * proxy->frame_size;
+}
+
+void close_proxy_cache(ProxyCache *proxy) {
+    if (proxy->mapping != nullptr) {
+        munmap(proxy->mapping, proxy->mapping_size);
+    }
+    *proxy = ProxyCache{};
+}
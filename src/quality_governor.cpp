@@ -0,0 +1,115 @@
+#include <cstdio>
+#include "quality_governor.hpp"
+#include "app_events.hpp"
+#include "metrics.hpp"
+
+QualityGovernor::QualityGovernor(bool can_reduce_resolution) :
+        can_reduce_resolution(can_reduce_resolution), created_at(std::chrono::steady_clock::now()) {}
+
+int QualityGovernor::quality_level() const {
+    return level.load(std::memory_order_relaxed);
+}
+
+bool QualityGovernor::begin_frame(SDL_Texture *texture, void **p_pixels) {
+    frame_number++;
+    skipping = quality_level() >= SKIPPING_FRAMES && frame_number % 2 == 0;
+    if (!skipping) {
+        return false;
+    }
+    int width = 0;
+    int height = 0;
+    SDL_QueryTexture(texture, nullptr, nullptr, &width, &height);
+    // RV16, with the same pitch VLC was given.
+    skip_buffer.resize((size_t) width * height * 2);
+    *p_pixels = skip_buffer.data();
+    record_frame_skipped(&trial_metrics);
+    return true;
+}
+
+bool QualityGovernor::skipping_frame() const {
+    return skipping;
+}
+
+void QualityGovernor::end_frame() {
+    window_render_ms += (double) (metrics_clock_us() - trial_metrics.frame_started_us.load(std::memory_order_relaxed)) /
+                        1000;
+    if (++window_frames < GOVERNOR_WINDOW_FRAMES) {
+        return;
+    }
+    const auto period_us = trial_metrics.frame_period_us.load(std::memory_order_relaxed);
+    const double budget_ms = (double) (period_us > 0 ? period_us : DEFAULT_FRAME_PERIOD_US) / 1000;
+    const double mean_render_ms = window_render_ms / (double) window_frames;
+    const auto dropped_total = trial_metrics.frames_dropped.value.load(std::memory_order_relaxed);
+    const auto dropped = dropped_total - window_start_dropped;
+    window_frames = 0;
+    window_render_ms = 0;
+    window_start_dropped = dropped_total;
+    if (settling) {
+        settling = false;
+        return;
+    }
+
+    const int current = quality_level();
+    if (mean_render_ms > OVERLOADED_FRACTION * budget_ms || dropped >= OVERLOADED_DROPPED_FRAMES) {
+        windows_with_headroom = 0;
+        if (current < LOWEST_QUALITY) {
+            int lower = current + 1;
+            if (lower == REDUCED_RESOLUTION && !can_reduce_resolution) {
+                lower++;
+            }
+            change_level(lower, "frames don't fit their budget", mean_render_ms, budget_ms, dropped);
+        }
+    } else if (mean_render_ms < HEADROOM_FRACTION * budget_ms && dropped == 0) {
+        if (++windows_with_headroom >= RECOVERY_WINDOWS && current > FULL_QUALITY) {
+            windows_with_headroom = 0;
+            int higher = current - 1;
+            if (higher == REDUCED_RESOLUTION && !can_reduce_resolution) {
+                higher--;
+            }
+            change_level(higher, "frames have room to spare", mean_render_ms, budget_ms, dropped);
+        }
+    } else {
+        windows_with_headroom = 0;
+    }
+}
+
+void QualityGovernor::change_level(int new_level, const char *reason, double mean_render_ms, double budget_ms,
+                                   uint64_t dropped) {
+    const auto previous = level.exchange(new_level, std::memory_order_relaxed);
+    settling = true;
+    trial_metrics.quality_level.store(new_level, std::memory_order_relaxed);
+    count(&trial_metrics.quality_changes);
+    const double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - created_at).count();
+    printf("[%.3f s] Quality %s -> %s: %s (mean %.1f ms of a %.1f ms budget, %llu dropped in the last %zu frames)\n",
+           elapsed_s, level_name(previous), level_name(new_level), reason, mean_render_ms, budget_ms,
+           (unsigned long long) dropped, GOVERNOR_WINDOW_FRAMES);
+    post_app_event(QUALITY_CHANGED);
+}
+
+const char *QualityGovernor::level_name(int level) {
+    switch (level) {
+        case FULL_QUALITY:
+            return "full quality";
+        case REDUCED_RESOLUTION:
+            return "reduced resolution";
+        case SHORT_ORIENTATION_FILTER:
+            return "short orientation filter";
+        case CACHED_CAPTIONS_ONLY:
+            return "cached captions only";
+        case SKIPPING_FRAMES:
+            return "skipping frames";
+        default:
+            return "unknown";
+    }
+}
+
+size_t orientation_filter_taps(const QualityGovernor *governor) {
+    if (governor == nullptr || governor->quality_level() < SHORT_ORIENTATION_FILTER) {
+        return MOVING_AVG_SIZE;
+    }
+    return SHORT_FILTER_TAPS;
+}
+
+bool cached_captions_only(const QualityGovernor *governor) {
+    return governor != nullptr && governor->quality_level() >= CACHED_CAPTIONS_ONLY;
+}
@@ -0,0 +1,34 @@
+#include "render_config.hpp"
+
+std::shared_ptr<const RenderConfig> create_render_config(const std::vector<CaptionCue> &cues,
+                                                         const SpeakerRegistry *speakers, int window_width,
+                                                         int window_height, int y, double font_scale) {
+    std::shared_ptr<const std::vector<GlyphAtlas>> glyph_atlases;
+    if (font_scale != 1.0 && !speakers->glyph_atlases.empty()) {
+        glyph_atlases = std::make_shared<const std::vector<GlyphAtlas>>(derive_speaker_atlases(speakers, font_scale));
+    }
+    auto layout = std::make_shared<const CaptionLayout>(
+            build_caption_layout(cues, speakers, glyph_atlases.get(), window_width, window_height));
+    return std::make_shared<const RenderConfig>(RenderConfig{window_width, window_height, y, std::move(layout),
+                                                             std::move(glyph_atlases)});
+}
+
+void publish_render_config(AppContext *context, std::shared_ptr<const RenderConfig> config) {
+    std::atomic_store(&context->published_render_config, std::move(config));
+}
+
+bool apply_render_config(AppContext *context) {
+    auto config = std::atomic_load(&context->published_render_config);
+    if (config == nullptr || config == context->render_config) {
+        return false;
+    }
+    context->window_width = config->window_width;
+    context->window_height = config->window_height;
+    context->display_rect = SDL_Rect{0, 0, config->window_width, config->window_height};
+    context->y = config->y;
+    context->caption_layout = config->caption_layout.get();
+    context->glyph_atlases = config->glyph_atlases.get();
+    // The old snapshot (and its layout) is freed here, once nothing on this thread can be pointing into it.
+    context->render_config = std::move(config);
+    return true;
+}
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <sys/stat.h>
+#include "sdf_atlas.hpp"
+
+/**
+ * One dimension of Felzenszwalb and Huttenlocher's exact squared Euclidean distance transform: replaces every
+ * f[i * stride] with min over j of (f[j * stride] + (i - j)^2).
+ */
+static void squared_distance_1d(float *f, int n, int stride, std::vector<float> *scratch,
+                                std::vector<int> *parabolas, std::vector<float> *boundaries) {
+    scratch->resize(n);
+    parabolas->resize(n);
+    boundaries->resize(n + 1);
+    for (int i = 0; i < n; ++i) {
+        (*scratch)[i] = f[i * stride];
+    }
+    const auto &values = *scratch;
+    auto &v = *parabolas;
+    auto &z = *boundaries;
+    int k = 0;
+    v[0] = 0;
+    z[0] = -std::numeric_limits<float>::infinity();
+    z[1] = std::numeric_limits<float>::infinity();
+    for (int q = 1; q < n; ++q) {
+        float s = ((values[q] + q * q) - (values[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+        while (s <= z[k]) {
+            --k;
+            s = ((values[q] + q * q) - (values[v[k]] + v[k] * v[k])) / (2.0f * q - 2.0f * v[k]);
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = std::numeric_limits<float>::infinity();
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        f[q * stride] = (float) ((q - v[k]) * (q - v[k])) + values[v[k]];
+    }
+}
+
+/**
+ * Squared distance from every pixel to the nearest pixel where `inside` equals `target`.
+ */
+static std::vector<float> squared_distances(const std::vector<bool> &inside, int width, int height, bool target) {
+    // Large enough to never win, small enough that adding a squared distance to it can't overflow to infinity.
+    const float far = 1e20f;
+    std::vector<float> distances(inside.size());
+    for (size_t i = 0; i < inside.size(); ++i) {
+        distances[i] = inside[i] == target ? 0 : far;
+    }
+    std::vector<float> scratch;
+    std::vector<int> parabolas;
+    std::vector<float> boundaries;
+    for (int column = 0; column < width; ++column) {
+        squared_distance_1d(&distances[column], height, width, &scratch, &parabolas, &boundaries);
+    }
+    for (int row = 0; row < height; ++row) {
+        squared_distance_1d(&distances[(size_t) row * width], width, 1, &scratch, &parabolas, &boundaries);
+    }
+    return distances;
+}
+
+/**
+ * Turns a glyph's coverage bitmap into a padded distance field, appended to distance.
+ */
+static void append_distance_field(const uint8_t *coverage, int width, int height, std::vector<uint8_t> *distance) {
+    const int padded_width = width + 2 * SDF_SPREAD;
+    const int padded_height = height + 2 * SDF_SPREAD;
+    std::vector<uint8_t> padded_coverage((size_t) padded_width * padded_height, 0);
+    std::vector<bool> inside(padded_coverage.size(), false);
+    for (int row = 0; row < height; ++row) {
+        for (int column = 0; column < width; ++column) {
+            const size_t i = (size_t) (row + SDF_SPREAD) * padded_width + column + SDF_SPREAD;
+            padded_coverage[i] = coverage[(size_t) row * width + column];
+            inside[i] = padded_coverage[i] >= 128;
+        }
+    }
+    const auto to_inside = squared_distances(inside, padded_width, padded_height, true);
+    const auto to_outside = squared_distances(inside, padded_width, padded_height, false);
+    for (size_t i = 0; i < inside.size(); ++i) {
+        // Measured from pixel centers, so the edge sits half a pixel from the last pixel inside. Right on the edge,
+        // the rasterizer's anti-aliasing already tells us where the edge crosses the pixel, which is more precise.
+        float signed_distance = inside[i] ? std::sqrt(to_outside[i]) - 0.5f : 0.5f - std::sqrt(to_inside[i]);
+        if ((inside[i] ? to_outside[i] : to_inside[i]) <= 1.0f) {
+            signed_distance = padded_coverage[i] / 255.0f - 0.5f;
+        }
+        const float encoded = 128.0f + signed_distance * (127.0f / SDF_SPREAD);
+        distance->push_back((uint8_t) std::clamp(std::lround(encoded), 0L, 255L));
+    }
+}
+
+SdfAtlas build_sdf_atlas(TTF_Font *font) {
+    // The distance fields are made from an ordinary coverage atlas at the reference size.
+    const GlyphAtlas reference = build_glyph_atlas(font);
+    SdfAtlas sdf{};
+    sdf.height = reference.height;
+    sdf.line_skip = reference.line_skip;
+    for (int i = 0; i < ATLAS_GLYPH_COUNT; ++i) {
+        const auto &glyph = reference.glyphs[i];
+        sdf.glyphs[i] = SdfGlyph{sdf.distance.size(), glyph.width, glyph.height, glyph.advance};
+        if (glyph.width > 0 && glyph.height > 0) {
+            append_distance_field(&reference.coverage[glyph.offset], glyph.width, glyph.height, &sdf.distance);
+        }
+    }
+    return sdf;
+}
+
+static void put_u32(std::vector<uint8_t> *bytes, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        bytes->push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static void put_u64(std::vector<uint8_t> *bytes, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        bytes->push_back((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint64_t get_bytes(const uint8_t **cursor, int count) {
+    uint64_t value = 0;
+    for (int i = 0; i < count; ++i) {
+        value |= (uint64_t) (*cursor)[i] << (8 * i);
+    }
+    *cursor += count;
+    return value;
+}
+
+/**
+ * The header that identifies a cache: which font file (by size and modification time) and which parameters.
+ */
+static std::vector<uint8_t> cache_header(const struct stat *font_stat) {
+    std::vector<uint8_t> header(SDF_CACHE_MAGIC, SDF_CACHE_MAGIC + 4);
+    put_u32(&header, SDF_CACHE_VERSION);
+    put_u64(&header, (uint64_t) font_stat->st_size);
+    put_u64(&header, (uint64_t) font_stat->st_mtime);
+    put_u32(&header, SDF_REFERENCE_SIZE);
+    put_u32(&header, SDF_SPREAD);
+    put_u32(&header, ATLAS_GLYPH_COUNT);
+    return header;
+}
+
+static bool read_sdf_cache(const std::string &cache_path, const std::vector<uint8_t> &expected_header,
+                           SdfAtlas *sdf) {
+    FILE *file = fopen(cache_path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<uint8_t> contents;
+    uint8_t buffer[65536];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.insert(contents.end(), buffer, buffer + read);
+    }
+    fclose(file);
+    const size_t fixed_size = expected_header.size() + 8 + ATLAS_GLYPH_COUNT * 12 + 8;
+    if (contents.size() < fixed_size ||
+        !std::equal(expected_header.begin(), expected_header.end(), contents.begin())) {
+        return false;
+    }
+    const uint8_t *cursor = contents.data() + expected_header.size();
+    sdf->height = (int) get_bytes(&cursor, 4);
+    sdf->line_skip = (int) get_bytes(&cursor, 4);
+    size_t offset = 0;
+    for (auto &glyph: sdf->glyphs) {
+        glyph.offset = offset;
+        glyph.width = (int) get_bytes(&cursor, 4);
+        glyph.height = (int) get_bytes(&cursor, 4);
+        glyph.advance = (int) get_bytes(&cursor, 4);
+        if (glyph.width > 0 && glyph.height > 0) {
+            offset += (size_t) (glyph.width + 2 * SDF_SPREAD) * (glyph.height + 2 * SDF_SPREAD);
+        }
+    }
+    const auto distance_size = get_bytes(&cursor, 8);
+    if (distance_size != offset || contents.size() - fixed_size != distance_size) {
+        return false;
+    }
+    sdf->distance.assign(cursor, cursor + distance_size);
+    return true;
+}
+
+static void write_sdf_cache(const std::string &cache_path, const std::vector<uint8_t> &header, const SdfAtlas *sdf) {
+    std::vector<uint8_t> contents = header;
+    put_u32(&contents, sdf->height);
+    put_u32(&contents, sdf->line_skip);
+    for (const auto &glyph: sdf->glyphs) {
+        put_u32(&contents, glyph.width);
+        put_u32(&contents, glyph.height);
+        put_u32(&contents, glyph.advance);
+    }
+    put_u64(&contents, sdf->distance.size());
+    contents.insert(contents.end(), sdf->distance.begin(), sdf->distance.end());
+    FILE *file = fopen(cache_path.c_str(), "wb");
+    if (file == nullptr || fwrite(contents.data(), 1, contents.size(), file) != contents.size()) {
+        // Not fatal, the atlas just gets generated again next time.
+        std::cerr << "Unable to write SDF cache " << cache_path << ": " << strerror(errno) << std::endl;
+    }
+    if (file != nullptr) {
+        fclose(file);
+    }
+}
+
+SdfAtlas load_sdf_atlas(const std::string &path_to_font) {
+    struct stat font_stat{};
+    if (stat(path_to_font.c_str(), &font_stat) != 0) {
+        std::cerr << "Unable to find font " << path_to_font << ": " << strerror(errno) << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    const auto cache_path = path_to_font + ".sdf";
+    const auto header = cache_header(&font_stat);
+    SdfAtlas sdf{};
+    if (read_sdf_cache(cache_path, header, &sdf)) {
+        std::cout << "Loaded glyph distance fields from " << cache_path << std::endl;
+        return sdf;
+    }
+    TTF_Font *font = TTF_OpenFont(path_to_font.c_str(), SDF_REFERENCE_SIZE);
+    if (font == nullptr) {
+        std::cerr << "Unable to open " << path_to_font << ": " << TTF_GetError() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    sdf = build_sdf_atlas(font);
+    TTF_CloseFont(font);
+    write_sdf_cache(cache_path, header, &sdf);
+    std::cout << "Generated glyph distance fields for " << path_to_font << std::endl;
+    return sdf;
+}
+
+/**
+ * Bilinearly samples a glyph's distance field at (x, y), in padded reference pixels, clamping to its edges.
+ * Returns the signed distance to the glyph's edge, in reference pixels.
+ */
+static float sample_distance(const SdfAtlas *sdf, const SdfGlyph &glyph, float x, float y) {
+    const int padded_width = glyph.width + 2 * SDF_SPREAD;
+    const int padded_height = glyph.height + 2 * SDF_SPREAD;
+    x = std::clamp(x, 0.0f, (float) (padded_width - 1));
+    y = std::clamp(y, 0.0f, (float) (padded_height - 1));
+    const int x0 = (int) x;
+    const int y0 = (int) y;
+    const int x1 = std::min(x0 + 1, padded_width - 1);
+    const int y1 = std::min(y0 + 1, padded_height - 1);
+    const float fx = x - x0;
+    const float fy = y - y0;
+    const uint8_t *field = &sdf->distance[glyph.offset];
+    const auto at = [field, padded_width](int column, int row) {
+        return (float) field[(size_t) row * padded_width + column];
+    };
+    const float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+    const float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+    const float encoded = top + (bottom - top) * fy;
+    return (encoded - 128.0f) * SDF_SPREAD / 127.0f;
+}
+
+GlyphAtlas glyph_atlas_from_sdf(const SdfAtlas *sdf, int font_size) {
+    const float scale = (float) font_size / SDF_REFERENCE_SIZE;
+    GlyphAtlas atlas{};
+    atlas.height = (int) std::lround(sdf->height * scale);
+    atlas.line_skip = (int) std::lround(sdf->line_skip * scale);
+    for (int i = 0; i < ATLAS_GLYPH_COUNT; ++i) {
+        const auto &source = sdf->glyphs[i];
+        auto &glyph = atlas.glyphs[i];
+        glyph.offset = atlas.coverage.size();
+        glyph.width = (int) std::lround(source.width * scale);
+        glyph.height = (int) std::lround(source.height * scale);
+        glyph.advance = (int) std::lround(source.advance * scale);
+        if (source.width == 0 || source.height == 0) {
+            glyph.width = 0;
+            glyph.height = 0;
+            continue;
+        }
+        for (int row = 0; row < glyph.height; ++row) {
+            for (int column = 0; column < glyph.width; ++column) {
+                // Map this pixel's center back into the reference field (past the padding).
+                const float x = (column + 0.5f) / scale - 0.5f + SDF_SPREAD;
+                const float y = (row + 0.5f) / scale - 0.5f + SDF_SPREAD;
+                // Scaled back to target pixels, the edge gets a one-pixel-wide ramp.
+                const float distance = sample_distance(sdf, source, x, y) * scale;
+                const float coverage = std::clamp(distance + 0.5f, 0.0f, 1.0f);
+                atlas.coverage.push_back((uint8_t) std::lround(coverage * 255));
+            }
+        }
+    }
+    return atlas;
+}
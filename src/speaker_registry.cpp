@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "speaker_registry.hpp"
+#include "experiment_setup.hpp"
+#include "nlohmann/json.hpp"
+
+/**
+ * Finds the cog::Juror whose generated name (e.g. "JurorA") matches, since that's what the HWD understands.
+ */
+static cog::Juror wire_id_from_string(const std::string &juror_str) {
+    for (int juror = cog::Juror_MIN; juror <= cog::Juror_MAX; ++juror) {
+        if (juror_str == cog::EnumNameJuror(static_cast<cog::Juror>(juror))) {
+            return static_cast<cog::Juror>(juror);
+        }
+    }
+    std::cerr << "Unknown juror in scene config: " << juror_str << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+SpeakerRegistry load_speaker_registry(const std::string &path, int default_font_size, SDL_Color default_color) {
+    std::ifstream scene_file(path.c_str());
+    if (!scene_file) {
+        std::cerr << "Unable to open scene config " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    nlohmann::json scene;
+    scene_file >> scene;
+    const auto reference_width = scene["reference_size"][0].get<double>();
+    const auto reference_height = scene["reference_size"][1].get<double>();
+
+    SpeakerRegistry registry;
+    for (const auto &speaker: scene["speakers"]) {
+        if (registry.ids.size() > UINT8_MAX) {
+            std::cerr << "Scene config " << path << " has too many speakers." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        registry.ids.push_back(speaker["id"].get<std::string>());
+        const auto wire_id = wire_id_from_string(speaker["juror"].get<std::string>());
+        // The HWD and the caption ingest tell speakers apart by juror alone, so two speakers can't share one.
+        SpeakerId existing;
+        if (speaker_from_wire_id(&registry, wire_id, &existing)) {
+            std::cerr << "Scene config " << path << " sends both " << registry.ids[existing] << " and "
+                      << registry.ids.back() << " to the HWD as " << cog::EnumNameJuror(wire_id)
+                      << "; every speaker needs a juror of their own." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        registry.wire_ids.push_back(wire_id);
+        registry.anchor_x.push_back(speaker["anchor"][0].get<double>() / reference_width);
+        registry.anchor_y.push_back(speaker["anchor"][1].get<double>() / reference_height);
+        registry.interval_width.push_back(speaker["interval_width"].get<double>());
+        registry.font_sizes.push_back(speaker.value("font_size", default_font_size));
+        registry.colors.push_back(speaker.contains("color")
+                                  ? color_string_to_color(speaker["color"].get<std::string>())
+                                  : default_color);
+    }
+    // Speakers with the same font size share a glyph atlas.
+    for (const auto font_size: registry.font_sizes) {
+        auto existing = std::find(registry.distinct_font_sizes.begin(), registry.distinct_font_sizes.end(), font_size);
+        if (existing == registry.distinct_font_sizes.end()) {
+            registry.distinct_font_sizes.push_back(font_size);
+            existing = registry.distinct_font_sizes.end() - 1;
+        }
+        registry.font_index.push_back(existing - registry.distinct_font_sizes.begin());
+    }
+    std::cout << "Loaded " << registry.ids.size() << " speakers from " << path << std::endl;
+    return registry;
+}
+
+SpeakerId speaker_from_string(const SpeakerRegistry *registry, const std::string &speaker_str) {
+    for (size_t speaker = 0; speaker < registry->ids.size(); ++speaker) {
+        if (registry->ids[speaker] == speaker_str) {
+            return static_cast<SpeakerId>(speaker);
+        }
+    }
+    std::cerr << "Unknown speaker ID encountered: " << speaker_str << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+bool speaker_from_wire_id(const SpeakerRegistry *registry, cog::Juror wire_id, SpeakerId *speaker) {
+    for (size_t i = 0; i < registry->wire_ids.size(); ++i) {
+        if (registry->wire_ids[i] == wire_id) {
+            *speaker = static_cast<SpeakerId>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void load_speaker_fonts(SpeakerRegistry *registry, const std::string &path_to_font) {
+    registry->sdf_atlas = load_sdf_atlas(path_to_font);
+    registry->glyph_atlases = derive_speaker_atlases(registry, 1.0);
+}
+
+std::vector<GlyphAtlas> derive_speaker_atlases(const SpeakerRegistry *registry, double font_scale) {
+    std::vector<GlyphAtlas> atlases;
+    atlases.reserve(registry->distinct_font_sizes.size());
+    for (const auto font_size: registry->distinct_font_sizes) {
+        const int scaled_size = std::max(1, (int) std::lround(font_size * font_scale));
+        atlases.push_back(glyph_atlas_from_sdf(&registry->sdf_atlas, scaled_size));
+    }
+    return atlases;
+}
+
+void close_speaker_fonts(SpeakerRegistry *registry) {
+    registry->glyph_atlases.clear();
+    registry->sdf_atlas = SdfAtlas{};
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "startup.hpp"
+
+size_t add_startup_step(StartupGraph *graph, const std::string &name, std::function<void()> run,
+                        const std::vector<size_t> &dependencies, bool main_thread) {
+    for (const auto dependency: dependencies) {
+        if (dependency >= graph->steps.size()) {
+            std::cerr << "Startup step " << name << " depends on a step that hasn't been added yet." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    graph->steps.push_back(StartupStep{name, std::move(run), dependencies, main_thread, 0.0, 0.0});
+    return graph->steps.size() - 1;
+}
+
+/**
+ * What the calling thread and the workers share while the graph runs. Everything is guarded by `mutex`.
+ */
+struct StartupSchedule {
+    StartupGraph *graph;
+    std::chrono::steady_clock::time_point start;
+    std::vector<size_t> waiting_on; // How many unfinished dependencies each step has left
+    std::vector<std::vector<size_t>> dependents;
+    std::deque<size_t> ready; // Steps any thread can run
+    std::deque<size_t> ready_main; // Steps only the calling thread can run
+    size_t running;
+    size_t finished;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+static double elapsed_ms(const StartupSchedule *schedule) {
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - schedule->start;
+    return elapsed.count();
+}
+
+static void queue_step(StartupSchedule *schedule, size_t step) {
+    if (schedule->graph->steps[step].main_thread) {
+        schedule->ready_main.push_back(step);
+    } else {
+        schedule->ready.push_back(step);
+    }
+}
+
+static bool all_finished(const StartupSchedule *schedule) {
+    return schedule->finished == schedule->graph->steps.size();
+}
+
+/**
+ * Runs steps until every step has finished. The calling thread prefers the steps only it can run, but helps with the
+ * rest too, so the graph still finishes with no workers at all.
+ */
+static void run_startup_steps(StartupSchedule *schedule, bool is_main_thread) {
+    std::unique_lock<std::mutex> lock(schedule->mutex);
+    while (true) {
+        schedule->changed.wait(lock, [schedule, is_main_thread] {
+            return all_finished(schedule) || !schedule->ready.empty() ||
+                   (is_main_thread && !schedule->ready_main.empty()) ||
+                   (is_main_thread && schedule->running == 0);
+        });
+        if (all_finished(schedule)) {
+            return;
+        }
+        size_t step;
+        if (is_main_thread && !schedule->ready_main.empty()) {
+            step = schedule->ready_main.front();
+            schedule->ready_main.pop_front();
+        } else if (!schedule->ready.empty()) {
+            step = schedule->ready.front();
+            schedule->ready.pop_front();
+        } else {
+            // Nothing is running or ready, but not everything has finished, so the rest can never start.
+            std::cerr << "Startup steps depend on each other in a cycle:";
+            for (size_t i = 0; i < schedule->waiting_on.size(); i++) {
+                if (schedule->waiting_on[i] > 0) {
+                    std::cerr << " " << schedule->graph->steps[i].name;
+                }
+            }
+            std::cerr << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        schedule->running++;
+        auto &current = schedule->graph->steps[step];
+        current.started_ms = elapsed_ms(schedule);
+        lock.unlock();
+
+        current.run();
+
+        lock.lock();
+        current.finished_ms = elapsed_ms(schedule);
+        for (const auto dependent: schedule->dependents[step]) {
+            if (--schedule->waiting_on[dependent] == 0) {
+                queue_step(schedule, dependent);
+            }
+        }
+        schedule->running--;
+        schedule->finished++;
+        schedule->changed.notify_all();
+    }
+}
+
+void run_startup_graph(StartupGraph *graph, size_t workers) {
+    StartupSchedule schedule{};
+    schedule.graph = graph;
+    schedule.start = std::chrono::steady_clock::now();
+    schedule.waiting_on.resize(graph->steps.size(), 0);
+    schedule.dependents.resize(graph->steps.size());
+    for (size_t i = 0; i < graph->steps.size(); i++) {
+        for (const auto dependency: graph->steps[i].dependencies) {
+            schedule.waiting_on[i]++;
+            schedule.dependents[dependency].push_back(i);
+        }
+    }
+    for (size_t i = 0; i < graph->steps.size(); i++) {
+        if (schedule.waiting_on[i] == 0) {
+            queue_step(&schedule, i);
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < workers; i++) {
+        threads.emplace_back(run_startup_steps, &schedule, false);
+    }
+    run_startup_steps(&schedule, true);
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    graph->finished_ms = elapsed_ms(&schedule);
+}
+
+void print_startup_timings(const StartupGraph *graph) {
+    std::vector<const StartupStep *> steps;
+    double total_ms = 0.0;
+    for (const auto &step: graph->steps) {
+        steps.push_back(&step);
+        total_ms += step.finished_ms - step.started_ms;
+    }
+    std::sort(steps.begin(), steps.end(), [](const StartupStep *a, const StartupStep *b) {
+        return a->started_ms < b->started_ms;
+    });
+    std::cout << "Startup timings (ms):" << std::endl;
+    for (const auto *step: steps) {
+        printf("  %-32s start %8.1f  took %8.1f%s\n", step->name.c_str(), step->started_ms,
+               step->finished_ms - step->started_ms, step->main_thread ? "  (main thread)" : "");
+    }
+    printf("Ready after %.1f ms (%.1f ms of work across threads).\n", graph->finished_ms, total_ms);
+}
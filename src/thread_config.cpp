@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#include <sys/syscall.h>
+#endif
+#include "thread_config.hpp"
+#include "nlohmann/json.hpp"
+
+ThreadConfig trial_thread_config;
+
+static std::array<WakeupJitter, TRIAL_THREAD_COUNT> wakeup_jitter;
+static std::mutex applied_mutex;
+static std::array<std::string, TRIAL_THREAD_COUNT> applied_settings; // What each kind of thread actually got
+static thread_local bool thread_configured = false;
+
+static const char *config_key(TrialThread thread) {
+    switch (thread) {
+        case RENDER_THREAD:
+            return "render";
+        case ORIENTATION_THREAD:
+            return "orientation";
+        case CAPTION_THREAD:
+            return "captions";
+        case SENDER_THREAD:
+            return "sender";
+        case CAPTION_READER_THREAD:
+            return "caption_reader";
+        case INGEST_THREAD:
+            return "ingest";
+        case SIMULATOR_THREAD:
+            return "simulator";
+        case METRICS_THREAD:
+            return "metrics";
+    }
+    return "unknown";
+}
+
+const char *thread_name(TrialThread thread) {
+    switch (thread) {
+        case RENDER_THREAD:
+            return "cog-render";
+        case ORIENTATION_THREAD:
+            return "cog-orientation";
+        case CAPTION_THREAD:
+            return "cog-captions";
+        case SENDER_THREAD:
+            return "cog-sender";
+        case CAPTION_READER_THREAD:
+            return "cog-cap-reader";
+        case INGEST_THREAD:
+            return "cog-ingest";
+        case SIMULATOR_THREAD:
+            return "cog-simulator";
+        case METRICS_THREAD:
+            return "cog-metrics";
+    }
+    return "cog-unknown";
+}
+
+ThreadConfig load_thread_config(const std::string &path) {
+    std::ifstream config_file(path.c_str());
+    if (!config_file) {
+        std::cerr << "Unable to open thread config " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    nlohmann::json json;
+    config_file >> json;
+    ThreadConfig config{};
+    const int max_priority = sched_get_priority_max(SCHED_FIFO);
+    for (size_t i = 0; i < TRIAL_THREAD_COUNT; ++i) {
+        const auto thread = (TrialThread) i;
+        if (!json.contains(config_key(thread))) {
+            continue;
+        }
+        const auto &entry = json[config_key(thread)];
+        auto &settings = config.threads[i];
+        settings.cpu = entry.value("cpu", -1);
+        settings.realtime_priority = entry.value("realtime_priority", 0);
+        settings.nice = entry.value("nice", 0);
+#ifdef __linux__
+        if (settings.cpu >= CPU_SETSIZE) {
+            std::cerr << "The " << config_key(thread) << " thread's CPU must be below " << CPU_SETSIZE << "."
+                      << std::endl;
+            exit(EXIT_FAILURE);
+        }
+#endif
+        if (settings.realtime_priority < 0 || settings.realtime_priority > max_priority) {
+            std::cerr << "The " << config_key(thread) << " thread's real-time priority must be between 1 and "
+                      << max_priority << " (or 0 for none)." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        if (settings.nice < -20 || settings.nice > 19) {
+            std::cerr << "The " << config_key(thread) << " thread's nice value must be between -20 and 19."
+                      << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (const auto &[key, _]: json.items()) {
+        bool known = false;
+        for (size_t i = 0; i < TRIAL_THREAD_COUNT; ++i) {
+            known = known || key == config_key((TrialThread) i);
+        }
+        if (!known) {
+            std::cerr << "Ignoring settings for unknown thread \"" << key << "\" in " << path << std::endl;
+        }
+    }
+    std::cout << "Loaded thread config from " << path << std::endl;
+    return config;
+}
+
+void configure_current_thread(TrialThread thread) {
+    if (thread_configured) {
+        return;
+    }
+    thread_configured = true;
+#ifdef __APPLE__
+    pthread_setname_np(thread_name(thread)); // Can only name the calling thread, which is all we do anyway
+#else
+    pthread_setname_np(pthread_self(), thread_name(thread));
+#endif
+
+    const auto &settings = trial_thread_config.threads[thread];
+    std::string applied;
+#ifdef __linux__
+    if (settings.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(settings.cpu, &cpus);
+        const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (error != 0) {
+            std::cerr << "Couldn't pin " << thread_name(thread) << " to CPU " << settings.cpu << ": " << strerror(error)
+                      << std::endl;
+        } else {
+            applied += "CPU " + std::to_string(settings.cpu) + ", ";
+        }
+    }
+#else
+    if (settings.cpu >= 0) {
+        std::cerr << "Couldn't pin " << thread_name(thread) << " to CPU " << settings.cpu
+                  << ": threads can only be pinned on Linux" << std::endl;
+    }
+#endif
+    bool realtime = false;
+    if (settings.realtime_priority > 0) {
+        sched_param param{};
+        param.sched_priority = settings.realtime_priority;
+        const int error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error != 0) {
+            std::cerr << "Couldn't make " << thread_name(thread) << " SCHED_FIFO " << settings.realtime_priority
+                      << ": " << strerror(error) << std::endl;
+        } else {
+            realtime = true;
+            applied += "SCHED_FIFO " + std::to_string(settings.realtime_priority) + ", ";
+        }
+    }
+#ifdef __linux__
+    // Nice values are per thread on Linux, when given a thread's id rather than the process's.
+    if (!realtime && settings.nice != 0) {
+        if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), settings.nice) < 0) {
+            std::cerr << "Couldn't set " << thread_name(thread) << "'s nice value to " << settings.nice << ": "
+                      << strerror(errno) << std::endl;
+        } else {
+            applied += "nice " + std::to_string(settings.nice) + ", ";
+        }
+    }
+#else
+    if (!realtime && settings.nice != 0) {
+        std::cerr << "Couldn't set " << thread_name(thread) << "'s nice value to " << settings.nice
+                  << ": nice values can only be set per thread on Linux" << std::endl;
+    }
+#endif
+    applied = applied.empty() ? "default scheduling" : applied.substr(0, applied.size() - 2);
+    std::lock_guard<std::mutex> lock(applied_mutex);
+    applied_settings[thread] = applied;
+}
+
+bool wait_for_playback(const std::atomic<bool> *started, const std::atomic<bool> *stopping) {
+    while (!(*started)) {
+        if (stopping != nullptr && *stopping) {
+            return false;
+        }
+        std::this_thread::sleep_for(PLAYBACK_POLL);
+    }
+    return true;
+}
+
+bool sleep_until_or_stopping(std::chrono::steady_clock::time_point deadline, const std::atomic<bool> *stopping) {
+    while (!(*stopping)) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(deadline - now, STOP_POLL));
+    }
+    return false;
+}
+
+static void record_lateness(TrialThread thread, int64_t lateness_us) {
+    auto &jitter = wakeup_jitter[thread];
+    lateness_us = std::max<int64_t>(lateness_us, 0);
+    observe(&jitter.lateness_ms, (double) lateness_us / 1000);
+    auto max_us = jitter.max_us.load(std::memory_order_relaxed);
+    while (lateness_us > max_us &&
+           !jitter.max_us.compare_exchange_weak(max_us, lateness_us, std::memory_order_relaxed)) {}
+}
+
+void record_wakeup(TrialThread thread, std::chrono::steady_clock::time_point intended) {
+    record_lateness(thread, std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - intended).count());
+}
+
+void record_packet_wakeup(TrialThread thread, int socket) {
+#ifdef __linux__
+    timespec received{};
+    // Fails with ENOENT if the datagram wasn't timestamped, which it may not be until the first call turns it on.
+    if (ioctl(socket, SIOCGSTAMPNS, &received) < 0) {
+        return;
+    }
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    record_lateness(thread, (int64_t) (now.tv_sec - received.tv_sec) * 1000000 +
+                            (now.tv_nsec - received.tv_nsec) / 1000);
+#else
+    // Elsewhere, a datagram's receive time is only available through recvmsg, so there's nothing to measure against.
+    (void) thread;
+    (void) socket;
+#endif
+}
+
+void record_paced_wakeup(TrialThread thread, int64_t previous_us, int64_t now_us, int64_t period_us) {
+    if (previous_us == 0 || period_us <= 0) {
+        return;
+    }
+    const auto interval_us = now_us - previous_us;
+    if ((double) interval_us > DROPPED_FRAME_FACTOR * (double) period_us) {
+        return;
+    }
+    record_lateness(thread, interval_us - period_us);
+}
+
+/**
+ * The upper bound of the bucket the q quantile falls in, or infinity if it's in the last one.
+ */
+static double lateness_quantile_ms(const Histogram &histogram, uint64_t total, double q) {
+    const auto rank = (uint64_t) std::ceil(q * (double) total);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_BOUNDS_MS.size(); ++i) {
+        seen += histogram.buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return HISTOGRAM_BOUNDS_MS[i];
+        }
+    }
+    return INFINITY;
+}
+
+void print_thread_report() {
+    std::cout << "Thread wake-up lateness (p50/p99 are bucket bounds):" << std::endl;
+    std::lock_guard<std::mutex> lock(applied_mutex);
+    for (size_t i = 0; i < TRIAL_THREAD_COUNT; ++i) {
+        const auto thread = (TrialThread) i;
+        const auto &jitter = wakeup_jitter[i];
+        uint64_t wakeups = 0;
+        for (const auto &bucket: jitter.lateness_ms.buckets) {
+            wakeups += bucket.load(std::memory_order_relaxed);
+        }
+        if (applied_settings[i].empty() && wakeups == 0) {
+            continue;
+        }
+        const std::string settings = applied_settings[i].empty() ? "never started" : applied_settings[i];
+        if (wakeups == 0) {
+            printf("  %-16s %s\n", thread_name(thread), settings.c_str());
+            continue;
+        }
+        const double mean_ms = (double) jitter.lateness_ms.sum_us.load(std::memory_order_relaxed) / 1000 /
+                               (double) wakeups;
+        printf("  %-16s %s: %llu wake-ups, mean %.3f ms, p50 <= %g ms, p99 <= %g ms, max %.3f ms\n",
+               thread_name(thread), settings.c_str(), (unsigned long long) wakeups, mean_ms,
+               lateness_quantile_ms(jitter.lateness_ms, wakeups, 0.5),
+               lateness_quantile_ms(jitter.lateness_ms, wakeups, 0.99),
+               (double) jitter.max_us.load(std::memory_order_relaxed) / 1000);
+    }
+}
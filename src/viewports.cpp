@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cmath>
+#include "viewports.hpp"
+#include "presentation_methods.hpp"
+
+/**
+ * Tiles the views over the window in as square a grid as possible, each one letterboxed to the window's aspect ratio so
+ * registered captions stay over the right juror.
+ */
+static void lay_out_viewports(ViewportSet *viewport_set, int window_width, int window_height) {
+    const auto count = (int) viewport_set->viewports.size();
+    if (count == 0) {
+        return;
+    }
+    const int columns = (int) std::ceil(std::sqrt((double) count));
+    const int rows = (count + columns - 1) / columns;
+    const int cell_width = window_width / columns;
+    const int cell_height = window_height / rows;
+    const double scale = std::min((double) cell_width / window_width, (double) cell_height / window_height);
+    const int width = (int) (window_width * scale);
+    const int height = (int) (window_height * scale);
+    for (int i = 0; i < count; i++) {
+        const int column = i % columns;
+        const int row = i / columns;
+        viewport_set->viewports[i]->screen_rect = SDL_Rect{column * cell_width + (cell_width - width) / 2,
+                                                           row * cell_height + (cell_height - height) / 2,
+                                                           width,
+                                                           height};
+    }
+}
+
+static void copy_context_into_viewport(Viewport *viewport, const AppContext *context) {
+    viewport->context = *context;
+    viewport->context.azimuth_mutex = &viewport->client->azimuth_mutex;
+    viewport->context.azimuth_buffer = &viewport->client->azimuth_buffer;
+    viewport->context.caption_overlay = &viewport->overlay;
+    viewport->context.viewports = nullptr;
+}
+
+void sync_viewports(ViewportSet *viewport_set, const AppContext *context, bool config_changed) {
+    const auto clients = viewport_set->server->client_list();
+    bool added = false;
+    for (size_t i = viewport_set->viewports.size(); i < clients.size(); i++) {
+        auto viewport = std::make_unique<Viewport>();
+        viewport->client = clients[i];
+        // The overlay is created at the window size the first time it's drawn.
+        viewport->overlay = CaptionOverlay{};
+        copy_context_into_viewport(viewport.get(), context);
+        viewport_set->viewports.push_back(std::move(viewport));
+        added = true;
+    }
+    for (auto &viewport: viewport_set->viewports) {
+        if (config_changed) {
+            copy_context_into_viewport(viewport.get(), context);
+        }
+        set_presentation_method(&viewport->context, viewport->client->presentation_method);
+        viewport->context.half_fov = viewport->client->half_fov;
+    }
+    if (added || config_changed) {
+        lay_out_viewports(viewport_set, context->window_width, context->window_height);
+    }
+}
+
+bool has_multiple_viewports(const AppContext *context) {
+    return context->viewports != nullptr && context->viewports->viewports.size() > 1;
+}
+
+void display_viewports(const ViewportSet *viewport_set, SDL_Renderer *renderer, SDL_Texture *frame) {
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    // One decode, copied (and scaled) once per view.
+    for (const auto &viewport: viewport_set->viewports) {
+        SDL_RenderCopy(renderer, frame, nullptr, &viewport->screen_rect);
+    }
+}
+
+/**
+ * Captions are drawn at window size, in the same coordinates as a single full-window view, and then scaled down onto
+ * the view, so the presentation methods and the shared layout don't need to know about views at all.
+ */
+static void composite_viewport(Viewport *viewport) {
+    const auto *context = &viewport->context;
+    if (context->presentation_method == CONTROL) {
+        return;
+    }
+    const auto &screen_rect = viewport->screen_rect;
+    const float scale_x = (float) screen_rect.w / (float) context->window_width;
+    const float scale_y = (float) screen_rect.h / (float) context->window_height;
+    if (refresh_caption_overlay(context)) {
+        const auto &bounds = viewport->overlay.bounds;
+        if (bounds.w <= 0 || bounds.h <= 0) {
+            return;
+        }
+        const SDL_Rect destination{screen_rect.x + (int) (bounds.x * scale_x),
+                                   screen_rect.y + (int) (bounds.y * scale_y),
+                                   (int) std::ceil(bounds.w * scale_x),
+                                   (int) std::ceil(bounds.h * scale_y)};
+        SDL_RenderCopy(context->renderer, viewport->overlay.texture, &bounds, &destination);
+        return;
+    }
+    // Nowhere to keep the captions between frames, so they're drawn straight into the view.
+    SDL_RenderSetViewport(context->renderer, &screen_rect);
+    SDL_RenderSetScale(context->renderer, scale_x, scale_y);
+    render_captions(context);
+    SDL_RenderSetScale(context->renderer, 1.0f, 1.0f);
+    SDL_RenderSetViewport(context->renderer, nullptr);
+    viewport->overlay.dirty_rects.clear();
+}
+
+void composite_viewports(const ViewportSet *viewport_set) {
+    for (const auto &viewport: viewport_set->viewports) {
+        composite_viewport(viewport.get());
+    }
+}
+
+void destroy_viewports(ViewportSet *viewport_set) {
+    for (auto &viewport: viewport_set->viewports) {
+        destroy_caption_overlay(&viewport->overlay);
+    }
+    viewport_set->viewports.clear();
+}